@@ -0,0 +1,98 @@
+#ifndef SYCAMORE_CONFIG_H
+#define SYCAMORE_CONFIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+#include <xkbcommon/xkbcommon.h>
+#include "sycamore/desktop/window_rules.h"
+#include "sycamore/input/keybinding.h"
+
+struct sycamore_server;
+
+/* An ini style file. Every section is optional, and left out it keeps the
+ * built-in defaults:
+ *
+ * [keybindings]
+ * logo+Return = exec foot         # modifiers+keysym = action [argument]
+ * logo+Tab = none                 # removes a built-in one
+ *
+ * [cursor]
+ * theme = Adwaita
+ * size = 32
+ *
+ * [touchpad]
+ * tap = true
+ * natural-scroll = true
+ * accel-speed = 0.3
+ *
+ * [output]
+ * mode = DP-1=2560x1440@144       # as -m, repeatable
+ * scale = eDP-1=1.5               # as -S, repeatable
+ *
+ * [window-rules]                  # applied to views as they open
+ * app_id:foot = size=1200x800 output=DP-1 position=40,40
+ * title~YouTube$ = fullscreen max-fps=30
+ */
+enum config_section {
+    CONFIG_KEYBINDINGS,
+    CONFIG_CURSOR,
+    CONFIG_TOUCHPAD,
+    CONFIG_OUTPUT,
+    CONFIG_WINDOW_RULES,
+    CONFIG_SECTIONS_ALL,
+};
+
+struct config_keybinding {
+    uint32_t modifiers;
+    xkb_keysym_t sym;
+    keybinding_action action;   //NULL to remove the binding
+    char *argument;
+};
+
+/* A parsed and validated config. It is never changed once loaded: a reload
+ * loads a new one and only reapplies the sections that differ. */
+struct sycamore_config {
+    char *path;
+
+    /* Of each section's entries, 0 if the section isn't there */
+    uint64_t hashes[CONFIG_SECTIONS_ALL];
+
+    struct wl_array keybindings;    //config_keybinding
+
+    struct {
+        char *theme;    //NULL for the default
+        uint32_t size;
+    } cursor;
+
+    struct {
+        bool tap, natural_scroll;
+        double accel_speed;
+    } touchpad;
+
+    struct {
+        struct wl_array mode_rules;     //char *
+        struct wl_array scale_rules;    //char *
+    } output;
+
+    struct window_rules *window_rules;  //compiled along with the parse
+};
+
+/* $XDG_CONFIG_HOME/sycamore/config, or under ~/.config. NULL if neither
+ * is set. */
+char *config_default_path();
+
+/* Parse a config file. A missing file gives the defaults, an invalid one
+ * NULL. This doesn't touch the server and may run on any thread. */
+struct sycamore_config *sycamore_config_load(const char *path);
+
+void sycamore_config_destroy(struct sycamore_config *config);
+
+/* A mask of the sections that differ, by enum config_section */
+uint32_t config_diff(const struct sycamore_config *a, const struct sycamore_config *b);
+
+/* Make the config current, reapplying only what changed. Takes ownership.
+ * Reloads go through config_watch.h, which parses off the main thread. */
+void config_apply(struct sycamore_server *server, struct sycamore_config *config);
+
+#endif //SYCAMORE_CONFIG_H
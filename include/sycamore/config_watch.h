@@ -0,0 +1,46 @@
+#ifndef SYCAMORE_CONFIG_WATCH_H
+#define SYCAMORE_CONFIG_WATCH_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+#define CONFIG_WATCH_DEBOUNCE_MSEC 200
+
+struct sycamore_config;
+struct sycamore_server;
+
+/* Reloads the config file when it changes. Its directory is watched with
+ * inotify, since editors often replace the file rather than write to it,
+ * and a burst of changes becomes one reload once it has been quiet for
+ * CONFIG_WATCH_DEBOUNCE_MSEC. The file is read and parsed on a worker
+ * thread; the main loop only applies a config that was already validated. */
+struct sycamore_config_watch {
+    char *path;         //NULL if there is no config file to watch
+    const char *name;   //within path
+    int inotify_fd;
+    struct wl_event_source *inotify_source;
+    struct wl_event_source *debounce_timer;
+
+    /* The parse in flight */
+    pthread_t thread;
+    bool parsing;
+    bool pending;       //changed again meanwhile, parse once more
+    int fds[2];         //written to by the worker when done
+    struct wl_event_source *done_source;
+    struct sycamore_config *result;     //NULL if invalid
+    uint64_t parse_nsec;
+
+    struct sycamore_server *server;
+};
+
+struct sycamore_config_watch *sycamore_config_watch_create(struct sycamore_server *server,
+        const char *path);
+
+void sycamore_config_watch_destroy(struct sycamore_config_watch *watch);
+
+/* Parse the file again now, without waiting for it to change */
+void config_watch_reload(struct sycamore_config_watch *watch);
+
+#endif //SYCAMORE_CONFIG_WATCH_H
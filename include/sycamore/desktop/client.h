@@ -0,0 +1,103 @@
+#ifndef SYCAMORE_CLIENT_H
+#define SYCAMORE_CLIENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_compositor.h>
+
+/* Throttled clients get at most one frame event per surface per interval */
+#define CLIENT_THROTTLE_INTERVAL_MSEC 100
+
+struct sycamore_server;
+
+/* Soft limits, 0 means unlimited */
+struct sycamore_client_limits {
+    uint32_t max_commit_rate;   //commits per second
+    size_t max_buffer_bytes;
+    size_t max_surfaces;
+    uint32_t commit_burst;  //commits a surface may make above the refresh rate
+    uint32_t dispatch_budget_usec;  //request handling time per loop iteration
+    bool throttle;  //throttle offenders instead of only logging them
+};
+
+/* Resources attributed to one wl_client */
+struct sycamore_client {
+    struct wl_list link;    //sycamore_client_manager::clients
+    struct wl_client *wl_client;
+    pid_t pid;
+
+    struct wl_list surfaces;    //client_surface::link
+    size_t surfaces_len;
+    size_t views;
+
+    /* Estimated size of the buffers currently attached */
+    size_t shm_bytes;
+    size_t dmabuf_bytes;
+
+    uint32_t commits;       //in the current second
+    uint32_t commit_rate;   //in the last second
+    uint64_t deferred_commits;
+
+    /* Time spent handling the client's requests */
+    uint64_t dispatch_nsec;             //in total
+    uint64_t dispatch_interval_nsec;    //in the current second
+    uint64_t dispatch_iteration_nsec;   //in the current loop iteration
+    uint32_t dispatch_load_usec;        //per second, over the last second
+    uint32_t budget_overruns;           //in the current second
+
+    bool over_limit;
+    bool throttled;
+    bool over_budget;
+
+    struct wl_listener destroy;
+
+    struct sycamore_client_manager *manager;
+};
+
+struct sycamore_client_manager {
+    struct wl_list clients;     //sycamore_client::link
+    struct wl_list deferred_surfaces;   //client_surface::deferred_link
+    struct sycamore_client_limits limits;
+
+    struct wl_event_source *rate_timer;
+    struct wl_event_source *flush_timer;    //when no output frame will flush
+    struct wl_listener new_surface;
+
+    struct wl_protocol_logger *protocol_logger;
+    struct sycamore_client *dispatch_client;   //whose span is open
+    uint64_t dispatch_start_nsec, dispatch_last_nsec;
+    struct wl_event_source *dispatch_idle;      //charges the iteration at its end
+
+    struct sycamore_server *server;
+};
+
+struct sycamore_client_manager *sycamore_client_manager_create(
+        struct sycamore_server *server, struct wl_display *display,
+        struct wlr_compositor *compositor);
+
+void sycamore_client_manager_destroy(struct sycamore_client_manager *manager);
+
+/* Return NULL if the surface isn't tracked */
+struct sycamore_client *client_from_surface(struct sycamore_client_manager *manager,
+        struct wlr_surface *surface);
+
+/* Close the open dispatch span, before work that isn't a client's */
+void client_manager_dispatch_break(struct sycamore_client_manager *manager);
+
+/* Apply the commits held back by the rate limiter */
+void client_manager_flush_deferred(struct sycamore_client_manager *manager);
+
+size_t client_frames_pending(struct sycamore_client *client);
+
+/* Cap the frame events a surface gets, 0 removes the cap */
+void client_surface_set_max_fps(struct sycamore_client_manager *manager,
+        struct wlr_surface *surface, uint32_t max_fps);
+
+/* Return false if a frame event for this surface should be held back */
+bool client_surface_frame_allowed(struct sycamore_client_manager *manager,
+        struct wlr_surface *surface, uint32_t msec);
+
+#endif //SYCAMORE_CLIENT_H
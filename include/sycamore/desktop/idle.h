@@ -0,0 +1,60 @@
+#ifndef SYCAMORE_IDLE_H
+#define SYCAMORE_IDLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_idle_inhibit_v1.h>
+#include <wlr/types/wlr_idle_notify_v1.h>
+#include <wlr/types/wlr_output_power_management_v1.h>
+
+struct sycamore_seat;
+struct sycamore_server;
+
+struct idle_inhibitor {
+    struct wl_list link;    //sycamore_idle_manager::inhibitors
+    struct wlr_idle_inhibitor_v1 *wlr_inhibitor;
+    bool visible;
+
+    struct wl_listener destroy;
+
+    struct sycamore_idle_manager *manager;
+};
+
+struct sycamore_idle_manager {
+    struct wlr_idle_notifier_v1 *idle_notifier;
+    struct wlr_output_power_manager_v1 *output_power_manager;
+    struct wlr_idle_inhibit_manager_v1 *inhibit_manager;
+
+    struct wl_listener output_power_set_mode;
+    struct wl_listener new_inhibitor;
+
+    /* Only inhibitors of visible surfaces count */
+    struct wl_list inhibitors;  //idle_inhibitor::link
+    bool inhibited;
+
+    /* Outputs are powered off after this much inactivity, 0 disables it */
+    uint32_t timeout_msec;
+    uint32_t last_activity_msec;
+    struct wl_event_source *idle_timer;
+    bool idle;
+
+    struct sycamore_server *server;
+};
+
+struct sycamore_idle_manager *sycamore_idle_manager_create(
+        struct sycamore_server *server, struct wl_display *display);
+
+void sycamore_idle_manager_destroy(struct sycamore_idle_manager *manager);
+
+void idle_manager_set_timeout(struct sycamore_idle_manager *manager, uint32_t timeout_msec);
+
+/* Re-evaluate which inhibitors are visible. Called whenever views change
+ * stacking or size: map, unmap, focus, fullscreen and maximize. */
+void idle_manager_update_inhibit(struct sycamore_idle_manager *manager);
+
+/* Called on every input event, wakes up outputs powered off by idle */
+void idle_manager_notify_activity(struct sycamore_idle_manager *manager,
+        struct sycamore_seat *seat);
+
+#endif //SYCAMORE_IDLE_H
@@ -0,0 +1,66 @@
+#ifndef SYCAMORE_XWAYLAND_H
+#define SYCAMORE_XWAYLAND_H
+
+#include <wlr/config.h>
+
+#if WLR_HAS_XWAYLAND
+#include <wayland-server-core.h>
+#include <wlr/xwayland.h>
+#include "sycamore/desktop/view.h"
+
+struct sycamore_server;
+
+struct sycamore_xwayland_view {
+    struct sycamore_view base_view;
+
+    struct wlr_xwayland_surface *xwayland_surface;
+
+    struct wl_listener map;
+    struct wl_listener unmap;
+    struct wl_listener destroy;
+    struct wl_listener request_configure;
+    struct wl_listener request_activate;
+    struct wl_listener request_move;
+    struct wl_listener request_resize;
+    struct wl_listener request_fullscreen;
+    struct wl_listener request_maximize;
+};
+
+/* Override-redirect windows: menus, tooltips, drag icons. Shown where
+ * they ask to be, never managed as views. */
+struct sycamore_xwayland_unmanaged {
+    enum scene_descriptor_type scene_descriptor;    //must be first
+    struct wlr_xwayland_surface *xwayland_surface;
+    struct wlr_scene_tree *scene_tree;
+
+    struct wl_listener map;
+    struct wl_listener unmap;
+    struct wl_listener destroy;
+    struct wl_listener set_geometry;
+
+    struct sycamore_server *server;
+};
+
+/* Xwayland is started by wlroots on the first X11 connection only. When
+ * idle_timeout is set, a server left without X11 windows for that long is
+ * shut down and goes back to waiting for a connection. */
+struct sycamore_xwayland {
+    struct wlr_xwayland *wlr_xwayland;
+    size_t surfaces;
+    uint32_t idle_timeout;  //seconds, 0 to leave it running
+    struct wl_event_source *idle_timer;
+
+    struct wl_listener ready;
+    struct wl_listener new_surface;
+
+    struct sycamore_server *server;
+};
+
+struct sycamore_xwayland *sycamore_xwayland_create(struct sycamore_server *server,
+        struct wl_display *display);
+
+void sycamore_xwayland_destroy(struct sycamore_xwayland *xwayland);
+
+#endif
+
+#endif //SYCAMORE_XWAYLAND_H
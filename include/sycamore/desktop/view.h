@@ -7,6 +7,7 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/util/box.h>
+#include "sycamore/desktop/window_rules.h"
 #include "sycamore/output/scene.h"
 
 struct sycamore_view;
@@ -29,12 +30,15 @@ struct view_interface {
     void (*map)(struct sycamore_view *view);
     void (*unmap)(struct sycamore_view *view);
     void (*set_activated)(struct sycamore_view *view, bool activated);
+    void (*set_position)(struct sycamore_view *view, int x, int y);    //optional
     void (*set_size)(struct sycamore_view *view, uint32_t width, uint32_t height);
     void (*set_fullscreen)(struct sycamore_view *view, bool fullscreen);
     void (*set_maximized)(struct sycamore_view *view, bool maximized);
     void (*set_resizing)(struct sycamore_view *view, bool resizing);
     void (*get_geometry)(struct sycamore_view *view, struct wlr_box *box);
     void (*close)(struct sycamore_view *view);
+    const char *(*get_app_id)(struct sycamore_view *view);    //optional
+    const char *(*get_title)(struct sycamore_view *view);     //optional
 };
 
 /* base view */
@@ -43,6 +47,7 @@ struct sycamore_view {
     const struct view_interface *interface;
     struct wlr_surface *wlr_surface;
     enum sycamore_view_type view_type;
+    uint32_t id;    //unique for the server's lifetime, never 0
     int x, y;
 
     struct wlr_scene_tree *scene_tree;
@@ -57,6 +62,8 @@ struct sycamore_view {
     struct wlr_box maximize_restore;
     struct wlr_box fullscreen_restore;
 
+    struct window_rule_actions rules;   //looked up as the view opens
+
     struct sycamore_server *server;
 };
 
@@ -68,6 +75,7 @@ struct sycamore_xdg_shell_view {
     struct wl_listener map;
     struct wl_listener unmap;
     struct wl_listener destroy;
+    struct wl_listener commit;      //the initial one only
     struct wl_listener request_move;
     struct wl_listener request_resize;
     struct wl_listener request_fullscreen;
@@ -78,6 +86,11 @@ struct sycamore_xdg_shell_view {
 void view_init(struct sycamore_view *view, struct wlr_surface *surface,
         const struct view_interface *interface, struct sycamore_server *server);
 
+/* Look the window rules up and size the view for them. Shells call this
+ * before the view's first configure, so the client draws at that size
+ * from its first frame. */
+void view_apply_rules(struct sycamore_view *view);
+
 void view_map(struct sycamore_view *view,
         struct wlr_output *fullscreen_output, bool maximized, bool fullscreen);
 
@@ -97,6 +110,11 @@ void view_set_maximized(struct sycamore_view *view,
 
 void view_set_focus(struct sycamore_view *view);
 
+/* NULL if the view has none */
+const char *view_get_app_id(struct sycamore_view *view);
+
+const char *view_get_title(struct sycamore_view *view);
+
 void view_ptr_connect(struct view_ptr *ptr, struct sycamore_view *view);
 
 void view_ptr_disconnect(struct view_ptr *ptr);
@@ -0,0 +1,74 @@
+#ifndef SYCAMORE_WINDOW_RULES_H
+#define SYCAMORE_WINDOW_RULES_H
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-util.h>
+
+enum window_rule_action {
+    WINDOW_RULE_OUTPUT = 1 << 0,
+    WINDOW_RULE_POSITION = 1 << 1,
+    WINDOW_RULE_SIZE = 1 << 2,
+    WINDOW_RULE_MAXIMIZED = 1 << 3,
+    WINDOW_RULE_FULLSCREEN = 1 << 4,
+    WINDOW_RULE_OPACITY = 1 << 5,
+    WINDOW_RULE_MAX_FPS = 1 << 6,
+};
+
+/* What the rules matching a view do to it, later rules overriding earlier
+ * ones. Owned by the view, so a reload can't pull it from under it. */
+struct window_rule_actions {
+    uint32_t set;       //enum window_rule_action
+    char *output;
+    int32_t x, y;       //relative to the output
+    int32_t width, height;
+    bool maximized, fullscreen;
+    float opacity;
+    uint32_t max_fps;
+};
+
+/* "criteria = actions", criteria being any of app_id:EXACT, app_id~REGEX,
+ * title:EXACT, title~REGEX and output:NAME, all of which must match */
+struct window_rule {
+    char *app_id;       //exact, NULL for any
+    char *title;        //exact, NULL for any
+    char *output;       //the one the view opens on, NULL for any
+    regex_t app_id_regex, title_regex;
+    bool has_app_id_regex, has_title_regex;
+
+    struct window_rule_actions actions;
+
+    size_t index;       //in config order
+    struct window_rule *next;   //in its bucket, or window_rules::generic
+};
+
+/* Rules with an exact app_id are hashed on it, so matching a view only
+ * looks at its own bucket and at the few rules that need a regex or don't
+ * name an app_id */
+struct window_rules {
+    struct wl_array rules;      //window_rule *
+    struct window_rule **buckets;
+    size_t buckets_len;         //a power of two
+    struct window_rule *generic;
+};
+
+struct window_rules *window_rules_create();
+
+void window_rules_destroy(struct window_rules *rules);
+
+/* Return false if the rule can't be parsed. Rules may only be added before
+ * window_rules_compile(). */
+bool window_rules_add(struct window_rules *rules, const char *criteria, const char *actions);
+
+bool window_rules_compile(struct window_rules *rules);
+
+/* Merge the actions of every matching rule into actions, which is reset
+ * first. Any of the strings may be NULL. */
+void window_rules_match(const struct window_rules *rules, const char *app_id,
+        const char *title, const char *output, struct window_rule_actions *actions);
+
+void window_rule_actions_finish(struct window_rule_actions *actions);
+
+#endif //SYCAMORE_WINDOW_RULES_H
@@ -11,7 +11,11 @@
 #include <wlr/util/box.h>
 #include "sycamore/input/seat.h"
 
+#define XCURSOR_DEFAULT_SIZE 24
+
+struct sycamore_config;
 struct sycamore_output;
+struct xcursor_scale_load;
 
 struct sycamore_cursor {
     struct wlr_cursor *wlr_cursor;
@@ -19,7 +23,10 @@ struct sycamore_cursor {
     struct wlr_pointer_gestures_v1 *gestures;
 
     bool enabled;
+    bool hidden;    //never set an image, so nothing is drawn
     const char *image;
+    float scale;    //of the output under the cursor, its theme is loaded or loading
+    struct xcursor_scale_load *scale_load;  //theme being read on a worker
 
     struct wl_listener cursor_motion;
     struct wl_listener cursor_motion_absolute;
@@ -54,6 +61,18 @@ void cursor_set_image(struct sycamore_cursor *cursor, const char *image);
 void cursor_set_image_surface(struct sycamore_cursor *cursor,
         struct wlr_seat_pointer_request_set_cursor_event *event);
 
+/* Take over a manager created with the configured theme and size, e.g. by
+ * the prefetch thread, unless themes were loaded already. Return false if not. */
+bool cursor_adopt_xcursor_manager(struct sycamore_cursor *cursor,
+        struct wlr_xcursor_manager *manager);
+
+/* Export the configured theme and size for clients. It writes environ, so
+ * never while the prefetch thread runs. */
+void xcursor_setenv(struct sycamore_config *config);
+
+/* Load the configured theme and size again */
+void xcursor_reload(struct sycamore_cursor *cursor);
+
 void output_setup_xcursor(struct sycamore_cursor *cursor, struct sycamore_output *output);
 
 struct wlr_output *cursor_at_output(struct sycamore_cursor *cursor,
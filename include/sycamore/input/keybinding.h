@@ -1,6 +1,7 @@
 #ifndef SYCAMORE_KEYBINDING_H
 #define SYCAMORE_KEYBINDING_H
 
+#include <stdbool.h>
 #include <wayland-util.h>
 #include <xkbcommon/xkbcommon.h>
 
@@ -30,15 +31,31 @@ struct sycamore_keybinding {
     xkb_keysym_t sym;
 
     keybinding_action action;
+    char *argument;     //exec's command or a virtual output's spec or name, may be NULL
 
     struct keybinding_modifiers_node *modifiers_node;
 };
 
+/* The built-in keybindings, overridden by those of the config file */
 struct sycamore_keybinding_manager *sycamore_keybinding_manager_create(
         struct sycamore_server *server);
 
 void sycamore_keybinding_manager_destroy(struct sycamore_keybinding_manager *manager);
 
+/* Add a keybinding, creating its modifiers node if needed. It replaces one
+ * with the same modifiers and sym, and a NULL action just removes that. */
+bool sycamore_keybinding_manager_add(struct sycamore_keybinding_manager *manager,
+        uint32_t modifiers, xkb_keysym_t sym, keybinding_action action, const char *argument);
+
+/* Look an action up by its config file name, e.g. "exec" or "close".
+ * "none" gives a NULL action. Return false if there is no such action. */
+bool keybinding_action_from_name(const char *name, keybinding_action *action);
+
+/* Whether the action takes this argument, NULL for none. exec needs a
+ * command, add-virtual-output takes an optional spec, remove-virtual-output
+ * an optional output name, the others nothing. */
+bool keybinding_action_check_argument(keybinding_action action, const char *argument);
+
 bool handle_keybinding(struct sycamore_keybinding_manager *manager,
         uint32_t modifiers, xkb_keysym_t sym);
 
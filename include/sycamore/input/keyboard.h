@@ -16,6 +16,9 @@ struct sycamore_keyboard {
 struct sycamore_keyboard *sycamore_keyboard_create(struct sycamore_seat *seat,
         struct wlr_input_device *wlr_device);
 
+/* Compile the default keymap. Safe to call off the main thread */
+struct xkb_keymap *sycamore_keyboard_compile_keymap();
+
 void sycamore_keyboard_configure(struct sycamore_keyboard *keyboard);
 
 #endif //SYCAMORE_KEYBOARD_H
\ No newline at end of file
@@ -76,6 +76,7 @@ struct sycamore_seat {
     struct wlr_seat *wlr_seat;
     struct sycamore_cursor *cursor;
     struct wl_list devices;
+    struct xkb_keymap *keymap;  //shared by all keyboards, NULL until the first one
 
     const struct sycamore_seatop_impl *seatop_impl;
 
@@ -110,6 +111,12 @@ void seat_device_destroy(struct sycamore_seat_device *seat_device);
 
 void seat_update_capabilities(struct sycamore_seat *seat);
 
+/* Apply the touchpad config to every pointer again */
+void seat_configure_touchpads(struct sycamore_seat *seat);
+
+/* Report user activity, e.g. to reset the idle timer */
+void seat_notify_activity(struct sycamore_seat *seat);
+
 void seat_set_keyboard_focus(struct sycamore_seat *seat, struct wlr_surface *surface);
 
 void seatop_begin_default(struct sycamore_seat *seat);
@@ -0,0 +1,72 @@
+#ifndef SYCAMORE_IPC_H
+#define SYCAMORE_IPC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include "sycamore/ipc_protocol.h"
+
+/* Unread data a client may have queued before its events are dropped.
+ * Replies to its own queries are always queued, up to the hard limit. */
+#define IPC_MAX_QUEUED_EVENT_BYTES (64 * 1024)
+#define IPC_MAX_QUEUED_BYTES (1024 * 1024)
+#define IPC_FRAME_STATS_INTERVAL_MSEC 1000
+
+struct sycamore_output;
+struct sycamore_server;
+struct sycamore_view;
+struct sycamore_ipc;
+
+struct ipc_client {
+    struct wl_list link;    //sycamore_ipc::clients
+    int fd;
+    struct wl_event_source *source;
+    struct wl_array in;     //partial messages from the client
+    struct wl_array out;    //messages not written yet
+    size_t out_offset;
+
+    uint32_t events;        //enum ipc_subscription
+    enum ipc_format format;
+    uint32_t dropped;       //events dropped since the last IPC_EVENT_DROPPED
+
+    struct sycamore_ipc *ipc;
+};
+
+/* Where the previous IPC_EVENT_FRAME_STATS of an output left off, so each
+ * event covers its own interval whatever stats dumps happened meanwhile */
+struct ipc_frame_stats_snapshot {
+    struct wl_list link;    //sycamore_ipc::frame_stats
+    struct sycamore_output *output;
+    uint64_t frames, rendered, nsec;
+    uint64_t taken_nsec;
+};
+
+struct sycamore_ipc {
+    char *socket_path;
+    int listen_fd;
+    struct wl_event_source *listen_source;
+
+    struct wl_list clients;     //ipc_client::link
+    uint32_t events;            //subscribed to by any client
+    struct wl_event_source *frame_stats_timer;
+    struct wl_list frame_stats;     //ipc_frame_stats_snapshot::link
+
+    uint64_t events_sent, events_dropped;
+
+    struct sycamore_server *server;
+};
+
+/* Listens on socket_path, exported to clients as SYCAMORE_SOCK */
+struct sycamore_ipc *sycamore_ipc_create(struct sycamore_server *server,
+        const char *socket_path);
+
+void sycamore_ipc_destroy(struct sycamore_ipc *ipc);
+
+/* Cheap without subscribers. type is IPC_EVENT_FOCUS, _MAP or _UNMAP */
+void ipc_notify_view(struct sycamore_ipc *ipc, uint32_t type, struct sycamore_view *view);
+
+/* type is IPC_EVENT_OUTPUT_ADD or _REMOVE. Removal also drops the output's
+ * frame stats snapshot, so it is sent whether anyone subscribed or not. */
+void ipc_notify_output(struct sycamore_ipc *ipc, uint32_t type, struct sycamore_output *output);
+
+#endif //SYCAMORE_IPC_H
@@ -0,0 +1,131 @@
+#ifndef SYCAMORE_IPC_PROTOCOL_H
+#define SYCAMORE_IPC_PROTOCOL_H
+
+#include <stdint.h>
+
+/* Wire format of the IPC socket, shared with tools/ipc_client.c. Every
+ * message is an ipc_msg_header followed by `length` bytes of body, in
+ * host byte order.
+ *
+ * Queries are answered with a message of the same type, holding an array
+ * of structs. Subscribed events come as they happen. In JSON format, set
+ * with IPC_MSG_SET_FORMAT, bodies are JSON text instead of structs, with
+ * the same field names: an array of objects for queries, an object for
+ * events.
+ *
+ * Events are never allowed to back up: once a client has too much unread
+ * data queued, its events are dropped, and it gets an IPC_EVENT_DROPPED
+ * with their count before the next one it receives. */
+
+#define IPC_PROTOCOL_VERSION 1
+#define IPC_MSG_MAX_LENGTH 4096     //from clients
+#define IPC_NAME_LENGTH 32
+#define IPC_TEXT_LENGTH 128
+
+enum ipc_msg_type {
+    /* client -> compositor, the reply has the same type */
+    IPC_MSG_GET_VIEWS = 1,      //no body, replied with ipc_view[]
+    IPC_MSG_GET_OUTPUTS,        //no body, replied with ipc_output[]
+    IPC_MSG_GET_SEATS,          //no body, replied with ipc_seat[]
+    IPC_MSG_GET_STATS,          //no body, replied with ipc_stats
+    IPC_MSG_SUBSCRIBE,          //ipc_subscribe, replied with the events now subscribed to
+    IPC_MSG_SET_FORMAT,         //ipc_set_format, replied with the format now used
+    IPC_MSG_ADD_VIRTUAL_OUTPUT, //ipc_add_virtual_output, replied with the new ipc_output,
+                                //or none if it couldn't be created
+    IPC_MSG_REMOVE_VIRTUAL_OUTPUT,  //ipc_remove_virtual_output, replied with the removed
+                                    //ipc_output, or none if there is no such virtual output
+
+    /* compositor -> client */
+    IPC_EVENT_FOCUS = 128,      //ipc_view
+    IPC_EVENT_MAP,              //ipc_view
+    IPC_EVENT_UNMAP,            //ipc_view
+    IPC_EVENT_OUTPUT_ADD,       //ipc_output
+    IPC_EVENT_OUTPUT_REMOVE,    //ipc_output
+    IPC_EVENT_FRAME_STATS,      //ipc_frame_stats, every second per output
+    IPC_EVENT_DROPPED,          //ipc_dropped
+};
+
+enum ipc_subscription {
+    IPC_SUBSCRIBE_FOCUS = 1 << 0,
+    IPC_SUBSCRIBE_VIEWS = 1 << 1,       //map and unmap
+    IPC_SUBSCRIBE_OUTPUTS = 1 << 2,     //add and remove
+    IPC_SUBSCRIBE_FRAME_STATS = 1 << 3,
+    IPC_SUBSCRIBE_ALL = (1 << 4) - 1,
+};
+
+enum ipc_format {
+    IPC_FORMAT_BINARY,
+    IPC_FORMAT_JSON,
+};
+
+struct ipc_msg_header {
+    uint32_t type;
+    uint32_t length;
+};
+
+/* Replaces the client's subscriptions */
+struct ipc_subscribe {
+    uint32_t events;    //enum ipc_subscription
+};
+
+struct ipc_set_format {
+    uint32_t format;    //enum ipc_format
+};
+
+/* WIDTHxHEIGHT[@HZ][+X,Y] as for the add-virtual-output keybinding action,
+ * NUL-terminated */
+struct ipc_add_virtual_output {
+    char spec[IPC_NAME_LENGTH];
+};
+
+/* Name of a virtual output, other outputs are refused. NUL-terminated. */
+struct ipc_remove_virtual_output {
+    char name[IPC_NAME_LENGTH];
+};
+
+/* Strings are NUL-terminated, and truncated to fit */
+struct ipc_view {
+    uint32_t id;
+    int32_t pid;
+    int32_t x, y, width, height;
+    uint32_t focused, maximized, fullscreen;
+    char app_id[IPC_TEXT_LENGTH];
+    char title[IPC_TEXT_LENGTH];
+};
+
+struct ipc_output {
+    char name[IPC_NAME_LENGTH];
+    int32_t x, y, width, height;    //layout coordinates
+    int32_t refresh;                //mHz
+    float scale;
+    uint32_t enabled;
+};
+
+struct ipc_seat {
+    char name[IPC_NAME_LENGTH];
+    uint32_t capabilities;  //enum wl_seat_capability
+    uint32_t devices;
+    int32_t cursor_x, cursor_y;
+    uint32_t focused_view;  //ipc_view::id, 0 if none
+};
+
+struct ipc_stats {
+    uint32_t views, outputs, clients;
+    uint32_t ipc_clients;
+    uint64_t ipc_events_sent, ipc_events_dropped;
+};
+
+/* Since the previous event for the output, or since it was added or the
+ * subscription started */
+struct ipc_frame_stats {
+    char output[IPC_NAME_LENGTH];
+    uint64_t frames, rendered;
+    uint64_t avg_nsec, max_nsec;
+    uint64_t interval_nsec;
+};
+
+struct ipc_dropped {
+    uint32_t events;
+};
+
+#endif //SYCAMORE_IPC_PROTOCOL_H
@@ -0,0 +1,78 @@
+#ifndef SYCAMORE_CAPTURE_H
+#define SYCAMORE_CAPTURE_H
+
+#include <pixman.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_scene.h>
+#include "sycamore/output/capture_protocol.h"
+
+#define CAPTURE_BUFFER_CACHE_SIZE 8
+
+/* Buffers of one output held by all of its sessions together. Swapchains
+ * have 4, one is scanned out and one rendered to. */
+#define CAPTURE_MAX_OUTPUT_BUFFERS_HELD 2
+
+struct sycamore_output;
+struct sycamore_server;
+struct sycamore_capture_manager;
+
+/* An output buffer the client has been told about */
+struct capture_known_buffer {
+    struct wlr_buffer *buffer;
+    uint32_t id;
+    struct wl_listener destroy;
+    struct capture_session *session;
+};
+
+struct capture_held_frame {
+    uint32_t seq;
+    struct wlr_buffer *buffer;
+};
+
+struct capture_session {
+    struct wl_list link;    //sycamore_capture_manager::sessions
+    int fd;
+    struct wl_event_source *source;
+
+    /* NULL until the client binds */
+    struct sycamore_output *output;
+    struct wl_listener output_commit;
+    struct wl_listener output_destroy;
+
+    /* Damage since the last frame sent, within the latest buffer */
+    pixman_region32_t pending;
+    struct wlr_buffer *latest;
+    struct timespec latest_when;
+
+    struct capture_held_frame held[CAPTURE_MAX_FRAMES_HELD];
+    struct capture_known_buffer known[CAPTURE_BUFFER_CACHE_SIZE];
+    size_t known_next;
+    uint32_t seq, next_buffer_id;
+    uint64_t frames, skipped;
+
+    struct sycamore_capture_manager *manager;
+};
+
+struct sycamore_capture_manager {
+    char *socket_path;
+    int listen_fd;
+    struct wl_event_source *listen_source;
+
+    struct wl_list sessions;    //capture_session::link
+
+    struct sycamore_server *server;
+};
+
+struct sycamore_capture_manager *sycamore_capture_manager_create(
+        struct sycamore_server *server, const char *socket_path);
+
+void sycamore_capture_manager_destroy(struct sycamore_capture_manager *manager);
+
+/* Called before an output commits, with the damage it is about to repaint */
+void capture_manager_record_damage(struct sycamore_capture_manager *manager,
+        struct sycamore_output *output, struct wlr_scene_output *scene_output);
+
+#endif //SYCAMORE_CAPTURE_H
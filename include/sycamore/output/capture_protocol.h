@@ -0,0 +1,83 @@
+#ifndef SYCAMORE_CAPTURE_PROTOCOL_H
+#define SYCAMORE_CAPTURE_PROTOCOL_H
+
+#include <stdint.h>
+
+/* Wire format of the capture socket, a SOCK_SEQPACKET UNIX socket where
+ * every packet is one message: a uint32 type followed by its struct.
+ *
+ * A client binds to an output by name. It is then told about each output
+ * buffer once, with its dmabuf or shm fds attached, and gets a frame
+ * message per captured frame naming the buffer and the damage since the
+ * previous frame it got. The buffer is not rendered to again until the
+ * client releases the frame, and at most CAPTURE_MAX_FRAMES_HELD frames
+ * are held at once: frames are only captured as fast as they are released.
+ * Clients of the same output also share a cap on the buffers they hold, so
+ * a slow one holds the others back rather than the output.
+ * Nothing is copied on the compositor side. */
+
+#define CAPTURE_MAX_FRAMES_HELD 2
+#define CAPTURE_MAX_DAMAGE_RECTS 32
+#define CAPTURE_MAX_PLANES 4
+
+enum capture_msg_type {
+    /* client -> compositor */
+    CAPTURE_MSG_BIND = 1,       //capture_bind
+    CAPTURE_MSG_RELEASE,        //capture_release
+
+    /* compositor -> client */
+    CAPTURE_MSG_BUFFER = 64,    //capture_buffer, with one fd per plane
+    CAPTURE_MSG_BUFFER_GONE,    //capture_buffer_gone
+    CAPTURE_MSG_FRAME,          //capture_frame
+};
+
+enum capture_buffer_type {
+    CAPTURE_BUFFER_DMABUF,
+    CAPTURE_BUFFER_SHM,
+};
+
+struct capture_bind {
+    uint32_t type;
+    char output[32];
+};
+
+struct capture_release {
+    uint32_t type;
+    uint32_t seq;
+};
+
+struct capture_buffer {
+    uint32_t type;
+    uint32_t id;
+    uint32_t buffer_type;
+    uint32_t width, height;
+    uint32_t format;    //DRM fourcc
+    uint64_t modifier;  //dmabuf only
+    uint32_t planes;
+    uint32_t offset[CAPTURE_MAX_PLANES];
+    uint32_t stride[CAPTURE_MAX_PLANES];
+};
+
+struct capture_buffer_gone {
+    uint32_t type;
+    uint32_t id;
+};
+
+struct capture_rect {
+    int32_t x, y;
+    int32_t width, height;
+};
+
+/* Damage is in buffer coordinates. Past CAPTURE_MAX_DAMAGE_RECTS, its
+ * bounding box is sent instead. */
+struct capture_frame {
+    uint32_t type;
+    uint32_t seq;
+    uint32_t buffer_id;
+    int64_t tv_sec;
+    uint32_t tv_nsec;
+    uint32_t rects;
+    struct capture_rect damage[CAPTURE_MAX_DAMAGE_RECTS];
+};
+
+#endif //SYCAMORE_CAPTURE_PROTOCOL_H
@@ -0,0 +1,83 @@
+#ifndef SYCAMORE_MIRROR_H
+#define SYCAMORE_MIRROR_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_damage_ring.h>
+#include <wlr/types/wlr_scene.h>
+
+#define MIRROR_TEXTURE_CACHE_SIZE 4
+
+struct sycamore_output;
+struct sycamore_server;
+struct sycamore_mirror_manager;
+
+/* Source buffers are imported once, not every frame */
+struct mirror_texture {
+    struct wlr_buffer *buffer;
+    struct wlr_texture *texture;
+    struct wl_listener buffer_destroy;
+};
+
+/* dst shows src's rendered buffer scaled to fit, instead of the scene.
+ * dst is taken out of the layout while mirroring. */
+struct sycamore_mirror {
+    struct wl_list link;    //sycamore_mirror_manager::mirrors
+    struct sycamore_output *src, *dst;
+
+    /* Latest buffer committed on src */
+    struct wlr_buffer *src_buffer;
+    struct mirror_texture textures[MIRROR_TEXTURE_CACHE_SIZE];
+    size_t textures_next;
+
+    /* In dst's transformed coordinates */
+    struct wlr_damage_ring damage_ring;
+
+    struct wl_listener src_commit;
+
+    struct sycamore_mirror_manager *manager;
+};
+
+struct mirror_rule {
+    struct wl_list link;
+    char *dst, *src;    //output names
+};
+
+struct sycamore_mirror_manager {
+    struct wl_list mirrors;     //sycamore_mirror::link
+    struct wl_list rules;       //mirror_rule::link
+
+    struct sycamore_server *server;
+};
+
+struct sycamore_mirror_manager *sycamore_mirror_manager_create(struct sycamore_server *server);
+
+void sycamore_mirror_manager_destroy(struct sycamore_mirror_manager *manager);
+
+/* Parse "dst=src", mirroring output src onto output dst whenever both exist */
+bool mirror_manager_add_rule(struct sycamore_mirror_manager *manager, const char *rule);
+
+/* Start the mirrors whose rules match current outputs */
+void mirror_manager_apply_rules(struct sycamore_mirror_manager *manager);
+
+/* Called before an output commits, with the damage it is about to repaint */
+void mirror_manager_record_damage(struct sycamore_mirror_manager *manager,
+        struct sycamore_output *output, struct wlr_scene_output *scene_output);
+
+/* Stop mirrors from or to an output going away */
+void mirror_manager_handle_output_destroy(struct sycamore_mirror_manager *manager,
+        struct sycamore_output *output);
+
+struct sycamore_mirror *mirror_create(struct sycamore_mirror_manager *manager,
+        struct sycamore_output *src, struct sycamore_output *dst);
+
+/* Stop mirroring and put dst back into the layout */
+void mirror_destroy(struct sycamore_mirror *mirror);
+
+/* Render a frame of dst from src's latest buffer. Return false if
+ * nothing was damaged, or nothing could be rendered. */
+bool mirror_render(struct sycamore_mirror *mirror);
+
+#endif //SYCAMORE_MIRROR_H
@@ -0,0 +1,80 @@
+#ifndef SYCAMORE_MODE_POLICY_H
+#define SYCAMORE_MODE_POLICY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_output.h>
+
+enum mode_policy_type {
+    MODE_POLICY_PREFERRED,
+    MODE_POLICY_MAX_REFRESH,
+    MODE_POLICY_MAX_RESOLUTION,
+    MODE_POLICY_EXPLICIT,
+};
+
+/* "[match=]policy", where match is an output name, make, model or
+ * "make model", and policy is one of preferred, max-refresh,
+ * max-resolution or WxH[@Hz] */
+struct mode_rule {
+    struct wl_list link;    //mode_policy::rules
+    char *match;            //NULL matches every output
+    enum mode_policy_type type;
+    int32_t width, height;
+    int32_t refresh;        //mHz, 0 means any
+};
+
+/* "[match=]scale", matched like mode rules. Fractional scales are fine */
+struct scale_rule {
+    struct wl_list link;    //mode_policy::scale_rules
+    char *match;            //NULL matches every output
+    float scale;
+};
+
+struct mode_policy {
+    struct wl_list rules;   //mode_rule::link
+    struct wl_list scale_rules;     //scale_rule::link
+
+    /* From the config file and replaced on reload. Rules given on the
+     * command line are matched first. */
+    struct wl_list config_rules;    //mode_rule::link
+    struct wl_list config_scale_rules;  //scale_rule::link
+
+    enum mode_policy_type fallback;
+};
+
+/* NULL if the rule can't be parsed */
+struct mode_rule *mode_rule_create(const char *rule);
+
+void mode_rule_destroy(struct mode_rule *rule);
+
+/* NULL if the rule can't be parsed */
+struct scale_rule *scale_rule_create(const char *rule);
+
+void scale_rule_destroy(struct scale_rule *rule);
+
+struct mode_policy *mode_policy_create();
+
+void mode_policy_destroy(struct mode_policy *policy);
+
+/* Return false if the rule can't be parsed */
+bool mode_policy_add_rule(struct mode_policy *policy, const char *rule);
+
+/* Return false if the rule can't be parsed */
+bool mode_policy_add_scale_rule(struct mode_policy *policy, const char *rule);
+
+/* Replace the config file rules. If any can't be parsed, the current ones
+ * are kept and false is returned. */
+bool mode_policy_set_config_rules(struct mode_policy *policy,
+        char *const *mode_rules, size_t mode_rules_len,
+        char *const *scale_rules, size_t scale_rules_len);
+
+/* Stage the scale of the first matching rule. Return false if none matched */
+bool mode_policy_apply_scale(struct mode_policy *policy, struct wlr_output *output);
+
+/* Stage the best mode the output accepts in a test commit. The output is
+ * left with the mode pending and enabled. Return false if nothing passed. */
+bool mode_policy_apply(struct mode_policy *policy, struct wlr_output *output);
+
+#endif //SYCAMORE_MODE_POLICY_H
@@ -3,7 +3,10 @@
 
 #include <wlr/types/wlr_output.h>
 #include "sycamore/desktop/layer.h"
+#include "sycamore/util/stats.h"
 
+struct sycamore_mirror;
+struct sycamore_remote;
 struct sycamore_server;
 
 struct sycamore_output {
@@ -12,9 +15,15 @@ struct sycamore_output {
 
     struct wl_list layers[LAYERS_ALL];   //sycamore_layer::link
     struct wlr_box usable_area;
+    bool idle_off;  //powered off by the idle manager
+    bool virtual;   //see virtual_output.h
+    struct stats_render_cost render_cost;
+    struct sycamore_remote *remote;     //streamed to a viewer, NULL for most outputs
+    struct sycamore_mirror *mirror;     //showing another output instead of the scene
 
     struct wl_listener destroy;
-    struct wl_listener frame;
+    struct wl_listener commit;
+    struct wl_listener frame;   //only linked while enabled
 
     struct wlr_scene *scene;
     struct sycamore_server *server;
@@ -22,6 +31,16 @@ struct sycamore_output {
 
 void handle_backend_new_output(struct wl_listener *listener, void *data);
 
+void handle_output_layout_change(struct wl_listener *listener, void *data);
+
+/* Power the output on or off. Disabled outputs stop their frame loop,
+ * whoever disabled them. */
+bool output_set_power(struct sycamore_output *output, bool on);
+
+/* Run the mode policy again, e.g. after its rules changed. Nothing is
+ * committed, so nothing is modeset, if it picks what the output has. */
+void output_apply_mode_policy(struct sycamore_output *output);
+
 void output_get_center_coords(struct sycamore_output *output, struct wlr_fbox *box);
 
 void sycamore_output_destroy(struct sycamore_output *output);
@@ -0,0 +1,29 @@
+#ifndef SYCAMORE_OUTPUT_MANAGER_H
+#define SYCAMORE_OUTPUT_MANAGER_H
+
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output_management_v1.h>
+
+struct sycamore_server;
+
+struct sycamore_output_manager {
+    struct wlr_output_manager_v1 *wlr_output_manager;
+
+    struct wl_listener apply;
+    struct wl_listener test;
+
+    struct wl_event_source *update_idle;
+
+    struct sycamore_server *server;
+};
+
+struct sycamore_output_manager *sycamore_output_manager_create(
+        struct sycamore_server *server, struct wl_display *display);
+
+void sycamore_output_manager_destroy(struct sycamore_output_manager *manager);
+
+/* Send the current configuration to clients once the event loop is idle,
+ * so that a burst of layout changes results in a single update */
+void output_manager_schedule_update(struct sycamore_output_manager *manager);
+
+#endif //SYCAMORE_OUTPUT_MANAGER_H
@@ -0,0 +1,59 @@
+#ifndef SYCAMORE_REMOTE_H
+#define SYCAMORE_REMOTE_H
+
+#include <pixman.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_scene.h>
+
+struct sycamore_server;
+
+/* A headless output streamed to one viewer over a UNIX socket. Only damaged
+ * tiles are sent, and the viewer's input goes to the seat. */
+struct sycamore_remote {
+    struct wlr_output *wlr_output;
+    struct wlr_keyboard keyboard;
+    struct wlr_pointer pointer;
+
+    char *socket_path;
+    int listen_fd;
+    struct wl_event_source *listen_source;
+
+    /* The connected viewer, -1 if none */
+    int fd;
+    struct wl_event_source *fd_source;
+    struct wl_array in;     //partial messages from the viewer
+    struct wl_array out;    //messages not written yet
+    size_t out_offset;
+
+    /* Damage the viewer hasn't got yet, within the last committed buffer */
+    pixman_region32_t pending;
+    struct wlr_buffer *buffer;
+
+    /* What the viewer shows, tiles are delta-encoded against it */
+    uint32_t *shadow;
+    uint32_t *staging;  //readback of buffers without data pointer access
+    int width, height;
+
+    uint32_t seq, acked_seq;
+    uint64_t bytes_sent, tiles_sent, tiles_skipped;
+
+    struct wl_listener output_commit;
+    struct wl_listener output_destroy;
+
+    struct sycamore_server *server;
+};
+
+/* headless must have been started already */
+struct sycamore_remote *sycamore_remote_create(struct sycamore_server *server,
+        struct wlr_backend *headless, const char *socket_path, int width, int height);
+
+void sycamore_remote_destroy(struct sycamore_remote *remote);
+
+/* Called before the output commits, with the damage it is about to repaint */
+void remote_record_damage(struct sycamore_remote *remote, struct wlr_scene_output *scene_output);
+
+#endif //SYCAMORE_REMOTE_H
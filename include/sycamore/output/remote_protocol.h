@@ -0,0 +1,88 @@
+#ifndef SYCAMORE_REMOTE_PROTOCOL_H
+#define SYCAMORE_REMOTE_PROTOCOL_H
+
+#include <stdint.h>
+
+/* Wire format between a remote output and its viewer, shared with
+ * tools/remote_viewer.c. Every message is a remote_msg_header followed by
+ * `length` bytes of body, all in host byte order: both ends are on the
+ * same machine. */
+
+#define REMOTE_PROTOCOL_VERSION 1
+#define REMOTE_TILE_SIZE 64
+#define REMOTE_MSG_MAX_LENGTH \
+        (sizeof(struct remote_tile) + (REMOTE_TILE_SIZE * REMOTE_TILE_SIZE + 1) * 4)
+
+/* RLE packets start with a uint32 header. With REMOTE_RLE_RUN set, one
+ * pixel follows which repeats (header & ~REMOTE_RLE_RUN) times, otherwise
+ * that many literal pixels follow. */
+#define REMOTE_RLE_RUN (1u << 31)
+
+enum remote_msg_type {
+    /* compositor -> viewer */
+    REMOTE_MSG_HELLO = 1,           //remote_hello
+    REMOTE_MSG_TILE,                //remote_tile and its payload
+    REMOTE_MSG_FRAME_END,           //remote_frame_end
+
+    /* viewer -> compositor */
+    REMOTE_MSG_FRAME_ACK = 64,      //remote_frame_ack
+    REMOTE_MSG_KEY,                 //remote_key
+    REMOTE_MSG_POINTER_MOTION,      //remote_pointer_motion
+    REMOTE_MSG_POINTER_BUTTON,      //remote_pointer_button
+    REMOTE_MSG_POINTER_AXIS,        //remote_pointer_axis
+};
+
+enum remote_tile_encoding {
+    REMOTE_TILE_RAW,        //XRGB8888 pixels, row by row
+    REMOTE_TILE_XOR_RLE,    //RLE of the pixels XOR-ed with the previous ones
+};
+
+struct remote_msg_header {
+    uint32_t type;
+    uint32_t length;
+};
+
+/* Sent on connect and whenever the output size changes. The viewer resets
+ * its framebuffer to black, and a full frame follows. */
+struct remote_hello {
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t tile_size;
+};
+
+struct remote_tile {
+    uint16_t x, y;
+    uint16_t width, height;
+    uint32_t encoding;
+};
+
+/* Tiles of one frame end with this, the viewer acks it once displayed */
+struct remote_frame_end {
+    uint32_t seq;
+    uint32_t tiles;
+};
+
+struct remote_frame_ack {
+    uint32_t seq;
+};
+
+struct remote_key {
+    uint32_t keycode;   //evdev
+    uint32_t pressed;
+};
+
+struct remote_pointer_motion {
+    uint32_t x, y;      //output pixels
+};
+
+struct remote_pointer_button {
+    uint32_t button;    //evdev, e.g. BTN_LEFT
+    uint32_t pressed;
+};
+
+struct remote_pointer_axis {
+    uint32_t horizontal;
+    int32_t steps;      //wheel clicks, positive is down or right
+};
+
+#endif //SYCAMORE_REMOTE_PROTOCOL_H
@@ -12,6 +12,7 @@ enum scene_descriptor_type {
     SCENE_DESC_VIEW,
     SCENE_DESC_LAYER,
     SCENE_DESC_POPUP,
+    SCENE_DESC_XWAYLAND_UNMANAGED,
 };
 
 struct sycamore_scene {
@@ -0,0 +1,42 @@
+#ifndef SYCAMORE_VIRTUAL_OUTPUT_H
+#define SYCAMORE_VIRTUAL_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wlr/util/box.h>
+
+/* What Logo+Shift+o adds */
+#define VIRTUAL_OUTPUT_DEFAULT_SPEC "1920x1080"
+
+struct sycamore_output;
+struct sycamore_server;
+
+/* Headless outputs for off-screen rendering and streaming. They are part of
+ * the layout and can be captured, but the cursor never enters them and
+ * layer surfaces only go there when asked for. */
+
+/* WIDTHxHEIGHT[@HZ][+X,Y], e.g. 1280x720@30+0,1080, as taken by the
+ * add-virtual-output action */
+struct virtual_output_spec {
+    int32_t width, height;
+    int refresh;        //mHz, 0 for 60Hz
+    bool positioned;    //right of the layout if not
+    int32_t x, y;       //layout coordinates
+};
+
+bool virtual_output_parse_spec(const char *str, struct virtual_output_spec *spec);
+
+/* Create one at box in layout coordinates, refresh in mHz (0 for 60Hz) */
+struct sycamore_output *virtual_output_create(struct sycamore_server *server,
+        const struct wlr_box *box, int refresh);
+
+struct sycamore_output *virtual_output_create_from_spec(struct sycamore_server *server,
+        const struct virtual_output_spec *spec);
+
+/* NULL if there is no output by that name or it isn't virtual */
+struct sycamore_output *virtual_output_from_name(struct sycamore_server *server,
+        const char *name);
+
+void virtual_output_destroy(struct sycamore_output *output);
+
+#endif //SYCAMORE_VIRTUAL_OUTPUT_H
@@ -10,17 +10,46 @@
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_presentation_time.h>
+#include "sycamore/config.h"
+#include "sycamore/config_watch.h"
+#include "sycamore/desktop/client.h"
+#include "sycamore/desktop/idle.h"
 #include "sycamore/desktop/shell/layer_shell.h"
 #include "sycamore/desktop/shell/xdg_shell.h"
+#include "sycamore/desktop/shell/xwayland.h"
 #include "sycamore/desktop/view.h"
 #include "sycamore/input/keybinding.h"
+#include "sycamore/ipc.h"
 #include "sycamore/input/seat.h"
+#include "sycamore/output/capture.h"
+#include "sycamore/output/mirror.h"
+#include "sycamore/output/mode_policy.h"
+#include "sycamore/output/output_manager.h"
+#include "sycamore/output/remote.h"
+#include "sycamore/output/virtual_output.h"
 #include "sycamore/output/scene.h"
+#include "sycamore/util/launcher.h"
+#include "sycamore/util/pool.h"
+#include "sycamore/util/prefetch.h"
+#include "sycamore/util/startup.h"
+#include "sycamore/util/stats.h"
+
+enum sycamore_pool_type {
+    POOL_XDG_SHELL_VIEW,
+    POOL_LAYER,
+    POOL_SEAT_DEVICE,
+    POOL_KEYBOARD,
+    POOL_POINTER,
+    POOL_DRAG,
+    POOLS_ALL,
+};
 
 struct sycamore_server {
     struct wl_display *wl_display;
 
     struct wlr_backend *backend;
+    struct wlr_backend *headless_backend;   //for virtual and remote outputs
+    const struct wlr_box *new_virtual_output;   //while one is announced, its layout box
     struct wlr_renderer *renderer;
     struct wlr_allocator *allocator;
 
@@ -32,20 +61,42 @@ struct sycamore_server {
     struct sycamore_scene *scene;
     struct sycamore_xdg_shell *xdg_shell;
     struct sycamore_layer_shell *layer_shell;
+    struct sycamore_xwayland *xwayland;     //NULL without WLR_HAS_XWAYLAND or if it failed
     struct sycamore_keybinding_manager *keybinding_manager;
+    struct sycamore_client_manager *client_manager;
+    struct sycamore_stats *stats;
+    struct sycamore_output_manager *output_manager;
+    struct mode_policy *mode_policy;
+    struct sycamore_idle_manager *idle_manager;
+    struct sycamore_remote *remote;
+    struct sycamore_capture_manager *capture_manager;
+    struct sycamore_ipc *ipc;   //NULL without a socket path
+    struct sycamore_mirror_manager *mirror_manager;
+    struct sycamore_prefetch *prefetch;
+    struct sycamore_launcher *launcher;
+    struct sycamore_startup *startup;
+    struct sycamore_config *config;     //replaced as a whole on reload
+    struct sycamore_config_watch *config_watch;
 
     struct wl_listener backend_new_input;
     struct wl_listener backend_new_output;
     struct wl_listener output_layout_change;
 
+    struct wl_event_source *sigusr2;    //dumps stats
+    struct wl_event_source *sighup;     //reloads the config
+
     struct wl_list all_outputs;
     struct wl_list mapped_views;
     struct view_ptr focused_view;
 
+    struct sycamore_pool pools[POOLS_ALL];
+
     const char *socket;
+    bool software_render;   //SYCAMORE_RENDER_PROFILE=software
 };
 
-struct sycamore_server *server_create();
+/* NULL config_path means the default one */
+struct sycamore_server *server_create(const char *config_path);
 
 bool server_start(struct sycamore_server *server);
 
@@ -0,0 +1,37 @@
+#ifndef SYCAMORE_LAUNCHER_H
+#define SYCAMORE_LAUNCHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+
+#define LAUNCHER_MAX_REQUEST 4096
+
+struct sycamore_server;
+
+/* A helper process forked while the compositor is still small. Commands are
+ * sent to it over a socket and started there with posix_spawn, so the
+ * compositor never forks itself and never has children to reap. A request
+ * is a packet of NUL-terminated strings: environment assignments ("NAME=value",
+ * or "NAME" to unset) followed by the command for /bin/sh -c. */
+struct sycamore_launcher {
+    pid_t pid;
+    int fd;
+    struct wl_event_source *sigchld;
+
+    /* Spawned directly, while the helper is gone */
+    struct wl_array orphans;    //pid_t
+
+    uint64_t spawns, spawn_nsec, max_spawn_nsec;
+};
+
+struct sycamore_launcher *sycamore_launcher_create(struct sycamore_server *server,
+        struct wl_display *display);
+
+void sycamore_launcher_destroy(struct sycamore_launcher *launcher);
+
+/* Run a shell command with the compositor's current client environment */
+bool launcher_spawn(struct sycamore_launcher *launcher, const char *command);
+
+#endif //SYCAMORE_LAUNCHER_H
@@ -0,0 +1,32 @@
+#ifndef SYCAMORE_POOL_H
+#define SYCAMORE_POOL_H
+
+#include <stddef.h>
+#include <wayland-util.h>
+
+/* Typed slab allocator. Objects of one size are carved out of slabs and
+ * recycled through a free list, so short-lived objects don't hit malloc.
+ * Slabs are kept until the pool is finished, bounding memory to the peak. */
+struct sycamore_pool {
+    const char *name;
+    size_t object_size;
+    size_t objects_per_slab;
+
+    struct wl_list slabs;   //pool_slab::link
+    void *free_list;
+
+    size_t live;
+    size_t peak;
+    size_t capacity;
+};
+
+void pool_init(struct sycamore_pool *pool, const char *name, size_t object_size);
+
+void pool_finish(struct sycamore_pool *pool);
+
+/* Return a zeroed object, or NULL if allocation failed */
+void *pool_alloc(struct sycamore_pool *pool);
+
+void pool_free(struct sycamore_pool *pool, void *object);
+
+#endif //SYCAMORE_POOL_H
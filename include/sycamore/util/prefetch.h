@@ -0,0 +1,39 @@
+#ifndef SYCAMORE_PREFETCH_H
+#define SYCAMORE_PREFETCH_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_xcursor_manager.h>
+#include <xkbcommon/xkbcommon.h>
+
+struct sycamore_server;
+
+/* Files needed before the first frame, read and compiled on a worker thread
+ * while the backend starts: the cursor theme at scale 1 and the default
+ * keymap. The worker signals a pipe when done and the main loop takes the
+ * results over from there. */
+struct sycamore_prefetch {
+    pthread_t thread;
+    int fds[2];     //written to by the worker when done
+    struct wl_event_source *source;
+    bool done;      //worker joined, results handed over
+
+    /* Filled by the worker, owned by the main thread once joined */
+    struct wlr_xcursor_manager *xcursor_manager;
+    struct xkb_keymap *keymap;
+    uint64_t start_nsec, nsec;
+
+    struct sycamore_server *server;
+};
+
+struct sycamore_prefetch *sycamore_prefetch_start(struct sycamore_server *server);
+
+/* Wait for the worker if it is still running and hand its results over.
+ * Consumers call this before doing the same work themselves. */
+void prefetch_finish(struct sycamore_prefetch *prefetch);
+
+void sycamore_prefetch_destroy(struct sycamore_prefetch *prefetch);
+
+#endif //SYCAMORE_PREFETCH_H
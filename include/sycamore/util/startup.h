@@ -0,0 +1,64 @@
+#ifndef SYCAMORE_STARTUP_H
+#define SYCAMORE_STARTUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+
+enum startup_phase {
+    STARTUP_BACKEND,
+    STARTUP_RENDERER,
+    STARTUP_ALLOCATOR,
+    STARTUP_CORE,           //compositor, output layout and management, presentation
+    STARTUP_SEAT,
+    STARTUP_SCENE,
+    STARTUP_SHELLS,
+    STARTUP_GLOBALS,        //the other protocol globals and managers
+    STARTUP_SOCKET,
+    STARTUP_BACKEND_START,
+    STARTUP_FIRST_MODESET,  //from backend start to the first output modeset
+    STARTUP_FIRST_FRAME,    //from there to the first frame presented
+    STARTUP_PREFETCH,       //on the prefetch thread, in parallel
+    STARTUP_PHASES_ALL,
+};
+
+struct startup_span {
+    uint64_t start_nsec, end_nsec;  //0 if not begun or ended
+};
+
+/* Watches an output for the first modeset and presented frame */
+struct startup_output {
+    struct wl_list link;    //sycamore_startup::outputs
+    struct wl_listener commit;
+    struct wl_listener present;
+    struct wl_listener destroy;
+    struct sycamore_startup *startup;
+};
+
+/* Timing of every startup phase, reported once the first frame is on
+ * screen: as a table in the log and, with SYCAMORE_STARTUP_TRACE set, as a
+ * Chrome trace (chrome://tracing, Perfetto) written to that path. */
+struct sycamore_startup {
+    uint64_t origin_nsec;
+    struct startup_span spans[STARTUP_PHASES_ALL];
+    struct wl_list outputs;     //startup_output::link
+    bool reported;
+};
+
+struct sycamore_startup *sycamore_startup_create();
+
+void sycamore_startup_destroy(struct sycamore_startup *startup);
+
+void startup_begin(struct sycamore_startup *startup, enum startup_phase phase);
+
+void startup_end(struct sycamore_startup *startup, enum startup_phase phase);
+
+/* For phases timed elsewhere, e.g. on another thread */
+void startup_record(struct sycamore_startup *startup, enum startup_phase phase,
+        uint64_t start_nsec, uint64_t end_nsec);
+
+/* Watch a new output until the first frame is presented */
+void startup_watch_output(struct sycamore_startup *startup, struct wlr_output *output);
+
+#endif //SYCAMORE_STARTUP_H
@@ -0,0 +1,66 @@
+#ifndef SYCAMORE_STATS_H
+#define SYCAMORE_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wlr/types/wlr_scene.h>
+
+#define STATS_RING_SIZE 512
+
+struct sycamore_server;
+
+enum stats_damage_mode {
+    DAMAGE_MODE_OFF,
+    DAMAGE_MODE_RECORD,     //record damage to the ring
+    DAMAGE_MODE_HIGHLIGHT,  //also overlay it on the outputs
+    DAMAGE_MODE_ALL,
+};
+
+/* One rendered output frame */
+struct stats_frame {
+    char output[16];
+    uint32_t msec;
+    uint64_t damage_area;   //in buffer pixels
+    uint32_t damage_rects;
+    bool full_damage;
+};
+
+/* Time spent in output commits since the last stats dump */
+struct stats_render_cost {
+    uint64_t frames;
+    uint64_t rendered;      //frames that had damage to repaint
+    uint64_t nsec;
+    uint64_t max_nsec;
+    uint64_t since_nsec;
+
+    /* Since the last IPC_EVENT_FRAME_STATS, reset by the IPC rather than by
+     * stats dumps */
+    uint64_t ipc_max_nsec;
+};
+
+struct sycamore_stats {
+    enum stats_damage_mode damage_mode;
+
+    /* Oldest sample at frames[(frames_head + STATS_RING_SIZE - frames_len) % STATS_RING_SIZE] */
+    struct stats_frame frames[STATS_RING_SIZE];
+    size_t frames_head;
+    size_t frames_len;
+};
+
+struct sycamore_stats *sycamore_stats_create();
+
+void sycamore_stats_destroy(struct sycamore_stats *stats);
+
+/* Record the damage a scene output is about to repaint */
+void stats_record_damage(struct sycamore_stats *stats, struct wlr_scene_output *scene_output);
+
+void stats_record_render(struct stats_render_cost *cost, bool rendered, uint64_t nsec);
+
+/* Cycle off -> record -> highlight */
+void stats_cycle_damage_mode(struct sycamore_server *server);
+
+/* Log a snapshot of the server's internal counters */
+void stats_dump(struct sycamore_server *server);
+
+#endif //SYCAMORE_STATS_H
@@ -5,4 +5,6 @@
 
 uint32_t get_current_time_msec();
 
+uint64_t get_current_time_nsec();
+
 #endif //SYCAMORE_TIME_H
\ No newline at end of file
@@ -0,0 +1,496 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/util/log.h>
+#include "sycamore/config.h"
+#include "sycamore/input/cursor.h"
+#include "sycamore/input/seat.h"
+#include "sycamore/output/mode_policy.h"
+#include "sycamore/output/output.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325
+#define FNV_PRIME 0x100000001b3
+
+static const char *section_names[] = {
+    [CONFIG_KEYBINDINGS] = "keybindings",
+    [CONFIG_CURSOR] = "cursor",
+    [CONFIG_TOUCHPAD] = "touchpad",
+    [CONFIG_OUTPUT] = "output",
+    [CONFIG_WINDOW_RULES] = "window-rules",
+};
+
+static const struct {
+    const char *name;
+    uint32_t modifier;
+} modifier_names[] = {
+    { "shift", WLR_MODIFIER_SHIFT },
+    { "caps", WLR_MODIFIER_CAPS },
+    { "ctrl", WLR_MODIFIER_CTRL },
+    { "alt", WLR_MODIFIER_ALT },
+    { "mod2", WLR_MODIFIER_MOD2 },
+    { "mod3", WLR_MODIFIER_MOD3 },
+    { "logo", WLR_MODIFIER_LOGO },
+    { "super", WLR_MODIFIER_LOGO },
+    { "mod5", WLR_MODIFIER_MOD5 },
+};
+
+/* FNV-1a, NUL included so "ab","c" and "a","bc" differ */
+static uint64_t hash_string(uint64_t hash, const char *str) {
+    do {
+        hash = (hash ^ (uint8_t)*str) * FNV_PRIME;
+    } while (*str++);
+
+    return hash;
+}
+
+static char *trim(char *str) {
+    while (*str == ' ' || *str == '\t') {
+        ++str;
+    }
+
+    char *end = str + strlen(str);
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t' ||
+                         end[-1] == '\n' || end[-1] == '\r')) {
+        --end;
+    }
+    *end = '\0';
+
+    return str;
+}
+
+/* Comments start a line, or follow whitespace */
+static void strip_comment(char *line) {
+    for (char *c = line; *c; ++c) {
+        if (*c == '#' && (c == line || c[-1] == ' ' || c[-1] == '\t')) {
+            *c = '\0';
+            return;
+        }
+    }
+}
+
+static bool parse_bool(const char *str, bool *value) {
+    if (strcmp(str, "true") == 0 || strcmp(str, "yes") == 0 || strcmp(str, "on") == 0) {
+        *value = true;
+        return true;
+    } else if (strcmp(str, "false") == 0 || strcmp(str, "no") == 0 || strcmp(str, "off") == 0) {
+        *value = false;
+        return true;
+    }
+
+    return false;
+}
+
+static bool parse_keybinding(struct sycamore_config *config, char *key, char *value) {
+    struct config_keybinding binding = {0};
+
+    /* modifiers+keysym, the keysym being what xkb produces with those
+     * modifiers held, e.g. logo+shift+S */
+    char *sym_name = strrchr(key, '+');
+    if (!sym_name) {
+        wlr_log(WLR_ERROR, "Keybinding '%s' needs a modifier", key);
+        return false;
+    }
+    *sym_name++ = '\0';
+
+    char *save, *token;
+    for (token = strtok_r(key, "+", &save); token; token = strtok_r(NULL, "+", &save)) {
+        size_t i;
+        for (i = 0; i < sizeof(modifier_names) / sizeof(modifier_names[0]); ++i) {
+            if (strcasecmp(token, modifier_names[i].name) == 0) {
+                binding.modifiers |= modifier_names[i].modifier;
+                break;
+            }
+        }
+        if (i == sizeof(modifier_names) / sizeof(modifier_names[0])) {
+            wlr_log(WLR_ERROR, "Unknown modifier '%s'", token);
+            return false;
+        }
+    }
+
+    binding.sym = xkb_keysym_from_name(sym_name, XKB_KEYSYM_NO_FLAGS);
+    if (binding.sym == XKB_KEY_NoSymbol) {
+        binding.sym = xkb_keysym_from_name(sym_name, XKB_KEYSYM_CASE_INSENSITIVE);
+    }
+    if (binding.sym == XKB_KEY_NoSymbol || binding.modifiers == 0) {
+        wlr_log(WLR_ERROR, "Invalid keybinding key '%s'", sym_name);
+        return false;
+    }
+
+    /* action [argument] */
+    char *argument = value + strcspn(value, " \t");
+    if (*argument) {
+        *argument++ = '\0';
+        argument = trim(argument);
+    }
+
+    if (!keybinding_action_from_name(value, &binding.action)) {
+        wlr_log(WLR_ERROR, "Unknown keybinding action '%s'", value);
+        return false;
+    }
+
+    if (!keybinding_action_check_argument(binding.action, *argument ? argument : NULL)) {
+        wlr_log(WLR_ERROR, *argument ? "Invalid argument for keybinding action '%s'" :
+                "Keybinding action '%s' needs an argument", value);
+        return false;
+    }
+
+    if (*argument) {
+        binding.argument = strdup(argument);
+        if (!binding.argument) {
+            return false;
+        }
+    }
+
+    struct config_keybinding *slot = wl_array_add(&config->keybindings, sizeof(binding));
+    if (!slot) {
+        free(binding.argument);
+        return false;
+    }
+    *slot = binding;
+
+    return true;
+}
+
+static bool parse_cursor(struct sycamore_config *config, const char *key, const char *value) {
+    if (strcmp(key, "theme") == 0) {
+        free(config->cursor.theme);
+        config->cursor.theme = strdup(value);
+        return config->cursor.theme != NULL;
+    } else if (strcmp(key, "size") == 0) {
+        char *end;
+        unsigned long size = strtoul(value, &end, 10);
+        if (end == value || *end != '\0' || size == 0 || size > 256) {
+            wlr_log(WLR_ERROR, "Invalid cursor size '%s'", value);
+            return false;
+        }
+        config->cursor.size = size;
+        return true;
+    }
+
+    wlr_log(WLR_ERROR, "Unknown cursor key '%s'", key);
+    return false;
+}
+
+static bool parse_touchpad(struct sycamore_config *config, const char *key, const char *value) {
+    if (strcmp(key, "tap") == 0) {
+        return parse_bool(value, &config->touchpad.tap);
+    } else if (strcmp(key, "natural-scroll") == 0) {
+        return parse_bool(value, &config->touchpad.natural_scroll);
+    } else if (strcmp(key, "accel-speed") == 0) {
+        char *end;
+        double speed = strtod(value, &end);
+        if (end == value || *end != '\0' || speed < -1.0 || speed > 1.0) {
+            wlr_log(WLR_ERROR, "Invalid touchpad accel-speed '%s', expected -1 to 1", value);
+            return false;
+        }
+        config->touchpad.accel_speed = speed;
+        return true;
+    }
+
+    wlr_log(WLR_ERROR, "Unknown touchpad key '%s'", key);
+    return false;
+}
+
+static bool add_string(struct wl_array *array, const char *str) {
+    char **slot = wl_array_add(array, sizeof(char *));
+    if (!slot) {
+        return false;
+    }
+
+    *slot = strdup(str);
+    if (!*slot) {
+        array->size -= sizeof(char *);
+        return false;
+    }
+
+    return true;
+}
+
+static bool parse_output(struct sycamore_config *config, const char *key, const char *value) {
+    /* Rules are parsed again when applied, this is just to reject them early */
+    if (strcmp(key, "mode") == 0) {
+        struct mode_rule *rule = mode_rule_create(value);
+        if (!rule) {
+            return false;
+        }
+        mode_rule_destroy(rule);
+        return add_string(&config->output.mode_rules, value);
+    } else if (strcmp(key, "scale") == 0) {
+        struct scale_rule *rule = scale_rule_create(value);
+        if (!rule) {
+            return false;
+        }
+        scale_rule_destroy(rule);
+        return add_string(&config->output.scale_rules, value);
+    }
+
+    wlr_log(WLR_ERROR, "Unknown output key '%s'", key);
+    return false;
+}
+
+static bool config_parse_entry(struct sycamore_config *config, enum config_section section,
+        char *key, char *value) {
+    switch (section) {
+        case CONFIG_KEYBINDINGS:
+            return parse_keybinding(config, key, value);
+        case CONFIG_CURSOR:
+            return parse_cursor(config, key, value);
+        case CONFIG_TOUCHPAD:
+            return parse_touchpad(config, key, value);
+        case CONFIG_OUTPUT:
+            return parse_output(config, key, value);
+        case CONFIG_WINDOW_RULES:
+            return window_rules_add(config->window_rules, key, value);
+        default:
+            return false;
+    }
+}
+
+static bool config_parse(struct sycamore_config *config, FILE *f) {
+    int section = -1;
+    char *line = NULL;
+    size_t line_size = 0;
+    int line_number = 0;
+    bool ok = true;
+
+    while (ok && getline(&line, &line_size, f) != -1) {
+        ++line_number;
+        strip_comment(line);
+        char *str = trim(line);
+        if (*str == '\0') {
+            continue;
+        }
+
+        if (*str == '[') {
+            char *end = strchr(str, ']');
+            if (!end || end[1] != '\0') {
+                wlr_log(WLR_ERROR, "%s:%d: Invalid section header", config->path, line_number);
+                ok = false;
+                break;
+            }
+            *end = '\0';
+
+            section = -1;
+            for (int i = 0; i < CONFIG_SECTIONS_ALL; ++i) {
+                if (strcmp(str + 1, section_names[i]) == 0) {
+                    section = i;
+                }
+            }
+            if (section < 0) {
+                wlr_log(WLR_ERROR, "%s:%d: Unknown section '%s'",
+                        config->path, line_number, str + 1);
+                ok = false;
+                break;
+            }
+
+            /* An empty section is still there */
+            if (config->hashes[section] == 0) {
+                config->hashes[section] = FNV_OFFSET;
+            }
+            continue;
+        }
+
+        char *separator = strchr(str, '=');
+        if (section < 0 || !separator) {
+            wlr_log(WLR_ERROR, "%s:%d: Expected 'key = value' in a section",
+                    config->path, line_number);
+            ok = false;
+            break;
+        }
+        *separator = '\0';
+        char *key = trim(str), *value = trim(separator + 1);
+
+        config->hashes[section] = hash_string(hash_string(config->hashes[section], key), value);
+
+        if (!config_parse_entry(config, section, key, value)) {
+            wlr_log(WLR_ERROR, "%s:%d: Invalid entry in [%s]", config->path,
+                    line_number, section_names[section]);
+            ok = false;
+        }
+    }
+
+    free(line);
+    return ok;
+}
+
+char *config_default_path() {
+    char *path = NULL;
+    const char *config_home = getenv("XDG_CONFIG_HOME");
+    const char *home = getenv("HOME");
+    if (config_home && *config_home) {
+        if (asprintf(&path, "%s/sycamore/config", config_home) < 0) {
+            return NULL;
+        }
+    } else if (home) {
+        if (asprintf(&path, "%s/.config/sycamore/config", home) < 0) {
+            return NULL;
+        }
+    }
+
+    return path;
+}
+
+struct sycamore_config *sycamore_config_load(const char *path) {
+    struct sycamore_config *config = calloc(1, sizeof(struct sycamore_config));
+    if (!config) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_config");
+        return NULL;
+    }
+
+    wl_array_init(&config->keybindings);
+    wl_array_init(&config->output.mode_rules);
+    wl_array_init(&config->output.scale_rules);
+    config->cursor.size = XCURSOR_DEFAULT_SIZE;
+    config->touchpad.tap = true;
+    config->touchpad.natural_scroll = true;
+    config->touchpad.accel_speed = 0.3;
+
+    config->window_rules = window_rules_create();
+    if (!config->window_rules) {
+        sycamore_config_destroy(config);
+        return NULL;
+    }
+
+    if (!path) {
+        return config;
+    }
+
+    config->path = strdup(path);
+    if (!config->path) {
+        sycamore_config_destroy(config);
+        return NULL;
+    }
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        if (errno == ENOENT) {
+            wlr_log(WLR_INFO, "No config file at %s, using the defaults", path);
+            return config;
+        }
+        wlr_log_errno(WLR_ERROR, "Unable to open config file %s", path);
+        sycamore_config_destroy(config);
+        return NULL;
+    }
+
+    bool ok = config_parse(config, f) && window_rules_compile(config->window_rules);
+    fclose(f);
+
+    if (!ok) {
+        sycamore_config_destroy(config);
+        return NULL;
+    }
+
+    return config;
+}
+
+void sycamore_config_destroy(struct sycamore_config *config) {
+    if (!config) {
+        return;
+    }
+
+    struct config_keybinding *binding;
+    wl_array_for_each(binding, &config->keybindings) {
+        free(binding->argument);
+    }
+    wl_array_release(&config->keybindings);
+
+    char **rule;
+    wl_array_for_each(rule, &config->output.mode_rules) {
+        free(*rule);
+    }
+    wl_array_release(&config->output.mode_rules);
+    wl_array_for_each(rule, &config->output.scale_rules) {
+        free(*rule);
+    }
+    wl_array_release(&config->output.scale_rules);
+
+    window_rules_destroy(config->window_rules);
+    free(config->cursor.theme);
+    free(config->path);
+    free(config);
+}
+
+uint32_t config_diff(const struct sycamore_config *a, const struct sycamore_config *b) {
+    uint32_t changed = 0;
+    for (int i = 0; i < CONFIG_SECTIONS_ALL; ++i) {
+        if (!a || !b || a->hashes[i] != b->hashes[i]) {
+            changed |= 1 << i;
+        }
+    }
+
+    return changed;
+}
+
+static void config_apply_keybindings(struct sycamore_server *server) {
+    /* Built from scratch aside and swapped in */
+    struct sycamore_keybinding_manager *manager = sycamore_keybinding_manager_create(server);
+    if (!manager) {
+        wlr_log(WLR_ERROR, "Unable to rebuild keybindings, keeping the current ones");
+        return;
+    }
+
+    sycamore_keybinding_manager_destroy(server->keybinding_manager);
+    server->keybinding_manager = manager;
+}
+
+static void config_apply_output(struct sycamore_server *server) {
+    struct sycamore_config *config = server->config;
+    if (!mode_policy_set_config_rules(server->mode_policy,
+            config->output.mode_rules.data,
+            config->output.mode_rules.size / sizeof(char *),
+            config->output.scale_rules.data,
+            config->output.scale_rules.size / sizeof(char *))) {
+        wlr_log(WLR_ERROR, "Unable to set output rules, keeping the current ones");
+        return;
+    }
+
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        output_apply_mode_policy(output);
+    }
+}
+
+void config_apply(struct sycamore_server *server, struct sycamore_config *config) {
+    uint64_t start = get_current_time_nsec();
+
+    /* The prefetch thread reads the cursor section of the current config */
+    prefetch_finish(server->prefetch);
+
+    struct sycamore_config *old = server->config;
+    uint32_t changed = config_diff(old, config);
+    server->config = config;
+
+    if (changed & (1 << CONFIG_KEYBINDINGS)) {
+        config_apply_keybindings(server);
+    }
+    if (changed & (1 << CONFIG_CURSOR)) {
+        xcursor_reload(server->seat->cursor);
+    }
+    if (changed & (1 << CONFIG_TOUCHPAD)) {
+        seat_configure_touchpads(server->seat);
+    }
+    if (changed & (1 << CONFIG_OUTPUT)) {
+        config_apply_output(server);
+    }
+    /* Window rules are looked up as views open, views already open keep
+     * what they got */
+
+    char sections[64] = "";
+    for (int i = 0; i < CONFIG_SECTIONS_ALL; ++i) {
+        if (changed & (1 << i)) {
+            strncat(sections, " ", sizeof(sections) - strlen(sections) - 1);
+            strncat(sections, section_names[i], sizeof(sections) - strlen(sections) - 1);
+        }
+    }
+    wlr_log(WLR_INFO, "Applied config in %" PRIu64 " us, changed:%s",
+            (get_current_time_nsec() - start) / 1000, changed ? sections : " nothing");
+
+    sycamore_config_destroy(old);
+}
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "sycamore/config.h"
+#include "sycamore/config_watch.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+static void *config_watch_run(void *data) {
+    struct sycamore_config_watch *watch = data;
+
+    uint64_t start = get_current_time_nsec();
+    watch->result = sycamore_config_load(watch->path);
+    watch->parse_nsec = get_current_time_nsec() - start;
+
+    char byte = 0;
+    while (write(watch->fds[1], &byte, 1) < 0 && errno == EINTR) {}
+
+    return NULL;
+}
+
+static void config_watch_parse(struct sycamore_config_watch *watch) {
+    if (watch->parsing) {
+        watch->pending = true;
+        return;
+    }
+
+    /* Signals are for the main loop, which turns them into events */
+    sigset_t mask, old_mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, &old_mask);
+    int ret = pthread_create(&watch->thread, NULL, config_watch_run, watch);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    if (ret != 0) {
+        wlr_log(WLR_ERROR, "Unable to start config parse thread");
+        return;
+    }
+
+    watch->parsing = true;
+    watch->pending = false;
+}
+
+static void config_watch_join(struct sycamore_config_watch *watch) {
+    pthread_join(watch->thread, NULL);
+    watch->parsing = false;
+
+    char byte;
+    while (read(watch->fds[0], &byte, 1) < 0 && errno == EINTR) {}
+}
+
+static int handle_parse_done(int fd, uint32_t mask, void *data) {
+    struct sycamore_config_watch *watch = data;
+
+    config_watch_join(watch);
+    struct sycamore_config *config = watch->result;
+    watch->result = NULL;
+
+    if (watch->pending) {
+        /* Stale already, the next one is parsed instead */
+        sycamore_config_destroy(config);
+        config_watch_parse(watch);
+        return 0;
+    }
+
+    if (!config) {
+        wlr_log(WLR_ERROR, "Invalid config, keeping the current one");
+        return 0;
+    }
+
+    wlr_log(WLR_DEBUG, "Parsed config in %" PRIu64 " us off the main thread",
+            watch->parse_nsec / 1000);
+    config_apply(watch->server, config);
+    return 0;
+}
+
+static int handle_debounce_timer(void *data) {
+    struct sycamore_config_watch *watch = data;
+
+    config_watch_parse(watch);
+    return 0;
+}
+
+static int handle_inotify(int fd, uint32_t mask, void *data) {
+    struct sycamore_config_watch *watch = data;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    for (;;) {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        } else if (len <= 0) {
+            break;
+        }
+
+        const struct inotify_event *event;
+        for (char *ptr = buf; ptr < buf + len; ptr += sizeof(*event) + event->len) {
+            event = (const struct inotify_event *)ptr;
+            if (event->len > 0 && strcmp(event->name, watch->name) == 0) {
+                changed = true;
+            }
+        }
+    }
+
+    /* Every change pushes the reload back, until they stop */
+    if (changed) {
+        wl_event_source_timer_update(watch->debounce_timer, CONFIG_WATCH_DEBOUNCE_MSEC);
+    }
+
+    return 0;
+}
+
+static void config_watch_add_inotify(struct sycamore_config_watch *watch,
+        struct wl_event_loop *loop) {
+    char *separator = strrchr(watch->path, '/');
+    watch->name = separator ? separator + 1 : watch->path;
+
+    watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->inotify_fd < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to init inotify");
+        return;
+    }
+
+    char *dir = separator ? strndup(watch->path, separator - watch->path) : strdup(".");
+    if (!dir) {
+        return;
+    }
+
+    int wd = inotify_add_watch(watch->inotify_fd, *dir ? dir : "/",
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    if (wd < 0) {
+        wlr_log_errno(WLR_INFO, "Not watching config directory %s", dir);
+        free(dir);
+        return;
+    }
+    free(dir);
+
+    watch->inotify_source = wl_event_loop_add_fd(loop, watch->inotify_fd,
+                                                 WL_EVENT_READABLE, handle_inotify, watch);
+    if (!watch->inotify_source) {
+        wlr_log(WLR_ERROR, "Unable to add inotify event source");
+    }
+}
+
+void config_watch_reload(struct sycamore_config_watch *watch) {
+    config_watch_parse(watch);
+}
+
+struct sycamore_config_watch *sycamore_config_watch_create(struct sycamore_server *server,
+        const char *path) {
+    struct sycamore_config_watch *watch = calloc(1, sizeof(struct sycamore_config_watch));
+    if (!watch) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_config_watch");
+        return NULL;
+    }
+
+    watch->server = server;
+    watch->inotify_fd = -1;
+
+    if (path) {
+        watch->path = strdup(path);
+        if (!watch->path) {
+            free(watch);
+            return NULL;
+        }
+    }
+
+    if (pipe2(watch->fds, O_CLOEXEC) < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to create config watch pipe");
+        free(watch->path);
+        free(watch);
+        return NULL;
+    }
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(server->wl_display);
+    watch->done_source = wl_event_loop_add_fd(loop, watch->fds[0], WL_EVENT_READABLE,
+                                              handle_parse_done, watch);
+    watch->debounce_timer = wl_event_loop_add_timer(loop, handle_debounce_timer, watch);
+    if (!watch->done_source || !watch->debounce_timer) {
+        wlr_log(WLR_ERROR, "Unable to add config watch event sources");
+        sycamore_config_watch_destroy(watch);
+        return NULL;
+    }
+
+    /* Without inotify, reloads still work on request */
+    if (watch->path) {
+        config_watch_add_inotify(watch, loop);
+    }
+
+    return watch;
+}
+
+void sycamore_config_watch_destroy(struct sycamore_config_watch *watch) {
+    if (!watch) {
+        return;
+    }
+
+    if (watch->parsing) {
+        config_watch_join(watch);
+    }
+    sycamore_config_destroy(watch->result);
+
+    if (watch->inotify_source) {
+        wl_event_source_remove(watch->inotify_source);
+    }
+    if (watch->inotify_fd >= 0) {
+        close(watch->inotify_fd);
+    }
+    if (watch->debounce_timer) {
+        wl_event_source_remove(watch->debounce_timer);
+    }
+    if (watch->done_source) {
+        wl_event_source_remove(watch->done_source);
+    }
+    close(watch->fds[0]);
+    close(watch->fds[1]);
+
+    free(watch->path);
+    free(watch);
+}
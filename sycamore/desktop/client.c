@@ -0,0 +1,714 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/addon.h>
+#include <wlr/util/log.h>
+#include "sycamore/desktop/client.h"
+#include "sycamore/output/output.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+#define CLIENT_RATE_INTERVAL_MSEC 1000
+#define CLIENT_COMMIT_BURST_DEFAULT 8
+#define CLIENT_FALLBACK_REFRESH_HZ 60
+#define CLIENT_DISPATCH_BUDGET_DEFAULT_USEC 2000
+#define CLIENT_MAX_DEFERRED_STATES 4
+
+struct client_surface {
+    struct wl_list link;    //sycamore_client::surfaces
+    struct wlr_surface *wlr_surface;
+    struct wlr_addon addon;
+
+    size_t shm_bytes;
+    size_t dmabuf_bytes;
+    uint32_t last_frame_msec;
+    uint32_t frame_interval_msec;   //from a window rule's frame rate cap
+
+    /* Commit token bucket, refilled at twice the fastest output refresh rate */
+    double commit_tokens;
+    uint32_t last_refill_msec;
+
+    bool deferred;
+    uint32_t deferred_seq;
+    struct wl_list deferred_link;   //sycamore_client_manager::deferred_surfaces
+
+    struct wl_listener client_commit;
+    struct wl_listener commit;
+
+    struct sycamore_client *client;
+    struct sycamore_client_manager *manager;
+};
+
+static void client_check_limits(struct sycamore_client *client) {
+    const struct sycamore_client_limits *limits = &client->manager->limits;
+
+    const char *reason = NULL;
+    if (limits->max_commit_rate && client->commit_rate > limits->max_commit_rate) {
+        reason = "commit rate";
+    } else if (limits->max_buffer_bytes &&
+               client->shm_bytes + client->dmabuf_bytes > limits->max_buffer_bytes) {
+        reason = "buffer memory";
+    } else if (limits->max_surfaces && client->surfaces_len > limits->max_surfaces) {
+        reason = "surface count";
+    }
+
+    bool over_limit = reason != NULL;
+    if (over_limit && !client->over_limit) {
+        wlr_log(WLR_INFO, "Client %d exceeds %s limit (%u commits/s, %zu surfaces, %zu KiB)%s",
+                client->pid, reason, client->commit_rate, client->surfaces_len,
+                (client->shm_bytes + client->dmabuf_bytes) / 1024,
+                limits->throttle ? ", throttling" : "");
+    } else if (!over_limit && client->over_limit) {
+        wlr_log(WLR_INFO, "Client %d is back within limits", client->pid);
+    }
+
+    client->over_limit = over_limit;
+    client->throttled = over_limit && limits->throttle;
+}
+
+static void client_surface_update_buffer(struct client_surface *surface) {
+    struct sycamore_client *client = surface->client;
+    client->shm_bytes -= surface->shm_bytes;
+    client->dmabuf_bytes -= surface->dmabuf_bytes;
+    surface->shm_bytes = 0;
+    surface->dmabuf_bytes = 0;
+
+    struct wlr_client_buffer *buffer = surface->wlr_surface->buffer;
+    if (buffer) {
+        struct wlr_dmabuf_attributes attribs;
+        if (buffer->source && wlr_buffer_get_dmabuf(buffer->source, &attribs)) {
+            for (int i = 0; i < attribs.n_planes; ++i) {
+                surface->dmabuf_bytes += (size_t)attribs.stride[i] * attribs.height;
+            }
+        } else {
+            /* Shared memory, assume 32bpp */
+            surface->shm_bytes = (size_t)buffer->base.width * buffer->base.height * 4;
+        }
+    }
+
+    client->shm_bytes += surface->shm_bytes;
+    client->dmabuf_bytes += surface->dmabuf_bytes;
+}
+
+static uint32_t client_manager_max_refresh(struct sycamore_client_manager *manager) {
+    int32_t max_refresh = 0;   //mHz
+    struct sycamore_output *output;
+    wl_list_for_each(output, &manager->server->all_outputs, link) {
+        if (output->wlr_output->refresh > max_refresh) {
+            max_refresh = output->wlr_output->refresh;
+        }
+    }
+
+    return max_refresh > 0 ? (max_refresh + 999) / 1000 : CLIENT_FALLBACK_REFRESH_HZ;
+}
+
+/* Return false if this commit exhausted the surface's bucket */
+static bool client_surface_take_token(struct client_surface *surface) {
+    struct sycamore_client_manager *manager = surface->manager;
+    uint32_t now = get_current_time_msec();
+    uint32_t elapsed = now - surface->last_refill_msec;
+    surface->last_refill_msec = now;
+
+    double burst = manager->limits.commit_burst;
+    surface->commit_tokens += elapsed * 2.0 * client_manager_max_refresh(manager) / 1000.0;
+    if (surface->commit_tokens > burst) {
+        surface->commit_tokens = burst;
+    }
+
+    if (surface->commit_tokens < 1.0) {
+        return false;
+    }
+
+    surface->commit_tokens -= 1.0;
+    return true;
+}
+
+static bool client_manager_frames_running(struct sycamore_client_manager *manager) {
+    struct sycamore_output *output;
+    wl_list_for_each(output, &manager->server->all_outputs, link) {
+        if (output->wlr_output->enabled && !output->mirror) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Cache the surface's next commits until the next output frame */
+static void client_surface_defer(struct client_surface *surface) {
+    if (surface->deferred) {
+        return;
+    }
+
+    struct sycamore_client_manager *manager = surface->manager;
+    surface->deferred_seq = wlr_surface_lock_pending(surface->wlr_surface);
+    surface->deferred = true;
+    wl_list_insert(&manager->deferred_surfaces, &surface->deferred_link);
+
+    if (surface->client) {
+        surface->client->deferred_commits++;
+    }
+
+    /* Make sure something comes to apply the cached commits. Mirrors and
+     * disabled outputs don't flush, so without any other output a timer does. */
+    if (!client_manager_frames_running(manager)) {
+        wl_event_source_timer_update(manager->flush_timer,
+                                     1000 / CLIENT_FALLBACK_REFRESH_HZ);
+        return;
+    }
+
+    struct sycamore_output *output;
+    wl_list_for_each(output, &manager->server->all_outputs, link) {
+        if (output->wlr_output->enabled && !output->mirror) {
+            wlr_output_schedule_frame(output->wlr_output);
+        }
+    }
+}
+
+static void client_surface_flush(struct client_surface *surface) {
+    wl_list_remove(&surface->deferred_link);
+    surface->deferred = false;
+    wlr_surface_unlock_cached(surface->wlr_surface, surface->deferred_seq);
+}
+
+/* Fold the surface's deferred state into the one being committed, which gets
+ * cached in its place, so a deferred surface holds a single state: the newest,
+ * carrying the damage and frame callbacks of those it replaced. */
+static bool client_surface_squash_deferred(struct client_surface *surface) {
+    struct wlr_surface *wlr_surface = surface->wlr_surface;
+    if (wl_list_length(&wlr_surface->cached) != 1) {
+        return false;
+    }
+
+    struct wlr_surface_state *old =
+            wl_container_of(wlr_surface->cached.next, old, cached_state_link);
+    struct wlr_surface_state *next = &wlr_surface->pending;
+
+    /* Leave states alone that others locked too, like a synchronized
+     * subsurface's, or that carry subsurface order */
+    if (old->seq != surface->deferred_seq || old->cached_state_locks != 1 ||
+            !wl_list_empty(&old->subsurfaces_below) ||
+            !wl_list_empty(&old->subsurfaces_above)) {
+        return false;
+    }
+
+    if (old->committed & WLR_SURFACE_STATE_BUFFER) {
+        if (next->committed & WLR_SURFACE_STATE_BUFFER) {
+            next->dx += old->dx;
+            next->dy += old->dy;
+            wlr_buffer_unlock(old->buffer);
+        } else {
+            wlr_buffer_unlock(next->buffer);
+            next->buffer = old->buffer;
+            next->dx = old->dx;
+            next->dy = old->dy;
+            next->width = old->width;
+            next->height = old->height;
+            next->buffer_width = old->buffer_width;
+            next->buffer_height = old->buffer_height;
+        }
+        old->buffer = NULL;
+    }
+
+    pixman_region32_union(&next->surface_damage,
+                          &next->surface_damage, &old->surface_damage);
+    pixman_region32_union(&next->buffer_damage,
+                          &next->buffer_damage, &old->buffer_damage);
+
+    if ((old->committed & WLR_SURFACE_STATE_OPAQUE_REGION) &&
+            !(next->committed & WLR_SURFACE_STATE_OPAQUE_REGION)) {
+        pixman_region32_copy(&next->opaque, &old->opaque);
+    }
+    if ((old->committed & WLR_SURFACE_STATE_INPUT_REGION) &&
+            !(next->committed & WLR_SURFACE_STATE_INPUT_REGION)) {
+        pixman_region32_copy(&next->input, &old->input);
+    }
+    if ((old->committed & WLR_SURFACE_STATE_TRANSFORM) &&
+            !(next->committed & WLR_SURFACE_STATE_TRANSFORM)) {
+        next->transform = old->transform;
+    }
+    if ((old->committed & WLR_SURFACE_STATE_SCALE) &&
+            !(next->committed & WLR_SURFACE_STATE_SCALE)) {
+        next->scale = old->scale;
+    }
+    if ((old->committed & WLR_SURFACE_STATE_VIEWPORT) &&
+            !(next->committed & WLR_SURFACE_STATE_VIEWPORT)) {
+        next->viewport = old->viewport;
+    }
+
+    /* The older callbacks go first, they're all done by the same frame */
+    wl_list_insert_list(&next->frame_callback_list, &old->frame_callback_list);
+    next->committed |= old->committed;
+
+    wl_list_remove(&old->cached_state_link);
+    pixman_region32_fini(&old->surface_damage);
+    pixman_region32_fini(&old->buffer_damage);
+    pixman_region32_fini(&old->opaque);
+    pixman_region32_fini(&old->input);
+    free(old);
+
+    surface->deferred_seq = wlr_surface_lock_pending(wlr_surface);
+    return true;
+}
+
+/* Emitted before the commit gets applied or cached */
+static void handle_client_surface_client_commit(struct wl_listener *listener, void *data) {
+    struct client_surface *surface = wl_container_of(listener, surface, client_commit);
+    if (!surface->deferred || client_surface_squash_deferred(surface)) {
+        return;
+    }
+
+    /* States that can't be squashed are applied early rather than piling up */
+    if (wl_list_length(&surface->wlr_surface->cached) >= CLIENT_MAX_DEFERRED_STATES) {
+        client_surface_flush(surface);
+    }
+}
+
+static void client_surface_destroy(struct client_surface *surface) {
+    /* The pending lock dies with the surface */
+    if (surface->deferred) {
+        wl_list_remove(&surface->deferred_link);
+    }
+
+    if (surface->client) {
+        struct sycamore_client *client = surface->client;
+        client->shm_bytes -= surface->shm_bytes;
+        client->dmabuf_bytes -= surface->dmabuf_bytes;
+        client->surfaces_len--;
+    }
+
+    wl_list_remove(&surface->link);
+    wl_list_remove(&surface->client_commit.link);
+    wl_list_remove(&surface->commit.link);
+    wlr_addon_finish(&surface->addon);
+
+    free(surface);
+}
+
+static void client_surface_addon_destroy(struct wlr_addon *addon) {
+    struct client_surface *surface = wl_container_of(addon, surface, addon);
+
+    client_surface_destroy(surface);
+}
+
+static const struct wlr_addon_interface client_surface_addon_impl = {
+    .name = "sycamore_client_surface",
+    .destroy = client_surface_addon_destroy,
+};
+
+static struct client_surface *client_surface_from_wlr_surface(
+        struct sycamore_client_manager *manager, struct wlr_surface *wlr_surface) {
+    struct wlr_addon *addon = wlr_addon_find(&wlr_surface->addons,
+                                             manager, &client_surface_addon_impl);
+    if (!addon) {
+        return NULL;
+    }
+
+    struct client_surface *surface = wl_container_of(addon, surface, addon);
+    return surface;
+}
+
+static void handle_client_surface_commit(struct wl_listener *listener, void *data) {
+    struct client_surface *surface = wl_container_of(listener, surface, commit);
+    struct sycamore_client *client = surface->client;
+    if (!client) {
+        return;
+    }
+
+    client->commits++;
+    client_surface_update_buffer(surface);
+
+    if (!client->over_limit) {
+        client_check_limits(client);
+    }
+
+    /* Clients over their dispatch budget only get their commits applied
+     * once per frame, so their scene updates can't crowd out input */
+    if (client->over_budget) {
+        client_surface_defer(surface);
+    } else if (surface->manager->limits.commit_burst &&
+            !client_surface_take_token(surface)) {
+        client_surface_defer(surface);
+    }
+}
+
+static void client_destroy(struct sycamore_client *client) {
+    /* Surfaces may outlive the client struct, since the client destroy
+     * signal is emitted before its resources are destroyed. */
+    struct client_surface *surface, *next;
+    wl_list_for_each_safe(surface, next, &client->surfaces, link) {
+        wl_list_remove(&surface->link);
+        wl_list_init(&surface->link);
+        surface->client = NULL;
+    }
+
+    if (client->manager->dispatch_client == client) {
+        client->manager->dispatch_client = NULL;
+    }
+
+    wl_list_remove(&client->link);
+    wl_list_remove(&client->destroy.link);
+
+    free(client);
+}
+
+static void handle_client_destroy(struct wl_listener *listener, void *data) {
+    struct sycamore_client *client = wl_container_of(listener, client, destroy);
+
+    client_destroy(client);
+}
+
+static struct sycamore_client *client_create(struct sycamore_client_manager *manager,
+        struct wl_client *wl_client) {
+    struct sycamore_client *client = calloc(1, sizeof(struct sycamore_client));
+    if (!client) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_client");
+        return NULL;
+    }
+
+    client->wl_client = wl_client;
+    client->manager = manager;
+    wl_list_init(&client->surfaces);
+    wl_client_get_credentials(wl_client, &client->pid, NULL, NULL);
+
+    client->destroy.notify = handle_client_destroy;
+    wl_client_add_destroy_listener(wl_client, &client->destroy);
+
+    wl_list_insert(&manager->clients, &client->link);
+
+    return client;
+}
+
+static struct sycamore_client *client_from_wl_client(struct sycamore_client_manager *manager,
+        struct wl_client *wl_client) {
+    struct wl_listener *listener =
+            wl_client_get_destroy_listener(wl_client, handle_client_destroy);
+    if (listener) {
+        struct sycamore_client *client = wl_container_of(listener, client, destroy);
+        return client;
+    }
+
+    return client_create(manager, wl_client);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+    struct sycamore_client_manager *manager =
+            wl_container_of(listener, manager, new_surface);
+    struct wlr_surface *wlr_surface = data;
+
+    struct sycamore_client *client = client_from_wl_client(manager,
+            wl_resource_get_client(wlr_surface->resource));
+    if (!client) {
+        return;
+    }
+
+    struct client_surface *surface = calloc(1, sizeof(struct client_surface));
+    if (!surface) {
+        wlr_log(WLR_ERROR, "Unable to allocate client_surface");
+        return;
+    }
+
+    surface->wlr_surface = wlr_surface;
+    surface->client = client;
+    surface->manager = manager;
+    surface->commit_tokens = manager->limits.commit_burst;
+    surface->last_refill_msec = get_current_time_msec();
+    wlr_addon_init(&surface->addon, &wlr_surface->addons,
+                   manager, &client_surface_addon_impl);
+
+    surface->client_commit.notify = handle_client_surface_client_commit;
+    wl_signal_add(&wlr_surface->events.client_commit, &surface->client_commit);
+    surface->commit.notify = handle_client_surface_commit;
+    wl_signal_add(&wlr_surface->events.commit, &surface->commit);
+
+    wl_list_insert(&client->surfaces, &surface->link);
+    client->surfaces_len++;
+
+    client_check_limits(client);
+}
+
+static int handle_rate_timer(void *data) {
+    struct sycamore_client_manager *manager = data;
+
+    struct sycamore_client *client;
+    wl_list_for_each(client, &manager->clients, link) {
+        client->commit_rate = client->commits;
+        client->commits = 0;
+        client_check_limits(client);
+
+        client->dispatch_load_usec = client->dispatch_interval_nsec / 1000;
+        client->dispatch_interval_nsec = 0;
+        if (client->over_budget && client->budget_overruns == 0) {
+            wlr_log(WLR_INFO, "Client %d is back within its dispatch budget", client->pid);
+            client->over_budget = false;
+        }
+        client->budget_overruns = 0;
+    }
+
+    wl_event_source_timer_update(manager->rate_timer, CLIENT_RATE_INTERVAL_MSEC);
+    return 0;
+}
+
+struct sycamore_client *client_from_surface(struct sycamore_client_manager *manager,
+        struct wlr_surface *surface) {
+    if (!manager || !surface) {
+        return NULL;
+    }
+
+    struct client_surface *client_surface =
+            client_surface_from_wlr_surface(manager, surface);
+    return client_surface ? client_surface->client : NULL;
+}
+
+size_t client_frames_pending(struct sycamore_client *client) {
+    size_t frames = 0;
+    struct client_surface *surface;
+    wl_list_for_each(surface, &client->surfaces, link) {
+        frames += wl_list_length(&surface->wlr_surface->current.frame_callback_list);
+    }
+
+    return frames;
+}
+
+bool client_surface_frame_allowed(struct sycamore_client_manager *manager,
+        struct wlr_surface *surface, uint32_t msec) {
+    if (!manager) {
+        return true;
+    }
+
+    struct client_surface *client_surface =
+            client_surface_from_wlr_surface(manager, surface);
+    if (!client_surface) {
+        return true;
+    }
+
+    struct sycamore_client *client = client_surface->client;
+    bool throttled = client && (client->throttled || client->over_budget);
+    if (!throttled && client_surface->frame_interval_msec == 0) {
+        return true;
+    }
+
+    uint32_t elapsed = msec - client_surface->last_frame_msec;
+    if (throttled && elapsed < CLIENT_THROTTLE_INTERVAL_MSEC) {
+        return false;
+    }
+
+    /* Frame events come at the output's refresh, not exactly on the cap */
+    if (elapsed + 2 < client_surface->frame_interval_msec) {
+        return false;
+    }
+
+    client_surface->last_frame_msec = msec;
+    return true;
+}
+
+void client_surface_set_max_fps(struct sycamore_client_manager *manager,
+        struct wlr_surface *surface, uint32_t max_fps) {
+    struct client_surface *client_surface =
+            client_surface_from_wlr_surface(manager, surface);
+    if (client_surface) {
+        client_surface->frame_interval_msec = max_fps ? 1000 / max_fps : 0;
+    }
+}
+
+/* Charge the open span, up to the last message logged within it */
+static void client_manager_charge_dispatch(struct sycamore_client_manager *manager) {
+    if (manager->dispatch_client) {
+        manager->dispatch_client->dispatch_iteration_nsec +=
+                manager->dispatch_last_nsec - manager->dispatch_start_nsec;
+        manager->dispatch_client = NULL;
+    }
+}
+
+static void handle_dispatch_done(void *data) {
+    struct sycamore_client_manager *manager = data;
+    manager->dispatch_idle = NULL;
+
+    client_manager_charge_dispatch(manager);
+
+    uint64_t budget_nsec = (uint64_t)manager->limits.dispatch_budget_usec * 1000;
+    struct sycamore_client *client;
+    wl_list_for_each(client, &manager->clients, link) {
+        uint64_t elapsed = client->dispatch_iteration_nsec;
+        if (elapsed == 0) {
+            continue;
+        }
+
+        client->dispatch_nsec += elapsed;
+        client->dispatch_interval_nsec += elapsed;
+        client->dispatch_iteration_nsec = 0;
+
+        if (budget_nsec && elapsed > budget_nsec) {
+            client->budget_overruns++;
+            if (!client->over_budget) {
+                wlr_log(WLR_INFO, "Client %d took %" PRIu64 " us in one dispatch, "
+                        "deferring its commits to frame time", client->pid, elapsed / 1000);
+                client->over_budget = true;
+            }
+        }
+    }
+}
+
+/* libwayland has no hook around a client's dispatch. A span opens at a
+ * client's first request and runs to the last request or event logged
+ * before another client's request, an output frame or the end of the loop
+ * iteration, so work that sends nothing after the client's requests isn't
+ * charged to it. */
+static void handle_protocol_log(void *data, enum wl_protocol_logger_type type,
+        const struct wl_protocol_logger_message *message) {
+    struct sycamore_client_manager *manager = data;
+    if (type != WL_PROTOCOL_LOGGER_REQUEST) {
+        if (manager->dispatch_client) {
+            manager->dispatch_last_nsec = get_current_time_nsec();
+        }
+        return;
+    }
+
+    uint64_t now = get_current_time_nsec();
+    struct wl_client *wl_client = wl_resource_get_client(message->resource);
+    if (manager->dispatch_client && manager->dispatch_client->wl_client == wl_client) {
+        manager->dispatch_last_nsec = now;
+        return;
+    }
+
+    client_manager_charge_dispatch(manager);
+    manager->dispatch_client = client_from_wl_client(manager, wl_client);
+    manager->dispatch_start_nsec = now;
+    manager->dispatch_last_nsec = now;
+
+    /* Idle sources run at the end of the loop iteration that added them */
+    if (manager->dispatch_client && !manager->dispatch_idle) {
+        manager->dispatch_idle = wl_event_loop_add_idle(
+                wl_display_get_event_loop(manager->server->wl_display),
+                handle_dispatch_done, manager);
+    }
+}
+
+void client_manager_dispatch_break(struct sycamore_client_manager *manager) {
+    if (manager) {
+        client_manager_charge_dispatch(manager);
+    }
+}
+
+void client_manager_flush_deferred(struct sycamore_client_manager *manager) {
+    if (!manager || wl_list_empty(&manager->deferred_surfaces)) {
+        return;
+    }
+
+    /* Applying cached state emits commit, which may defer the surface again */
+    struct wl_list deferred;
+    wl_list_init(&deferred);
+    wl_list_insert_list(&deferred, &manager->deferred_surfaces);
+    wl_list_init(&manager->deferred_surfaces);
+
+    while (!wl_list_empty(&deferred)) {
+        struct client_surface *surface =
+                wl_container_of(deferred.next, surface, deferred_link);
+        client_surface_flush(surface);
+    }
+}
+
+static int handle_flush_timer(void *data) {
+    struct sycamore_client_manager *manager = data;
+
+    client_manager_flush_deferred(manager);
+    return 0;
+}
+
+static size_t env_get_size(const char *name, size_t fallback) {
+    const char *value = getenv(name);
+    return value ? strtoul(value, NULL, 10) : fallback;
+}
+
+static void client_limits_from_env(struct sycamore_client_limits *limits) {
+    limits->max_commit_rate = env_get_size("SYCAMORE_CLIENT_MAX_COMMIT_RATE", 0);
+    limits->max_buffer_bytes = env_get_size("SYCAMORE_CLIENT_MAX_BUFFER_MB", 0) * 1024 * 1024;
+    limits->max_surfaces = env_get_size("SYCAMORE_CLIENT_MAX_SURFACES", 0);
+    limits->commit_burst = env_get_size("SYCAMORE_CLIENT_COMMIT_BURST",
+                                        CLIENT_COMMIT_BURST_DEFAULT);
+    limits->dispatch_budget_usec = env_get_size("SYCAMORE_CLIENT_DISPATCH_BUDGET_USEC",
+                                                CLIENT_DISPATCH_BUDGET_DEFAULT_USEC);
+
+    const char *action = getenv("SYCAMORE_CLIENT_LIMIT_ACTION");
+    limits->throttle = action && strcmp(action, "throttle") == 0;
+}
+
+void sycamore_client_manager_destroy(struct sycamore_client_manager *manager) {
+    if (!manager) {
+        return;
+    }
+
+    client_manager_flush_deferred(manager);
+
+    struct sycamore_client *client, *next_client;
+    wl_list_for_each_safe(client, next_client, &manager->clients, link) {
+        struct client_surface *surface, *next_surface;
+        wl_list_for_each_safe(surface, next_surface, &client->surfaces, link) {
+            client_surface_destroy(surface);
+        }
+        client_destroy(client);
+    }
+
+    if (manager->rate_timer) {
+        wl_event_source_remove(manager->rate_timer);
+    }
+
+    if (manager->flush_timer) {
+        wl_event_source_remove(manager->flush_timer);
+    }
+
+    if (manager->protocol_logger) {
+        wl_protocol_logger_destroy(manager->protocol_logger);
+    }
+
+    if (manager->dispatch_idle) {
+        wl_event_source_remove(manager->dispatch_idle);
+    }
+
+    wl_list_remove(&manager->new_surface.link);
+
+    free(manager);
+}
+
+struct sycamore_client_manager *sycamore_client_manager_create(
+        struct sycamore_server *server, struct wl_display *display,
+        struct wlr_compositor *compositor) {
+    struct sycamore_client_manager *manager =
+            calloc(1, sizeof(struct sycamore_client_manager));
+    if (!manager) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_client_manager");
+        return NULL;
+    }
+
+    manager->server = server;
+    wl_list_init(&manager->clients);
+    wl_list_init(&manager->deferred_surfaces);
+    client_limits_from_env(&manager->limits);
+
+    manager->new_surface.notify = handle_new_surface;
+    wl_signal_add(&compositor->events.new_surface, &manager->new_surface);
+
+    manager->rate_timer = wl_event_loop_add_timer(
+            wl_display_get_event_loop(display), handle_rate_timer, manager);
+    if (!manager->rate_timer) {
+        wlr_log(WLR_ERROR, "Unable to create client rate timer");
+        sycamore_client_manager_destroy(manager);
+        return NULL;
+    }
+    wl_event_source_timer_update(manager->rate_timer, CLIENT_RATE_INTERVAL_MSEC);
+
+    manager->flush_timer = wl_event_loop_add_timer(
+            wl_display_get_event_loop(display), handle_flush_timer, manager);
+    if (!manager->flush_timer) {
+        wlr_log(WLR_ERROR, "Unable to create client flush timer");
+        sycamore_client_manager_destroy(manager);
+        return NULL;
+    }
+
+    manager->protocol_logger =
+            wl_display_add_protocol_logger(display, handle_protocol_log, manager);
+
+    return manager;
+}
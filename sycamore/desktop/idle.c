@@ -0,0 +1,333 @@
+#include <pixman.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_idle_notify_v1.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_output_power_management_v1.h>
+#include <wlr/util/log.h>
+#include "sycamore/desktop/idle.h"
+#include "sycamore/desktop/view.h"
+#include "sycamore/input/seat.h"
+#include "sycamore/output/output.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+static struct sycamore_view *view_from_surface(struct sycamore_server *server,
+        struct wlr_surface *surface) {
+    struct sycamore_view *view;
+    wl_list_for_each(view, &server->mapped_views, link) {
+        if (view->wlr_surface == surface) {
+            return view;
+        }
+    }
+
+    return NULL;
+}
+
+/* A view is occluded if the opaque regions of the views above it, and the
+ * outputs of fullscreen ones, cover all of it that is on an output */
+static bool view_is_occluded(struct sycamore_view *view) {
+    struct sycamore_server *server = view->server;
+    struct wlr_surface *surface = view->wlr_surface;
+
+    pixman_region32_t visible, outputs;
+    pixman_region32_init_rect(&visible, view->x, view->y,
+                              surface->current.width, surface->current.height);
+    pixman_region32_init(&outputs);
+
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        struct wlr_box box;
+        wlr_output_layout_get_box(server->output_layout, output->wlr_output, &box);
+        if (output->wlr_output->enabled && !wlr_box_empty(&box)) {
+            pixman_region32_union_rect(&outputs, &outputs,
+                                       box.x, box.y, box.width, box.height);
+        }
+    }
+    pixman_region32_intersect(&visible, &visible, &outputs);
+    pixman_region32_fini(&outputs);
+
+    /* mapped_views is in stacking order, topmost first */
+    struct sycamore_view *above;
+    wl_list_for_each(above, &server->mapped_views, link) {
+        if (above == view || !pixman_region32_not_empty(&visible)) {
+            break;
+        }
+
+        if (!above->scene_tree->node.enabled) {
+            continue;
+        }
+
+        struct sycamore_output *above_output = view_get_main_output(above);
+        if (above->is_fullscreen && above_output) {
+            struct wlr_box box;
+            wlr_output_layout_get_box(server->output_layout,
+                                      above_output->wlr_output, &box);
+            pixman_region32_t full;
+            pixman_region32_init_rect(&full, box.x, box.y, box.width, box.height);
+            pixman_region32_subtract(&visible, &visible, &full);
+            pixman_region32_fini(&full);
+            continue;
+        }
+
+        /* A translucent window rule makes the opaque region see-through */
+        if ((above->rules.set & WINDOW_RULE_OPACITY) && above->rules.opacity < 1.0f) {
+            continue;
+        }
+
+        pixman_region32_t opaque;
+        pixman_region32_init(&opaque);
+        pixman_region32_copy(&opaque, &above->wlr_surface->opaque_region);
+        pixman_region32_translate(&opaque, above->x, above->y);
+        pixman_region32_subtract(&visible, &visible, &opaque);
+        pixman_region32_fini(&opaque);
+    }
+
+    bool occluded = !pixman_region32_not_empty(&visible);
+    pixman_region32_fini(&visible);
+    return occluded;
+}
+
+static bool idle_inhibitor_is_visible(struct idle_inhibitor *inhibitor) {
+    struct wlr_surface *surface =
+            wlr_surface_get_root_surface(inhibitor->wlr_inhibitor->surface);
+
+    /* Unmapped, disabled or off-screen surfaces are on no output */
+    if (wl_list_empty(&surface->current_outputs)) {
+        return false;
+    }
+
+    struct sycamore_view *view = view_from_surface(inhibitor->manager->server, surface);
+    if (view) {
+        return view->scene_tree->node.enabled && !view_is_occluded(view);
+    }
+
+    /* Layer surfaces and the like */
+    return true;
+}
+
+void idle_manager_update_inhibit(struct sycamore_idle_manager *manager) {
+    if (!manager || (wl_list_empty(&manager->inhibitors) && !manager->inhibited)) {
+        return;
+    }
+
+    bool inhibited = false;
+    struct idle_inhibitor *inhibitor;
+    wl_list_for_each(inhibitor, &manager->inhibitors, link) {
+        bool visible = idle_inhibitor_is_visible(inhibitor);
+        if (visible != inhibitor->visible) {
+            struct wl_client *client =
+                    wl_resource_get_client(inhibitor->wlr_inhibitor->surface->resource);
+            pid_t pid;
+            wl_client_get_credentials(client, &pid, NULL, NULL);
+            wlr_log(WLR_DEBUG, "%s idle inhibitor of client %d",
+                    visible ? "Honoring" : "Ignoring hidden", pid);
+            inhibitor->visible = visible;
+        }
+        inhibited |= visible;
+    }
+
+    if (inhibited != manager->inhibited) {
+        manager->inhibited = inhibited;
+        wlr_idle_notifier_v1_set_inhibited(manager->idle_notifier, inhibited);
+    }
+}
+
+static void idle_inhibitor_destroy(struct idle_inhibitor *inhibitor) {
+    wl_list_remove(&inhibitor->link);
+    wl_list_remove(&inhibitor->destroy.link);
+
+    free(inhibitor);
+}
+
+static void handle_idle_inhibitor_destroy(struct wl_listener *listener, void *data) {
+    struct idle_inhibitor *inhibitor = wl_container_of(listener, inhibitor, destroy);
+    struct sycamore_idle_manager *manager = inhibitor->manager;
+
+    idle_inhibitor_destroy(inhibitor);
+    idle_manager_update_inhibit(manager);
+}
+
+static void handle_new_idle_inhibitor(struct wl_listener *listener, void *data) {
+    struct sycamore_idle_manager *manager =
+            wl_container_of(listener, manager, new_inhibitor);
+    struct wlr_idle_inhibitor_v1 *wlr_inhibitor = data;
+
+    struct idle_inhibitor *inhibitor = calloc(1, sizeof(struct idle_inhibitor));
+    if (!inhibitor) {
+        wlr_log(WLR_ERROR, "Unable to allocate idle_inhibitor");
+        return;
+    }
+
+    inhibitor->wlr_inhibitor = wlr_inhibitor;
+    inhibitor->manager = manager;
+
+    inhibitor->destroy.notify = handle_idle_inhibitor_destroy;
+    wl_signal_add(&wlr_inhibitor->events.destroy, &inhibitor->destroy);
+
+    wl_list_insert(&manager->inhibitors, &inhibitor->link);
+
+    idle_manager_update_inhibit(manager);
+}
+
+static void idle_manager_enter_idle(struct sycamore_idle_manager *manager) {
+    wlr_log(WLR_INFO, "Idle, powering off outputs");
+    manager->idle = true;
+
+    struct sycamore_output *output;
+    wl_list_for_each(output, &manager->server->all_outputs, link) {
+        /* Virtual outputs don't show anything to the idle user */
+        if (output->virtual) {
+            continue;
+        }
+
+        if (output->wlr_output->enabled && output_set_power(output, false)) {
+            output->idle_off = true;
+        }
+    }
+}
+
+static void idle_manager_leave_idle(struct sycamore_idle_manager *manager) {
+    manager->idle = false;
+
+    /* Only wake the outputs we turned off, not those powered off by clients */
+    struct sycamore_output *output;
+    wl_list_for_each(output, &manager->server->all_outputs, link) {
+        if (output->idle_off) {
+            output->idle_off = false;
+            output_set_power(output, true);
+        }
+    }
+}
+
+static int handle_idle_timer(void *data) {
+    struct sycamore_idle_manager *manager = data;
+    if (manager->timeout_msec == 0 || manager->idle) {
+        return 0;
+    }
+
+    /* Activity doesn't rearm the timer, so check how long it's really been */
+    uint32_t elapsed = get_current_time_msec() - manager->last_activity_msec;
+    if (elapsed < manager->timeout_msec) {
+        wl_event_source_timer_update(manager->idle_timer, manager->timeout_msec - elapsed);
+        return 0;
+    }
+
+    idle_manager_update_inhibit(manager);
+    if (manager->inhibited) {
+        wl_event_source_timer_update(manager->idle_timer, manager->timeout_msec);
+        return 0;
+    }
+
+    idle_manager_enter_idle(manager);
+    return 0;
+}
+
+void idle_manager_notify_activity(struct sycamore_idle_manager *manager,
+        struct sycamore_seat *seat) {
+    if (!manager) {
+        return;
+    }
+
+    manager->last_activity_msec = get_current_time_msec();
+    wlr_idle_notifier_v1_notify_activity(manager->idle_notifier, seat->wlr_seat);
+
+    if (manager->idle) {
+        idle_manager_leave_idle(manager);
+        wl_event_source_timer_update(manager->idle_timer, manager->timeout_msec);
+    }
+}
+
+void idle_manager_set_timeout(struct sycamore_idle_manager *manager, uint32_t timeout_msec) {
+    manager->timeout_msec = timeout_msec;
+    manager->last_activity_msec = get_current_time_msec();
+    wl_event_source_timer_update(manager->idle_timer, timeout_msec);
+
+    if (timeout_msec == 0 && manager->idle) {
+        idle_manager_leave_idle(manager);
+    }
+}
+
+static void handle_output_power_set_mode(struct wl_listener *listener, void *data) {
+    struct sycamore_idle_manager *manager =
+            wl_container_of(listener, manager, output_power_set_mode);
+    struct wlr_output_power_v1_set_mode_event *event = data;
+    struct sycamore_output *output = event->output->data;
+    if (!output) {
+        return;
+    }
+
+    /* The client takes over this output */
+    output->idle_off = false;
+    output_set_power(output, event->mode == ZWLR_OUTPUT_POWER_V1_MODE_ON);
+}
+
+void sycamore_idle_manager_destroy(struct sycamore_idle_manager *manager) {
+    if (!manager) {
+        return;
+    }
+
+    if (manager->idle_timer) {
+        wl_event_source_remove(manager->idle_timer);
+    }
+
+    struct idle_inhibitor *inhibitor, *next;
+    wl_list_for_each_safe(inhibitor, next, &manager->inhibitors, link) {
+        idle_inhibitor_destroy(inhibitor);
+    }
+
+    wl_list_remove(&manager->output_power_set_mode.link);
+    wl_list_remove(&manager->new_inhibitor.link);
+
+    free(manager);
+}
+
+struct sycamore_idle_manager *sycamore_idle_manager_create(
+        struct sycamore_server *server, struct wl_display *display) {
+    struct sycamore_idle_manager *manager =
+            calloc(1, sizeof(struct sycamore_idle_manager));
+    if (!manager) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_idle_manager");
+        return NULL;
+    }
+
+    manager->server = server;
+    wl_list_init(&manager->inhibitors);
+
+    manager->idle_notifier = wlr_idle_notifier_v1_create(display);
+    if (!manager->idle_notifier) {
+        wlr_log(WLR_ERROR, "Unable to create wlr_idle_notifier_v1");
+        free(manager);
+        return NULL;
+    }
+
+    manager->output_power_manager = wlr_output_power_manager_v1_create(display);
+    if (!manager->output_power_manager) {
+        wlr_log(WLR_ERROR, "Unable to create wlr_output_power_manager_v1");
+        free(manager);
+        return NULL;
+    }
+
+    manager->inhibit_manager = wlr_idle_inhibit_v1_create(display);
+    if (!manager->inhibit_manager) {
+        wlr_log(WLR_ERROR, "Unable to create wlr_idle_inhibit_manager_v1");
+        free(manager);
+        return NULL;
+    }
+
+    manager->output_power_set_mode.notify = handle_output_power_set_mode;
+    wl_signal_add(&manager->output_power_manager->events.set_mode,
+                  &manager->output_power_set_mode);
+    manager->new_inhibitor.notify = handle_new_idle_inhibitor;
+    wl_signal_add(&manager->inhibit_manager->events.new_inhibitor,
+                  &manager->new_inhibitor);
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(display);
+    manager->idle_timer = wl_event_loop_add_timer(loop, handle_idle_timer, manager);
+    if (!manager->idle_timer) {
+        wlr_log(WLR_ERROR, "Unable to create idle timer");
+        sycamore_idle_manager_destroy(manager);
+        return NULL;
+    }
+
+    return manager;
+}
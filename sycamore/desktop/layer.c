@@ -110,24 +110,27 @@ void arrange_layers(struct sycamore_output *output) {
 
 struct sycamore_layer *layer_create(struct sycamore_server *server,
         struct wlr_layer_surface_v1 *layer_surface) {
-    struct sycamore_layer *layer =
-            calloc(1, sizeof(struct sycamore_layer));
+    struct sycamore_layer *layer = pool_alloc(&server->pools[POOL_LAYER]);
     if (!layer) {
         wlr_log(WLR_ERROR, "Unable to allocate layer");
         return NULL;
     }
 
-    /* Allocate an output for this layer. */
+    /* Allocate an output for this layer, virtual ones only if asked for. */
     if (!layer_surface->output) {
-        struct wl_list *all_outputs = &server->all_outputs;
-        if (wl_list_empty(all_outputs)) {
+        struct sycamore_output *output;
+        wl_list_for_each(output, &server->all_outputs, link) {
+            if (!output->virtual) {
+                layer_surface->output = output->wlr_output;
+                break;
+            }
+        }
+
+        if (!layer_surface->output) {
             wlr_log(WLR_ERROR, "No output for layer_surface");
-            free(layer);
+            pool_free(&server->pools[POOL_LAYER], layer);
             return NULL;
         }
-
-        struct sycamore_output *output = wl_container_of(all_outputs->next, output, link);
-        layer_surface->output = output->wlr_output;
     }
 
     layer->scene_descriptor = SCENE_DESC_LAYER;
@@ -164,5 +167,5 @@ void layer_destroy(struct sycamore_layer *layer) {
         wlr_layer_surface_v1_destroy(layer->layer_surface);
     }
 
-    free(layer);
+    pool_free(&layer->server->pools[POOL_LAYER], layer);
 }
\ No newline at end of file
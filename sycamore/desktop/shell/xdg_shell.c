@@ -7,6 +7,7 @@
 #include "sycamore/desktop/shell/xdg_shell.h"
 #include "sycamore/desktop/view.h"
 #include "sycamore/output/output.h"
+#include "sycamore/server.h"
 
 static void handle_xdg_shell_view_request_move(struct wl_listener *listener, void *data) {
     /* This event is raised when a client would like to begin an interactive
@@ -86,6 +87,16 @@ static void handle_xdg_shell_view_destroy(struct wl_listener *listener, void *da
     view_destroy(&view->base_view);
 }
 
+static void handle_xdg_shell_view_commit(struct wl_listener *listener, void *data) {
+    /* The initial commit, answered by the first configure once the event
+     * loop is idle. That configure carries what the window rules ask for. */
+    struct sycamore_xdg_shell_view *view = wl_container_of(listener, view, commit);
+    wl_list_remove(&view->commit.link);
+    wl_list_init(&view->commit.link);
+
+    view_apply_rules(&view->base_view);
+}
+
 static void handle_xdg_shell_view_map(struct wl_listener *listener, void *data) {
     /* Called when the surface is mapped, or ready to display on-screen. */
     struct sycamore_xdg_shell_view *view = wl_container_of(listener, view, map);
@@ -112,8 +123,9 @@ static void xdg_shell_view_destroy(struct sycamore_view *view) {
     wl_list_remove(&xdg_shell_view->destroy.link);
     wl_list_remove(&xdg_shell_view->map.link);
     wl_list_remove(&xdg_shell_view->unmap.link);
+    wl_list_remove(&xdg_shell_view->commit.link);
 
-    free(xdg_shell_view);
+    pool_free(&view->server->pools[POOL_XDG_SHELL_VIEW], xdg_shell_view);
 }
 
 /* view interface */
@@ -205,6 +217,22 @@ static void xdg_shell_view_close(struct sycamore_view *view) {
     wlr_xdg_toplevel_send_close(xdg_shell_view->xdg_toplevel);
 }
 
+/* view interface */
+static const char *xdg_shell_view_get_app_id(struct sycamore_view *view) {
+    struct sycamore_xdg_shell_view *xdg_shell_view =
+            wl_container_of(view, xdg_shell_view, base_view);
+
+    return xdg_shell_view->xdg_toplevel->app_id;
+}
+
+/* view interface */
+static const char *xdg_shell_view_get_title(struct sycamore_view *view) {
+    struct sycamore_xdg_shell_view *xdg_shell_view =
+            wl_container_of(view, xdg_shell_view, base_view);
+
+    return xdg_shell_view->xdg_toplevel->title;
+}
+
 static const struct view_interface xdg_shell_view_interface = {
     .destroy = xdg_shell_view_destroy,
     .map = xdg_shell_view_map,
@@ -216,12 +244,14 @@ static const struct view_interface xdg_shell_view_interface = {
     .set_resizing = xdg_shell_view_set_resizing,
     .get_geometry = xdg_shell_view_get_geometry,
     .close = xdg_shell_view_close,
+    .get_app_id = xdg_shell_view_get_app_id,
+    .get_title = xdg_shell_view_get_title,
 };
 
 struct sycamore_xdg_shell_view *sycamore_xdg_shell_view_create(
         struct sycamore_server *server, struct wlr_xdg_toplevel *toplevel) {
     struct sycamore_xdg_shell_view *view =
-            calloc(1, sizeof(struct sycamore_xdg_shell_view));
+            pool_alloc(&server->pools[POOL_XDG_SHELL_VIEW]);
     if (!view) {
         wlr_log(WLR_ERROR, "Failed to allocate sycamore_xdg_shell_view");
         return NULL;
@@ -238,6 +268,8 @@ struct sycamore_xdg_shell_view *sycamore_xdg_shell_view_create(
     wl_signal_add(&toplevel->base->events.unmap, &view->unmap);
     view->destroy.notify = handle_xdg_shell_view_destroy;
     wl_signal_add(&toplevel->base->events.destroy, &view->destroy);
+    view->commit.notify = handle_xdg_shell_view_commit;
+    wl_signal_add(&toplevel->base->surface->events.commit, &view->commit);
 
     return view;
 }
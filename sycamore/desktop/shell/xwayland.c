@@ -0,0 +1,526 @@
+#include <wlr/config.h>
+
+#if WLR_HAS_XWAYLAND
+#include <stdlib.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_xcursor_manager.h>
+#include <wlr/util/log.h>
+#include <wlr/xwayland.h>
+#include <xcb/xproto.h>
+#include "sycamore/desktop/shell/xwayland.h"
+#include "sycamore/desktop/view.h"
+#include "sycamore/output/output.h"
+#include "sycamore/util/prefetch.h"
+#include "sycamore/server.h"
+
+static void xwayland_surface_added(struct sycamore_xwayland *xwayland) {
+    xwayland->surfaces++;
+    wl_event_source_timer_update(xwayland->idle_timer, 0);
+}
+
+static void xwayland_surface_removed(struct sycamore_xwayland *xwayland) {
+    if (--xwayland->surfaces == 0 && xwayland->idle_timeout > 0) {
+        wl_event_source_timer_update(xwayland->idle_timer, xwayland->idle_timeout * 1000);
+    }
+}
+
+static void handle_xwayland_view_request_configure(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, request_configure);
+    struct wlr_xwayland_surface_configure_event *event = data;
+    struct sycamore_view *base = &view->base_view;
+
+    /* Unmapped windows place themselves, mapped ones only get to resize */
+    if (!base->mapped) {
+        wlr_xwayland_surface_configure(view->xwayland_surface, event->x, event->y,
+                                       event->width, event->height);
+        return;
+    }
+
+    wlr_xwayland_surface_configure(view->xwayland_surface, base->x, base->y,
+                                   event->width, event->height);
+}
+
+static void handle_xwayland_view_request_activate(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, request_activate);
+
+    if (view->base_view.mapped) {
+        view_set_focus(&view->base_view);
+    }
+}
+
+static void handle_xwayland_view_request_move(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, request_move);
+    struct sycamore_view *base = &view->base_view;
+    seatop_begin_pointer_move(base->server->seat, base);
+}
+
+static void handle_xwayland_view_request_resize(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, request_resize);
+    struct sycamore_view *base = &view->base_view;
+    struct wlr_xwayland_resize_event *event = data;
+    seatop_begin_pointer_resize(base->server->seat, base, event->edges);
+}
+
+static void handle_xwayland_view_request_fullscreen(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, request_fullscreen);
+    struct sycamore_view *base = &view->base_view;
+    bool fullscreen = view->xwayland_surface->fullscreen;
+    if (fullscreen) {
+        struct sycamore_output *output = view_get_main_output(base);
+        struct wlr_box box;
+        wlr_output_layout_get_box(base->server->output_layout,
+                                  output ? output->wlr_output : NULL, &box);
+        view_set_fullscreen(base, &box, fullscreen);
+    } else {
+        view_set_fullscreen(base, NULL, fullscreen);
+    }
+}
+
+static void handle_xwayland_view_request_maximize(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, request_maximize);
+    struct sycamore_view *base = &view->base_view;
+    struct wlr_xwayland_surface *surface = view->xwayland_surface;
+    bool maximized = surface->maximized_horz && surface->maximized_vert;
+    if (maximized) {
+        struct sycamore_output *output = view_get_main_output(base);
+        if (output) {
+            view_set_maximized(base, &output->usable_area, maximized);
+        } else {
+            struct wlr_box box;
+            wlr_output_layout_get_box(base->server->output_layout, NULL, &box);
+            view_set_maximized(base, &box, maximized);
+        }
+    } else {
+        view_set_maximized(base, NULL, maximized);
+    }
+}
+
+static void handle_xwayland_view_map(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, map);
+    struct wlr_xwayland_surface *surface = view->xwayland_surface;
+    struct sycamore_view *base = &view->base_view;
+
+    /* The wl_surface is only known once the window maps */
+    base->wlr_surface = surface->surface;
+    base->scene_tree = wlr_scene_tree_create(base->server->scene->trees.shell_view);
+    base->scene_tree->node.data = base;
+    wlr_scene_subsurface_tree_create(base->scene_tree, surface->surface);
+
+    /* X11 windows have no configure before they map, they are sized here */
+    view_apply_rules(base);
+
+    view_map(base, NULL, surface->maximized_horz && surface->maximized_vert,
+             surface->fullscreen);
+}
+
+static void handle_xwayland_view_unmap(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, unmap);
+    struct sycamore_view *base = &view->base_view;
+
+    view_unmap(base);
+
+    wlr_scene_node_destroy(&base->scene_tree->node);
+    base->scene_tree = NULL;
+    base->wlr_surface = NULL;
+}
+
+static void handle_xwayland_view_destroy(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_view *view = wl_container_of(listener, view, destroy);
+
+    if (view->base_view.mapped) {
+        handle_xwayland_view_unmap(&view->unmap, NULL);
+    }
+
+    view_destroy(&view->base_view);
+}
+
+/* view interface */
+static void xwayland_view_destroy(struct sycamore_view *view) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+    struct sycamore_xwayland *xwayland = view->server->xwayland;
+
+    wl_list_remove(&xwayland_view->map.link);
+    wl_list_remove(&xwayland_view->unmap.link);
+    wl_list_remove(&xwayland_view->destroy.link);
+    wl_list_remove(&xwayland_view->request_configure.link);
+
+    free(xwayland_view);
+
+    xwayland_surface_removed(xwayland);
+}
+
+/* view interface */
+static void xwayland_view_map(struct sycamore_view *view) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+    struct wlr_xwayland_surface *surface = xwayland_view->xwayland_surface;
+
+    xwayland_view->request_activate.notify = handle_xwayland_view_request_activate;
+    wl_signal_add(&surface->events.request_activate, &xwayland_view->request_activate);
+    xwayland_view->request_move.notify = handle_xwayland_view_request_move;
+    wl_signal_add(&surface->events.request_move, &xwayland_view->request_move);
+    xwayland_view->request_resize.notify = handle_xwayland_view_request_resize;
+    wl_signal_add(&surface->events.request_resize, &xwayland_view->request_resize);
+    xwayland_view->request_fullscreen.notify = handle_xwayland_view_request_fullscreen;
+    wl_signal_add(&surface->events.request_fullscreen, &xwayland_view->request_fullscreen);
+    xwayland_view->request_maximize.notify = handle_xwayland_view_request_maximize;
+    wl_signal_add(&surface->events.request_maximize, &xwayland_view->request_maximize);
+}
+
+/* view interface */
+static void xwayland_view_unmap(struct sycamore_view *view) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+
+    wl_list_remove(&xwayland_view->request_activate.link);
+    wl_list_remove(&xwayland_view->request_move.link);
+    wl_list_remove(&xwayland_view->request_resize.link);
+    wl_list_remove(&xwayland_view->request_fullscreen.link);
+    wl_list_remove(&xwayland_view->request_maximize.link);
+}
+
+/* view interface */
+static void xwayland_view_set_activated(struct sycamore_view *view, bool activated) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+    struct wlr_xwayland_surface *surface = xwayland_view->xwayland_surface;
+
+    wlr_xwayland_surface_activate(surface, activated);
+    if (activated) {
+        wlr_xwayland_surface_restack(surface, NULL, XCB_STACK_MODE_ABOVE);
+    }
+}
+
+/* view interface */
+static void xwayland_view_set_position(struct sycamore_view *view, int x, int y) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+    struct wlr_xwayland_surface *surface = xwayland_view->xwayland_surface;
+
+    /* X11 clients place their menus from where they think they are */
+    wlr_xwayland_surface_configure(surface, x, y, surface->width, surface->height);
+}
+
+/* view interface */
+static void xwayland_view_set_size(struct sycamore_view *view, uint32_t width, uint32_t height) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+
+    wlr_xwayland_surface_configure(xwayland_view->xwayland_surface,
+                                   view->x, view->y, width, height);
+}
+
+/* view interface */
+static void xwayland_view_set_fullscreen(struct sycamore_view *view, bool fullscreen) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+    wlr_xwayland_surface_set_fullscreen(xwayland_view->xwayland_surface, fullscreen);
+}
+
+/* view interface */
+static void xwayland_view_set_maximized(struct sycamore_view *view, bool maximized) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+    wlr_xwayland_surface_set_maximized(xwayland_view->xwayland_surface, maximized);
+}
+
+/* view interface */
+static void xwayland_view_set_resizing(struct sycamore_view *view, bool resizing) {
+    /* X11 has no notion of an interactive resize */
+}
+
+/* view interface */
+static void xwayland_view_get_geometry(struct sycamore_view *view, struct wlr_box *box) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+    struct wlr_xwayland_surface *surface = xwayland_view->xwayland_surface;
+
+    box->x = 0;
+    box->y = 0;
+    box->width = surface->width;
+    box->height = surface->height;
+}
+
+/* view interface */
+static void xwayland_view_close(struct sycamore_view *view) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+
+    wlr_xwayland_surface_close(xwayland_view->xwayland_surface);
+}
+
+/* view interface */
+static const char *xwayland_view_get_app_id(struct sycamore_view *view) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+
+    /* WM_CLASS is the closest X11 has */
+    return xwayland_view->xwayland_surface->class;
+}
+
+/* view interface */
+static const char *xwayland_view_get_title(struct sycamore_view *view) {
+    struct sycamore_xwayland_view *xwayland_view =
+            wl_container_of(view, xwayland_view, base_view);
+
+    return xwayland_view->xwayland_surface->title;
+}
+
+static const struct view_interface xwayland_view_interface = {
+    .destroy = xwayland_view_destroy,
+    .map = xwayland_view_map,
+    .unmap = xwayland_view_unmap,
+    .set_activated = xwayland_view_set_activated,
+    .set_position = xwayland_view_set_position,
+    .set_size = xwayland_view_set_size,
+    .set_fullscreen = xwayland_view_set_fullscreen,
+    .set_maximized = xwayland_view_set_maximized,
+    .set_resizing = xwayland_view_set_resizing,
+    .get_geometry = xwayland_view_get_geometry,
+    .close = xwayland_view_close,
+    .get_app_id = xwayland_view_get_app_id,
+    .get_title = xwayland_view_get_title,
+};
+
+static struct sycamore_xwayland_view *xwayland_view_create(struct sycamore_server *server,
+        struct wlr_xwayland_surface *surface) {
+    struct sycamore_xwayland_view *view = calloc(1, sizeof(struct sycamore_xwayland_view));
+    if (!view) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_xwayland_view");
+        return NULL;
+    }
+
+    view_init(&view->base_view, NULL, &xwayland_view_interface, server);
+    view->base_view.view_type = VIEW_TYPE_XWAYLAND;
+
+    view->xwayland_surface = surface;
+    surface->data = view;
+
+    view->map.notify = handle_xwayland_view_map;
+    wl_signal_add(&surface->events.map, &view->map);
+    view->unmap.notify = handle_xwayland_view_unmap;
+    wl_signal_add(&surface->events.unmap, &view->unmap);
+    view->destroy.notify = handle_xwayland_view_destroy;
+    wl_signal_add(&surface->events.destroy, &view->destroy);
+    view->request_configure.notify = handle_xwayland_view_request_configure;
+    wl_signal_add(&surface->events.request_configure, &view->request_configure);
+
+    return view;
+}
+
+static void handle_unmanaged_set_geometry(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_unmanaged *unmanaged =
+            wl_container_of(listener, unmanaged, set_geometry);
+    struct wlr_xwayland_surface *surface = unmanaged->xwayland_surface;
+
+    wlr_scene_node_set_position(&unmanaged->scene_tree->node, surface->x, surface->y);
+}
+
+static void handle_unmanaged_map(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_unmanaged *unmanaged = wl_container_of(listener, unmanaged, map);
+    struct wlr_xwayland_surface *surface = unmanaged->xwayland_surface;
+    struct sycamore_server *server = unmanaged->server;
+
+    unmanaged->scene_tree = wlr_scene_tree_create(server->scene->trees.shell_top);
+    unmanaged->scene_tree->node.data = unmanaged;
+    wlr_scene_subsurface_tree_create(unmanaged->scene_tree, surface->surface);
+    wlr_scene_node_set_position(&unmanaged->scene_tree->node, surface->x, surface->y);
+
+    unmanaged->set_geometry.notify = handle_unmanaged_set_geometry;
+    wl_signal_add(&surface->events.set_geometry, &unmanaged->set_geometry);
+
+    if (wlr_xwayland_or_surface_wants_focus(surface)) {
+        seat_set_keyboard_focus(server->seat, surface->surface);
+    }
+}
+
+static void handle_unmanaged_unmap(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_unmanaged *unmanaged = wl_container_of(listener, unmanaged, unmap);
+    struct sycamore_server *server = unmanaged->server;
+
+    wl_list_remove(&unmanaged->set_geometry.link);
+    wlr_scene_node_destroy(&unmanaged->scene_tree->node);
+    unmanaged->scene_tree = NULL;
+
+    /* Give the keyboard back to the focused view */
+    struct wlr_seat *wlr_seat = server->seat->wlr_seat;
+    if (wlr_seat->keyboard_state.focused_surface == unmanaged->xwayland_surface->surface) {
+        struct sycamore_view *view = server->focused_view.view;
+        if (view) {
+            seat_set_keyboard_focus(server->seat, view->wlr_surface);
+        } else {
+            wlr_seat_keyboard_notify_clear_focus(wlr_seat);
+        }
+    }
+}
+
+static void handle_unmanaged_destroy(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland_unmanaged *unmanaged =
+            wl_container_of(listener, unmanaged, destroy);
+
+    if (unmanaged->scene_tree) {
+        handle_unmanaged_unmap(&unmanaged->unmap, NULL);
+    }
+
+    wl_list_remove(&unmanaged->map.link);
+    wl_list_remove(&unmanaged->unmap.link);
+    wl_list_remove(&unmanaged->destroy.link);
+
+    xwayland_surface_removed(unmanaged->server->xwayland);
+    free(unmanaged);
+}
+
+static struct sycamore_xwayland_unmanaged *xwayland_unmanaged_create(
+        struct sycamore_server *server, struct wlr_xwayland_surface *surface) {
+    struct sycamore_xwayland_unmanaged *unmanaged =
+            calloc(1, sizeof(struct sycamore_xwayland_unmanaged));
+    if (!unmanaged) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_xwayland_unmanaged");
+        return NULL;
+    }
+
+    unmanaged->scene_descriptor = SCENE_DESC_XWAYLAND_UNMANAGED;
+    unmanaged->xwayland_surface = surface;
+    unmanaged->server = server;
+
+    unmanaged->map.notify = handle_unmanaged_map;
+    wl_signal_add(&surface->events.map, &unmanaged->map);
+    unmanaged->unmap.notify = handle_unmanaged_unmap;
+    wl_signal_add(&surface->events.unmap, &unmanaged->unmap);
+    unmanaged->destroy.notify = handle_unmanaged_destroy;
+    wl_signal_add(&surface->events.destroy, &unmanaged->destroy);
+
+    return unmanaged;
+}
+
+static void handle_xwayland_new_surface(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland *xwayland = wl_container_of(listener, xwayland, new_surface);
+    struct wlr_xwayland_surface *surface = data;
+
+    bool created = surface->override_redirect ?
+            xwayland_unmanaged_create(xwayland->server, surface) != NULL :
+            xwayland_view_create(xwayland->server, surface) != NULL;
+    if (!created) {
+        wlr_log(WLR_ERROR, "Unable to create view for X11 window 0x%x", surface->window_id);
+        return;
+    }
+
+    xwayland_surface_added(xwayland);
+}
+
+static void handle_xwayland_ready(struct wl_listener *listener, void *data) {
+    struct sycamore_xwayland *xwayland = wl_container_of(listener, xwayland, ready);
+    struct sycamore_server *server = xwayland->server;
+
+    wlr_log(WLR_INFO, "Xwayland is ready on DISPLAY=%s", xwayland->wlr_xwayland->display_name);
+    wlr_xwayland_set_seat(xwayland->wlr_xwayland, server->seat->wlr_seat);
+
+    /* The root window cursor, seen over windows that set none */
+    struct wlr_xcursor_manager *manager = server->seat->cursor->xcursor_manager;
+    wlr_xcursor_manager_load(manager, 1.0f);
+    struct wlr_xcursor *xcursor = wlr_xcursor_manager_get_xcursor(manager, "left_ptr", 1.0f);
+    if (xcursor) {
+        struct wlr_xcursor_image *image = xcursor->images[0];
+        wlr_xwayland_set_cursor(xwayland->wlr_xwayland, image->buffer, image->width * 4,
+                                image->width, image->height,
+                                image->hotspot_x, image->hotspot_y);
+    }
+
+    /* The client that started it may have gone without mapping anything */
+    if (xwayland->surfaces == 0 && xwayland->idle_timeout > 0) {
+        wl_event_source_timer_update(xwayland->idle_timer, xwayland->idle_timeout * 1000);
+    }
+}
+
+static bool xwayland_start(struct sycamore_xwayland *xwayland) {
+    struct sycamore_server *server = xwayland->server;
+
+    /* Lazy: only the X11 sockets are opened until a client connects */
+    xwayland->wlr_xwayland = wlr_xwayland_create(server->wl_display, server->compositor, true);
+    if (!xwayland->wlr_xwayland) {
+        return false;
+    }
+
+    xwayland->ready.notify = handle_xwayland_ready;
+    wl_signal_add(&xwayland->wlr_xwayland->events.ready, &xwayland->ready);
+    xwayland->new_surface.notify = handle_xwayland_new_surface;
+    wl_signal_add(&xwayland->wlr_xwayland->events.new_surface, &xwayland->new_surface);
+
+    /* Not while the prefetch thread may be reading environ */
+    prefetch_finish(server->prefetch);
+    setenv("DISPLAY", xwayland->wlr_xwayland->display_name, true);
+    return true;
+}
+
+static void xwayland_stop(struct sycamore_xwayland *xwayland) {
+    wl_list_remove(&xwayland->ready.link);
+    wl_list_remove(&xwayland->new_surface.link);
+    wlr_xwayland_destroy(xwayland->wlr_xwayland);
+    xwayland->wlr_xwayland = NULL;
+}
+
+static int handle_idle_timer(void *data) {
+    struct sycamore_xwayland *xwayland = data;
+    struct wlr_xwayland_server *server = xwayland->wlr_xwayland->server;
+    if (xwayland->surfaces > 0 || !server || server->pid <= 0) {
+        return 0;
+    }
+
+    /* Start over from a lazy listener, which costs nothing until used again */
+    wlr_log(WLR_INFO, "Shutting down Xwayland, idle for %u s", xwayland->idle_timeout);
+    xwayland_stop(xwayland);
+    if (!xwayland_start(xwayland)) {
+        wlr_log(WLR_ERROR, "Unable to restart Xwayland, X11 clients are disabled");
+    }
+
+    return 0;
+}
+
+struct sycamore_xwayland *sycamore_xwayland_create(struct sycamore_server *server,
+        struct wl_display *display) {
+    struct sycamore_xwayland *xwayland = calloc(1, sizeof(struct sycamore_xwayland));
+    if (!xwayland) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_xwayland");
+        return NULL;
+    }
+
+    xwayland->server = server;
+
+    const char *idle_timeout = getenv("SYCAMORE_XWAYLAND_IDLE");
+    if (idle_timeout) {
+        xwayland->idle_timeout = strtoul(idle_timeout, NULL, 10);
+    }
+
+    xwayland->idle_timer = wl_event_loop_add_timer(wl_display_get_event_loop(display),
+                                                   handle_idle_timer, xwayland);
+    if (!xwayland->idle_timer) {
+        wlr_log(WLR_ERROR, "Unable to add Xwayland idle timer");
+        free(xwayland);
+        return NULL;
+    }
+
+    if (!xwayland_start(xwayland)) {
+        wlr_log(WLR_ERROR, "Unable to create wlr_xwayland");
+        wl_event_source_remove(xwayland->idle_timer);
+        free(xwayland);
+        return NULL;
+    }
+
+    return xwayland;
+}
+
+void sycamore_xwayland_destroy(struct sycamore_xwayland *xwayland) {
+    if (!xwayland) {
+        return;
+    }
+
+    if (xwayland->wlr_xwayland) {
+        xwayland_stop(xwayland);
+    }
+    wl_event_source_remove(xwayland->idle_timer);
+
+    free(xwayland);
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <string.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_output.h>
@@ -11,20 +12,78 @@
 
 void view_init(struct sycamore_view *view, struct wlr_surface *surface,
         const struct view_interface *interface, struct sycamore_server *server) {
+    static uint32_t next_id = 1;
+
     view->scene_descriptor = SCENE_DESC_VIEW;
     view->interface = interface;
     view->wlr_surface = surface;
     view->view_type = VIEW_TYPE_XDG_SHELL;
+    view->id = next_id++;
 
     view->mapped = false;
     view->is_fullscreen = false;
     view->is_maximized = false;
+    view->rules = (struct window_rule_actions){0};
 
     wl_list_init(&view->ptrs);
 
     view->server = server;
 }
 
+/* The output a rule asks for, or the one under the cursor */
+static struct wlr_output *view_rules_output(struct sycamore_view *view) {
+    struct sycamore_server *server = view->server;
+
+    if (view->rules.output) {
+        struct sycamore_output *output;
+        wl_list_for_each(output, &server->all_outputs, link) {
+            struct wlr_output *wlr_output = output->wlr_output;
+            if (strcmp(wlr_output->name, view->rules.output) == 0 &&
+                    wlr_output_layout_get(server->output_layout, wlr_output)) {
+                return wlr_output;
+            }
+        }
+    }
+
+    return cursor_at_output(server->seat->cursor, server->output_layout);
+}
+
+void view_apply_rules(struct sycamore_view *view) {
+    struct sycamore_server *server = view->server;
+    struct wlr_output *cursor_output =
+            cursor_at_output(server->seat->cursor, server->output_layout);
+
+    window_rules_match(server->config->window_rules, view_get_app_id(view),
+                       view_get_title(view), cursor_output ? cursor_output->name : NULL,
+                       &view->rules);
+    if (!view->rules.set) {
+        return;
+    }
+
+    struct wlr_output *output = view_rules_output(view);
+    struct wlr_box box;
+    wlr_output_layout_get_box(server->output_layout, output, &box);
+
+    if (view->rules.fullscreen) {
+        view->interface->set_fullscreen(view, true);
+        view->interface->set_size(view, box.width, box.height);
+    } else if (view->rules.maximized) {
+        if (output) {
+            struct sycamore_output *sycamore_output = output->data;
+            box = sycamore_output->usable_area;
+        }
+        view->interface->set_maximized(view, true);
+        view->interface->set_size(view, box.width, box.height);
+    } else if (view->rules.set & WINDOW_RULE_SIZE) {
+        view->interface->set_size(view, view->rules.width, view->rules.height);
+    }
+}
+
+static void view_set_opacity_iterator(struct wlr_scene_buffer *buffer,
+        int sx, int sy, void *data) {
+    wlr_scene_buffer_set_opacity(buffer, *(float *)data);
+}
+
 void view_map(struct sycamore_view *view,
         struct wlr_output *fullscreen_output, bool maximized, bool fullscreen) {
     if (view->mapped) {
@@ -33,13 +92,27 @@ void view_map(struct sycamore_view *view,
 
     wl_list_insert(&view->server->mapped_views, &view->link);
 
+    struct sycamore_client *client =
+            client_from_surface(view->server->client_manager, view->wlr_surface);
+    if (client) {
+        client->views++;
+    }
+
     struct sycamore_server *server = view->server;
     struct wlr_output_layout *layout = server->output_layout;
-    struct wlr_output *output = cursor_at_output(server->seat->cursor, layout);
+    struct wlr_output *output = view_rules_output(view);
     struct wlr_box box;
     wlr_output_layout_get_box(layout, output, &box);
 
-    view_move_to(view, box.x, box.y);
+    const struct window_rule_actions *rules = &view->rules;
+    if (rules->set & WINDOW_RULE_POSITION) {
+        view_move_to(view, box.x + rules->x, box.y + rules->y);
+    } else {
+        view_move_to(view, box.x, box.y);
+    }
+
+    maximized |= rules->maximized;
+    fullscreen |= rules->fullscreen;
 
     if (maximized) {
         if (output) {
@@ -62,8 +135,20 @@ void view_map(struct sycamore_view *view,
 
     view->interface->map(view);
 
+    if (rules->set & WINDOW_RULE_OPACITY) {
+        float opacity = rules->opacity;
+        wlr_scene_node_for_each_buffer(&view->scene_tree->node,
+                                       view_set_opacity_iterator, &opacity);
+    }
+    if (rules->set & WINDOW_RULE_MAX_FPS) {
+        client_surface_set_max_fps(server->client_manager, view->wlr_surface, rules->max_fps);
+    }
+
     view->mapped = true;
 
+    ipc_notify_view(server->ipc, IPC_EVENT_MAP, view);
+    idle_manager_update_inhibit(server->idle_manager);
+
     view_set_focus(view);
 
     struct sycamore_seat *seat = view->server->seat;
@@ -77,6 +162,12 @@ void view_unmap(struct sycamore_view *view) {
 
     wl_list_remove(&view->link);
 
+    struct sycamore_client *client =
+            client_from_surface(view->server->client_manager, view->wlr_surface);
+    if (client) {
+        client->views--;
+    }
+
     struct view_ptr *ptr, *next;
     wl_list_for_each_safe(ptr, next, &view->ptrs, link) {
         view_ptr_disconnect(ptr);
@@ -86,6 +177,9 @@ void view_unmap(struct sycamore_view *view) {
 
     view->mapped = false;
 
+    ipc_notify_view(view->server->ipc, IPC_EVENT_UNMAP, view);
+    idle_manager_update_inhibit(view->server->idle_manager);
+
     struct sycamore_seat *seat = view->server->seat;
     seat->seatop_impl->cursor_rebase(seat);
 }
@@ -95,6 +189,7 @@ void view_destroy(struct sycamore_view *view) {
         return;
     }
 
+    window_rule_actions_finish(&view->rules);
     view->interface->destroy(view);
 }
 
@@ -103,6 +198,9 @@ void view_move_to(struct sycamore_view *view, int x, int y) {
     view->y = y;
 
     wlr_scene_node_set_position(&view->scene_tree->node, x, y);
+    if (view->interface->set_position) {
+        view->interface->set_position(view, x, y);
+    }
 }
 
 struct sycamore_output *view_get_main_output(struct sycamore_view *view) {
@@ -152,6 +250,17 @@ void view_set_focus(struct sycamore_view *view) {
     }
 
     view_ptr_connect(&server->focused_view, view);
+
+    ipc_notify_view(server->ipc, IPC_EVENT_FOCUS, view);
+    idle_manager_update_inhibit(server->idle_manager);
+}
+
+const char *view_get_app_id(struct sycamore_view *view) {
+    return view->interface->get_app_id ? view->interface->get_app_id(view) : NULL;
+}
+
+const char *view_get_title(struct sycamore_view *view) {
+    return view->interface->get_title ? view->interface->get_title(view) : NULL;
 }
 
 void view_set_fullscreen(struct sycamore_view *view,
@@ -191,6 +300,7 @@ void view_set_fullscreen(struct sycamore_view *view,
 
     view->is_fullscreen = fullscreen;
     view->interface->set_fullscreen(view, fullscreen);
+    idle_manager_update_inhibit(view->server->idle_manager);
 }
 
 void view_set_maximized(struct sycamore_view *view,
@@ -223,6 +333,7 @@ void view_set_maximized(struct sycamore_view *view,
 
     view->is_maximized = maximized;
     view->interface->set_maximized(view, maximized);
+    idle_manager_update_inhibit(view->server->idle_manager);
 }
 
 void view_ptr_connect(struct view_ptr *ptr, struct sycamore_view *view) {
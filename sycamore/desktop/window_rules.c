@@ -0,0 +1,309 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "sycamore/desktop/window_rules.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325
+#define FNV_PRIME 0x100000001b3
+
+static uint64_t hash_app_id(const char *app_id) {
+    uint64_t hash = FNV_OFFSET;
+    for (; *app_id; ++app_id) {
+        hash = (hash ^ (uint8_t)*app_id) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static void window_rule_destroy(struct window_rule *rule) {
+    if (!rule) {
+        return;
+    }
+
+    if (rule->has_app_id_regex) {
+        regfree(&rule->app_id_regex);
+    }
+    if (rule->has_title_regex) {
+        regfree(&rule->title_regex);
+    }
+
+    window_rule_actions_finish(&rule->actions);
+    free(rule->app_id);
+    free(rule->title);
+    free(rule->output);
+    free(rule);
+}
+
+static bool parse_regex(regex_t *regex, bool *has_regex, const char *pattern) {
+    if (*has_regex) {
+        return false;
+    }
+
+    if (regcomp(regex, pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+        wlr_log(WLR_ERROR, "Invalid window rule regex '%s'", pattern);
+        return false;
+    }
+
+    *has_regex = true;
+    return true;
+}
+
+static bool parse_exact(char **dst, const char *str) {
+    if (*dst) {
+        return false;
+    }
+
+    *dst = strdup(str);
+    return *dst != NULL;
+}
+
+static bool parse_criterion(struct window_rule *rule, const char *token) {
+    if (strncmp(token, "app_id:", 7) == 0) {
+        return !rule->has_app_id_regex && parse_exact(&rule->app_id, token + 7);
+    } else if (strncmp(token, "app_id~", 7) == 0) {
+        return !rule->app_id && parse_regex(&rule->app_id_regex,
+                                            &rule->has_app_id_regex, token + 7);
+    } else if (strncmp(token, "title:", 6) == 0) {
+        return !rule->has_title_regex && parse_exact(&rule->title, token + 6);
+    } else if (strncmp(token, "title~", 6) == 0) {
+        return !rule->title && parse_regex(&rule->title_regex,
+                                           &rule->has_title_regex, token + 6);
+    } else if (strncmp(token, "output:", 7) == 0) {
+        return parse_exact(&rule->output, token + 7);
+    }
+
+    wlr_log(WLR_ERROR, "Unknown window rule criterion '%s'", token);
+    return false;
+}
+
+static bool parse_action(struct window_rule_actions *actions, const char *token) {
+    const char *value = strchr(token, '=');
+    value = value ? value + 1 : "";
+    char end;
+
+    if (strcmp(token, "maximized") == 0) {
+        actions->set |= WINDOW_RULE_MAXIMIZED;
+        actions->maximized = true;
+        return true;
+    } else if (strcmp(token, "fullscreen") == 0) {
+        actions->set |= WINDOW_RULE_FULLSCREEN;
+        actions->fullscreen = true;
+        return true;
+    } else if (strncmp(token, "output=", 7) == 0 && *value) {
+        free(actions->output);
+        actions->output = strdup(value);
+        actions->set |= WINDOW_RULE_OUTPUT;
+        return actions->output != NULL;
+    } else if (strncmp(token, "position=", 9) == 0) {
+        actions->set |= WINDOW_RULE_POSITION;
+        return sscanf(value, "%d,%d%c", &actions->x, &actions->y, &end) == 2;
+    } else if (strncmp(token, "size=", 5) == 0) {
+        actions->set |= WINDOW_RULE_SIZE;
+        return sscanf(value, "%dx%d%c", &actions->width, &actions->height, &end) == 2 &&
+               actions->width > 0 && actions->height > 0;
+    } else if (strncmp(token, "opacity=", 8) == 0) {
+        actions->set |= WINDOW_RULE_OPACITY;
+        return sscanf(value, "%f%c", &actions->opacity, &end) == 1 &&
+               actions->opacity >= 0.0f && actions->opacity <= 1.0f;
+    } else if (strncmp(token, "max-fps=", 8) == 0) {
+        actions->set |= WINDOW_RULE_MAX_FPS;
+        return sscanf(value, "%u%c", &actions->max_fps, &end) == 1 &&
+               actions->max_fps > 0 && actions->max_fps <= 1000;
+    }
+
+    wlr_log(WLR_ERROR, "Unknown window rule action '%s'", token);
+    return false;
+}
+
+bool window_rules_add(struct window_rules *rules, const char *criteria, const char *actions) {
+    struct window_rule *rule = calloc(1, sizeof(struct window_rule));
+    if (!rule) {
+        wlr_log(WLR_ERROR, "Unable to allocate window_rule");
+        return false;
+    }
+    rule->index = rules->rules.size / sizeof(struct window_rule *);
+
+    char *str = strdup(criteria);
+    bool ok = str != NULL;
+    char *save, *token;
+    for (token = strtok_r(str, " \t", &save); ok && token;
+            token = strtok_r(NULL, " \t", &save)) {
+        ok = parse_criterion(rule, token);
+    }
+    free(str);
+
+    if (ok && !rule->app_id && !rule->title && !rule->output &&
+            !rule->has_app_id_regex && !rule->has_title_regex) {
+        wlr_log(WLR_ERROR, "Window rule matches nothing");
+        ok = false;
+    }
+
+    str = ok ? strdup(actions) : NULL;
+    ok = str != NULL;
+    for (token = strtok_r(str, " \t", &save); ok && token;
+            token = strtok_r(NULL, " \t", &save)) {
+        ok = parse_action(&rule->actions, token);
+    }
+    free(str);
+
+    struct window_rule **slot = ok ? wl_array_add(&rules->rules, sizeof(rule)) : NULL;
+    if (!slot) {
+        wlr_log(WLR_ERROR, "Invalid window rule '%s = %s'", criteria, actions);
+        window_rule_destroy(rule);
+        return false;
+    }
+
+    *slot = rule;
+    return true;
+}
+
+bool window_rules_compile(struct window_rules *rules) {
+    size_t len = rules->rules.size / sizeof(struct window_rule *);
+
+    /* At most half full */
+    size_t buckets_len = 8;
+    while (buckets_len < 2 * len) {
+        buckets_len *= 2;
+    }
+
+    struct window_rule **buckets = calloc(buckets_len, sizeof(struct window_rule *));
+    if (!buckets) {
+        wlr_log(WLR_ERROR, "Unable to allocate window rule buckets");
+        return false;
+    }
+
+    free(rules->buckets);
+    rules->buckets = buckets;
+    rules->buckets_len = buckets_len;
+    rules->generic = NULL;
+
+    /* Backwards, so every chain ends up in config order */
+    struct window_rule **data = rules->rules.data;
+    for (size_t i = len; i-- > 0;) {
+        struct window_rule *rule = data[i];
+        struct window_rule **head = rule->app_id ?
+                &buckets[hash_app_id(rule->app_id) & (buckets_len - 1)] : &rules->generic;
+        rule->next = *head;
+        *head = rule;
+    }
+
+    return true;
+}
+
+static bool window_rule_matches(const struct window_rule *rule, const char *app_id,
+        const char *title, const char *output) {
+    if (rule->app_id && strcmp(rule->app_id, app_id) != 0) {
+        return false;
+    }
+    if (rule->title && strcmp(rule->title, title) != 0) {
+        return false;
+    }
+    if (rule->output && strcmp(rule->output, output) != 0) {
+        return false;
+    }
+    if (rule->has_app_id_regex && regexec(&rule->app_id_regex, app_id, 0, NULL, 0) != 0) {
+        return false;
+    }
+    if (rule->has_title_regex && regexec(&rule->title_regex, title, 0, NULL, 0) != 0) {
+        return false;
+    }
+
+    return true;
+}
+
+static void window_rule_actions_merge(struct window_rule_actions *dst,
+        const struct window_rule_actions *src) {
+    if (src->set & WINDOW_RULE_OUTPUT) {
+        free(dst->output);
+        dst->output = strdup(src->output);
+    }
+    if (src->set & WINDOW_RULE_POSITION) {
+        dst->x = src->x;
+        dst->y = src->y;
+    }
+    if (src->set & WINDOW_RULE_SIZE) {
+        dst->width = src->width;
+        dst->height = src->height;
+    }
+    if (src->set & WINDOW_RULE_MAXIMIZED) {
+        dst->maximized = src->maximized;
+    }
+    if (src->set & WINDOW_RULE_FULLSCREEN) {
+        dst->fullscreen = src->fullscreen;
+    }
+    if (src->set & WINDOW_RULE_OPACITY) {
+        dst->opacity = src->opacity;
+    }
+    if (src->set & WINDOW_RULE_MAX_FPS) {
+        dst->max_fps = src->max_fps;
+    }
+
+    dst->set |= src->set;
+    if (!dst->output) {
+        dst->set &= ~WINDOW_RULE_OUTPUT;
+    }
+}
+
+void window_rules_match(const struct window_rules *rules, const char *app_id,
+        const char *title, const char *output, struct window_rule_actions *actions) {
+    window_rule_actions_finish(actions);
+
+    if (!rules || !rules->buckets) {
+        return;
+    }
+
+    app_id = app_id ? app_id : "";
+    title = title ? title : "";
+    output = output ? output : "";
+
+    /* Both chains are in config order, walk them together */
+    struct window_rule *exact = rules->buckets[hash_app_id(app_id) & (rules->buckets_len - 1)];
+    struct window_rule *generic = rules->generic;
+    while (exact || generic) {
+        struct window_rule *rule;
+        if (!generic || (exact && exact->index < generic->index)) {
+            rule = exact;
+            exact = exact->next;
+        } else {
+            rule = generic;
+            generic = generic->next;
+        }
+
+        if (window_rule_matches(rule, app_id, title, output)) {
+            window_rule_actions_merge(actions, &rule->actions);
+        }
+    }
+}
+
+void window_rule_actions_finish(struct window_rule_actions *actions) {
+    free(actions->output);
+    *actions = (struct window_rule_actions){0};
+}
+
+struct window_rules *window_rules_create() {
+    struct window_rules *rules = calloc(1, sizeof(struct window_rules));
+    if (!rules) {
+        wlr_log(WLR_ERROR, "Unable to allocate window_rules");
+        return NULL;
+    }
+
+    wl_array_init(&rules->rules);
+    return rules;
+}
+
+void window_rules_destroy(struct window_rules *rules) {
+    if (!rules) {
+        return;
+    }
+
+    struct window_rule **rule;
+    wl_array_for_each(rule, &rules->rules) {
+        window_rule_destroy(*rule);
+    }
+    wl_array_release(&rules->rules);
+
+    free(rules->buckets);
+    free(rules);
+}
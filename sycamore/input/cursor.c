@@ -1,6 +1,13 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_output_layout.h>
@@ -10,12 +17,66 @@
 #include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
+#include <wlr/xcursor.h>
 #include "sycamore/input/cursor.h"
 #include "sycamore/output/output.h"
+#include "sycamore/util/prefetch.h"
+#include "sycamore/util/time.h"
 #include "sycamore/server.h"
 
+/* A theme scale read on a worker thread, so crossing onto an output with a new
+ * scale doesn't stall input. Handed over through a pipe like the prefetch. */
+struct xcursor_scale_load {
+    pthread_t thread;
+    int fds[2];     //written to by the worker when done
+    struct wl_event_source *source;
+
+    char *name;
+    unsigned size;
+    float scale;
+    struct wlr_xcursor_theme *theme;    //filled by the worker
+    uint64_t start_nsec;
+
+    struct sycamore_cursor *cursor;
+};
+
+static void cursor_update_scale(struct sycamore_cursor *cursor);
+
+static bool xcursor_scale_loaded(struct wlr_xcursor_manager *manager, float scale) {
+    struct wlr_xcursor_manager_theme *theme;
+    wl_list_for_each(theme, &manager->scaled_themes, link) {
+        if (theme->scale == scale) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Until the theme at the cursor's scale is read, every output shows the image
+ * from a theme already loaded, at that theme's size */
+static void cursor_set_fallback_image(struct sycamore_cursor *cursor, const char *image) {
+    struct wlr_xcursor_manager *manager = cursor->xcursor_manager;
+    if (wl_list_empty(&manager->scaled_themes) ||
+            xcursor_scale_loaded(manager, cursor->scale)) {
+        return;
+    }
+
+    struct wlr_xcursor_manager_theme *theme =
+            wl_container_of(manager->scaled_themes.next, theme, link);
+    struct wlr_xcursor *xcursor = wlr_xcursor_theme_get_cursor(theme->theme, image);
+    if (!xcursor) {
+        return;
+    }
+
+    struct wlr_xcursor_image *xcursor_image = xcursor->images[0];
+    wlr_cursor_set_image(cursor->wlr_cursor, xcursor_image->buffer, xcursor_image->width * 4,
+                         xcursor_image->width, xcursor_image->height,
+                         xcursor_image->hotspot_x, xcursor_image->hotspot_y, 0);
+}
+
 void cursor_set_image(struct sycamore_cursor *cursor, const char *image) {
-    if (!cursor->enabled) {
+    if (!cursor->enabled || cursor->hidden) {
         return;
     }
 
@@ -24,6 +85,7 @@ void cursor_set_image(struct sycamore_cursor *cursor, const char *image) {
         wlr_cursor_set_image(cursor->wlr_cursor, NULL, 0, 0, 0, 0, 0, 0);
     } else if (!cursor->image || strcmp(cursor->image, image) != 0) {
         cursor->image = image;
+        cursor_set_fallback_image(cursor, image);
         wlr_xcursor_manager_set_cursor_image(cursor->xcursor_manager,
                                              image, cursor->wlr_cursor);
     }
@@ -31,7 +93,7 @@ void cursor_set_image(struct sycamore_cursor *cursor, const char *image) {
 
 void cursor_set_image_surface(struct sycamore_cursor *cursor,
         struct wlr_seat_pointer_request_set_cursor_event *event) {
-    if (!cursor->enabled) {
+    if (!cursor->enabled || cursor->hidden) {
         return;
     }
 
@@ -78,29 +140,36 @@ void cursor_disable(struct sycamore_cursor *cursor) {
 }
 
 void cursor_warp_to_output_center(struct sycamore_cursor *cursor, struct sycamore_output *output) {
+    if (output->virtual) {
+        return;
+    }
+
     struct wlr_cursor *wlr_cursor = cursor->wlr_cursor;
     struct wlr_fbox box;
     output_get_center_coords(output, &box);
     wlr_cursor_warp(wlr_cursor, NULL, box.x, box.y);
 }
 
+void xcursor_setenv(struct sycamore_config *config) {
+    char size_fmt[16];
+    snprintf(size_fmt, sizeof(size_fmt), "%u", config->cursor.size);
+    setenv("XCURSOR_SIZE", size_fmt, 1);
+
+    if (config->cursor.theme) {
+        setenv("XCURSOR_THEME", config->cursor.theme, 1);
+    } else {
+        unsetenv("XCURSOR_THEME");
+    }
+}
+
 bool xcursor_init(struct sycamore_cursor *cursor) {
-    /* TODO: Get cursor theme/size from config file
-     * recreate xcursor manager if theme/size changed. */
     if (cursor->xcursor_manager) {
         return true;
     }
 
-    unsigned size = 24;
-    const char *theme = NULL;
-
-    char size_fmt[16];
-    snprintf(size_fmt, sizeof(size_fmt), "%u", size);
-    setenv("XCURSOR_SIZE", size_fmt, 1);
-
-    if (theme) {
-        setenv("XCURSOR_THEME", theme, 1);
-    }
+    struct sycamore_config *config = cursor->seat->server->config;
+    unsigned size = config->cursor.size;
+    const char *theme = config->cursor.theme;
 
     cursor->xcursor_manager = wlr_xcursor_manager_create(theme, size);
     if (!cursor->xcursor_manager) {
@@ -126,31 +195,218 @@ void xcursor_reset(struct sycamore_cursor *cursor) {
     wlr_cursor_warp(wlr_cursor, NULL, wlr_cursor->x, wlr_cursor->y);
 }
 
+static void *xcursor_scale_load_run(void *data) {
+    struct xcursor_scale_load *load = data;
+
+    load->theme = wlr_xcursor_theme_load(load->name, load->size * load->scale);
+
+    char byte = 0;
+    while (write(load->fds[1], &byte, 1) < 0 && errno == EINTR) {}
+
+    return NULL;
+}
+
+static void xcursor_scale_load_destroy(struct xcursor_scale_load *load) {
+    pthread_join(load->thread, NULL);
+    wl_event_source_remove(load->source);
+    close(load->fds[0]);
+    close(load->fds[1]);
+
+    if (load->theme) {
+        wlr_xcursor_theme_destroy(load->theme);
+    }
+    free(load->name);
+    free(load);
+}
+
+static int handle_xcursor_scale_loaded(int fd, uint32_t mask, void *data) {
+    struct xcursor_scale_load *load = data;
+    struct sycamore_cursor *cursor = load->cursor;
+    struct wlr_xcursor_manager *manager = cursor->xcursor_manager;
+    cursor->scale_load = NULL;
+
+    if (!load->theme) {
+        /* Not retried until the cursor gets onto another scale */
+        wlr_log(WLR_ERROR, "Unable to load cursor theme at scale %.2f", load->scale);
+        xcursor_scale_load_destroy(load);
+        return 0;
+    }
+
+    /* Same as wlr_xcursor_manager_load(), which would read the files here */
+    struct wlr_xcursor_manager_theme *theme =
+            calloc(1, sizeof(struct wlr_xcursor_manager_theme));
+    if (!theme) {
+        wlr_log(WLR_ERROR, "Unable to allocate wlr_xcursor_manager_theme");
+        xcursor_scale_load_destroy(load);
+        return 0;
+    }
+
+    theme->scale = load->scale;
+    theme->theme = load->theme;
+    load->theme = NULL;
+    wl_list_insert(&manager->scaled_themes, &theme->link);
+
+    wlr_log(WLR_DEBUG, "Loaded cursor theme at scale %.2f in %" PRIu64 " us",
+            load->scale, (get_current_time_nsec() - load->start_nsec) / 1000);
+    xcursor_scale_load_destroy(load);
+
+    /* The cursor may be on yet another scale by now */
+    cursor->scale = 0.0f;
+    cursor_update_scale(cursor);
+
+    /* Set the image again, now that it exists at this scale */
+    const char *image = cursor->image;
+    if (image) {
+        cursor->image = NULL;
+        cursor_set_image(cursor, image);
+    }
+
+    return 0;
+}
+
+static void xcursor_scale_load_start(struct sycamore_cursor *cursor, float scale) {
+    struct xcursor_scale_load *load = calloc(1, sizeof(struct xcursor_scale_load));
+    if (!load) {
+        wlr_log(WLR_ERROR, "Unable to allocate xcursor_scale_load");
+        return;
+    }
+
+    struct wlr_xcursor_manager *manager = cursor->xcursor_manager;
+    load->name = manager->name ? strdup(manager->name) : NULL;
+    if (manager->name && !load->name) {
+        wlr_log(WLR_ERROR, "Unable to allocate xcursor_scale_load");
+        free(load);
+        return;
+    }
+
+    load->size = manager->size;
+    load->scale = scale;
+    load->cursor = cursor;
+    load->start_nsec = get_current_time_nsec();
+
+    if (pipe2(load->fds, O_CLOEXEC) < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to create cursor theme pipe");
+        free(load->name);
+        free(load);
+        return;
+    }
+
+    struct wl_event_loop *loop =
+            wl_display_get_event_loop(cursor->seat->server->wl_display);
+    load->source = wl_event_loop_add_fd(loop, load->fds[0], WL_EVENT_READABLE,
+                                        handle_xcursor_scale_loaded, load);
+    if (!load->source) {
+        wlr_log(WLR_ERROR, "Unable to add cursor theme event source");
+        close(load->fds[0]);
+        close(load->fds[1]);
+        free(load->name);
+        free(load);
+        return;
+    }
+
+    /* Signals are for the main loop, which turns them into events */
+    sigset_t mask, old_mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, &old_mask);
+    int ret = pthread_create(&load->thread, NULL, xcursor_scale_load_run, load);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    if (ret != 0) {
+        wlr_log(WLR_ERROR, "Unable to start cursor theme thread");
+        wl_event_source_remove(load->source);
+        close(load->fds[0]);
+        close(load->fds[1]);
+        free(load->name);
+        free(load);
+        return;
+    }
+
+    cursor->scale_load = load;
+}
+
+/* Themes are loaded once per distinct scale, and only when the cursor first
+ * gets onto an output with that scale: outputs showing up don't read theme
+ * files, and outputs sharing a scale share the theme. The files are read on
+ * a worker, the cursor keeps a scale already loaded meanwhile. */
+static void cursor_update_scale(struct sycamore_cursor *cursor) {
+    if (cursor->hidden) {
+        return;
+    }
+
+    struct wlr_output *output = cursor_at_output(cursor, cursor->seat->server->output_layout);
+    if (!output || output->scale == cursor->scale) {
+        return;
+    }
+
+    cursor->scale = output->scale;
+    if (xcursor_scale_loaded(cursor->xcursor_manager, cursor->scale)) {
+        return;
+    }
+
+    /* The prefetch brings the theme at scale 1 and gets back here when done */
+    struct sycamore_prefetch *prefetch = cursor->seat->server->prefetch;
+    if (prefetch && !prefetch->done) {
+        return;
+    }
+
+    /* One at a time, the one in flight checks the scale again when done */
+    if (!cursor->scale_load) {
+        xcursor_scale_load_start(cursor, cursor->scale);
+    }
+}
+
+/* Recreate the xcursor manager after the theme or size changed */
 void xcursor_reload(struct sycamore_cursor *cursor) {
+    /* The prefetch thread is joined by now, see config_apply(). A theme
+     * still being read is for the old manager, and reads environ too. */
+    if (cursor->scale_load) {
+        xcursor_scale_load_destroy(cursor->scale_load);
+        cursor->scale_load = NULL;
+    }
+    xcursor_setenv(cursor->seat->server->config);
+
+    struct wlr_xcursor_manager *old = cursor->xcursor_manager;
+    cursor->xcursor_manager = NULL;
     if (!xcursor_init(cursor)) {
+        cursor->xcursor_manager = old;
         return;
     }
+    wlr_xcursor_manager_destroy(old);
 
-    struct sycamore_output *output;
-    wl_list_for_each(output, &cursor->seat->server->all_outputs, link) {
-        wlr_xcursor_manager_load(cursor->xcursor_manager,
-                                 output->wlr_output->scale);
+    cursor->scale = 0.0f;
+    cursor_update_scale(cursor);
+
+    xcursor_reset(cursor);
+}
+
+bool cursor_adopt_xcursor_manager(struct sycamore_cursor *cursor,
+        struct wlr_xcursor_manager *manager) {
+    if (!wl_list_empty(&cursor->xcursor_manager->scaled_themes)) {
+        return false;
     }
 
+    wlr_xcursor_manager_destroy(cursor->xcursor_manager);
+    cursor->xcursor_manager = manager;
+
+    cursor->scale = 0.0f;
+    cursor_update_scale(cursor);
     xcursor_reset(cursor);
+    return true;
 }
 
 void output_setup_xcursor(struct sycamore_cursor *cursor, struct sycamore_output *output) {
-    wlr_xcursor_manager_load(cursor->xcursor_manager, output->wlr_output->scale);
-
     /* If this is the first output, cursor should be in the center of it*/
-    if (wl_list_length(&output->server->all_outputs) == 1) {
+    if (wl_list_length(&output->server->all_outputs) == 1 && !output->virtual) {
         struct wlr_fbox box;
         output_get_center_coords(output, &box);
         cursor->wlr_cursor->x = box.x;
         cursor->wlr_cursor->y = box.y;
     }
 
+    /* The output may have changed scale under the cursor */
+    cursor->scale = 0.0f;
+    cursor_update_scale(cursor);
+
     xcursor_reset(cursor);
 }
 
@@ -163,14 +419,46 @@ struct wlr_output *cursor_at_output(struct sycamore_cursor *cursor,
     return output;
 }
 
+static bool cursor_on_virtual_output(struct sycamore_cursor *cursor) {
+    struct wlr_output *output = cursor_at_output(cursor, cursor->seat->server->output_layout);
+    struct sycamore_output *sycamore_output = output ? output->data : NULL;
+    return sycamore_output && sycamore_output->virtual;
+}
+
+/* Virtual outputs are off-screen, move the cursor back from them, sliding
+ * along their edge where possible */
+static void cursor_leave_virtual_output(struct sycamore_cursor *cursor, double x, double y) {
+    struct wlr_cursor *wlr_cursor = cursor->wlr_cursor;
+    if (!cursor_on_virtual_output(cursor)) {
+        return;
+    }
+
+    double new_x = wlr_cursor->x, new_y = wlr_cursor->y;
+    wlr_cursor_warp_closest(wlr_cursor, NULL, new_x, y);
+    if (!cursor_on_virtual_output(cursor)) {
+        return;
+    }
+
+    wlr_cursor_warp_closest(wlr_cursor, NULL, x, new_y);
+    if (!cursor_on_virtual_output(cursor)) {
+        return;
+    }
+
+    wlr_cursor_warp_closest(wlr_cursor, NULL, x, y);
+}
+
 static void handle_cursor_motion(struct wl_listener *listener, void *data) {
     /* This event is forwarded by the cursor when a pointer emits a _relative_
      * pointer motion event (i.e. a delta) */
     struct sycamore_cursor *cursor = wl_container_of(listener, cursor, cursor_motion);
     struct wlr_pointer_motion_event *event = data;
+    seat_notify_activity(cursor->seat);
     cursor_enable(cursor);
+    double x = cursor->wlr_cursor->x, y = cursor->wlr_cursor->y;
     wlr_cursor_move(cursor->wlr_cursor, &event->pointer->base,
                     event->delta_x, event->delta_y);
+    cursor_leave_virtual_output(cursor, x, y);
+    cursor_update_scale(cursor);
     cursor->seat->seatop_impl->pointer_motion(cursor->seat, event->time_msec);
 }
 
@@ -183,8 +471,12 @@ static void handle_cursor_motion_absolute(struct wl_listener *listener, void *da
      * emits these events. */
     struct sycamore_cursor *cursor = wl_container_of(listener, cursor, cursor_motion_absolute);
     struct wlr_pointer_motion_absolute_event *event = data;
+    seat_notify_activity(cursor->seat);
     cursor_enable(cursor);
+    double x = cursor->wlr_cursor->x, y = cursor->wlr_cursor->y;
     wlr_cursor_warp_absolute(cursor->wlr_cursor, &event->pointer->base, event->x, event->y);
+    cursor_leave_virtual_output(cursor, x, y);
+    cursor_update_scale(cursor);
     cursor->seat->seatop_impl->pointer_motion(cursor->seat, event->time_msec);
 }
 
@@ -192,6 +484,7 @@ static void handle_cursor_button(struct wl_listener *listener, void *data) {
     /* This event is forwarded by the cursor when a pointer emits a button event. */
     struct sycamore_cursor *cursor = wl_container_of(listener, cursor, cursor_button);
     struct wlr_pointer_button_event *event = data;
+    seat_notify_activity(cursor->seat);
     cursor_enable(cursor);
     cursor->seat->seatop_impl->pointer_button(cursor->seat, event);
 }
@@ -201,6 +494,7 @@ static void handle_cursor_axis(struct wl_listener *listener, void *data) {
      * for example when you move the scroll wheel. */
     struct sycamore_cursor *cursor = wl_container_of(listener, cursor, cursor_axis);
     struct wlr_pointer_axis_event *event = data;
+    seat_notify_activity(cursor->seat);
     cursor_enable(cursor);
     /* Notify the client with pointer focus of the axis event. */
     wlr_seat_pointer_notify_axis(cursor->seat->wlr_seat,
@@ -221,6 +515,7 @@ static void handle_cursor_frame(struct wl_listener *listener, void *data) {
 static void handle_swipe_begin(struct wl_listener *listener, void *data) {
     struct sycamore_cursor *cursor = wl_container_of(listener, cursor, swipe_begin);
     struct wlr_pointer_swipe_begin_event *event = data;
+    seat_notify_activity(cursor->seat);
     cursor_enable(cursor);
     wlr_pointer_gestures_v1_send_swipe_begin(cursor->gestures, cursor->seat->wlr_seat,
                                              event->time_msec, event->fingers);
@@ -245,6 +540,7 @@ static void handle_swipe_end(struct wl_listener *listener, void *data) {
 static void handle_pinch_begin(struct wl_listener *listener, void *data) {
     struct sycamore_cursor *cursor = wl_container_of(listener, cursor, pinch_begin);
     struct wlr_pointer_pinch_begin_event *event = data;
+    seat_notify_activity(cursor->seat);
     cursor_enable(cursor);
     wlr_pointer_gestures_v1_send_pinch_begin(cursor->gestures, cursor->seat->wlr_seat,
                                              event->time_msec, event->fingers);
@@ -270,6 +566,7 @@ static void handle_pinch_end(struct wl_listener *listener, void *data) {
 static void handle_hold_begin(struct wl_listener *listener, void *data) {
     struct sycamore_cursor *cursor = wl_container_of(listener, cursor, hold_begin);
     struct wlr_pointer_hold_begin_event *event = data;
+    seat_notify_activity(cursor->seat);
     cursor_enable(cursor);
     wlr_pointer_gestures_v1_send_hold_begin(cursor->gestures, cursor->seat->wlr_seat,
                                             event->time_msec, event->fingers);
@@ -303,6 +600,10 @@ void sycamore_cursor_destroy(struct sycamore_cursor *cursor) {
     wl_list_remove(&cursor->hold_begin.link);
     wl_list_remove(&cursor->hold_end.link);
 
+    if (cursor->scale_load) {
+        xcursor_scale_load_destroy(cursor->scale_load);
+    }
+
     if (cursor->xcursor_manager) {
         wlr_xcursor_manager_destroy(cursor->xcursor_manager);
     }
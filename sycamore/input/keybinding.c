@@ -1,8 +1,13 @@
 #include <stdlib.h>
-#include <unistd.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include "sycamore/input/keybinding.h"
+#include "sycamore/config.h"
+#include "sycamore/config_watch.h"
 #include "sycamore/desktop/view.h"
+#include "sycamore/output/output.h"
+#include "sycamore/output/virtual_output.h"
+#include "sycamore/util/stats.h"
 #include "sycamore/server.h"
 
 bool handle_keybinding(struct sycamore_keybinding_manager *manager, uint32_t modifiers, xkb_keysym_t sym) {
@@ -26,18 +31,19 @@ bool handle_keybinding(struct sycamore_keybinding_manager *manager, uint32_t mod
     return false;
 }
 
+/* action */
+static void exec_command(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
+    launcher_spawn(server->launcher, keybinding->argument);
+}
+
 /* action */
 static void open_launcher(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
-    if (fork() == 0) {
-        execl("/bin/sh", "/bin/sh", "-c", "fuzzel -i Papirus", (void *)NULL);
-    }
+    launcher_spawn(server->launcher, "fuzzel -i Papirus");
 }
 
 /* action */
 static void open_terminal(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
-    if (fork() == 0) {
-        execl("/bin/sh", "/bin/sh", "-c", "gnome-terminal", (void *)NULL);
-    }
+    launcher_spawn(server->launcher, "gnome-terminal");
 }
 
 /* action */
@@ -62,6 +68,50 @@ static void cycle_view(struct sycamore_server *server, struct sycamore_keybindin
     seat->seatop_impl->cursor_rebase(seat);
 }
 
+/* action */
+static void dump_stats(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
+    stats_dump(server);
+}
+
+/* action */
+static void cycle_damage_mode(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
+    stats_cycle_damage_mode(server);
+}
+
+/* action */
+static void add_virtual_output(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
+    /* Checked when the keybinding was parsed */
+    struct virtual_output_spec spec;
+    virtual_output_parse_spec(keybinding->argument ? keybinding->argument :
+                              VIRTUAL_OUTPUT_DEFAULT_SPEC, &spec);
+    virtual_output_create_from_spec(server, &spec);
+}
+
+/* action */
+static void remove_virtual_output(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
+    if (keybinding->argument) {
+        struct sycamore_output *output = virtual_output_from_name(server, keybinding->argument);
+        if (output) {
+            virtual_output_destroy(output);
+        }
+        return;
+    }
+
+    /* Newest first */
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        if (output->virtual) {
+            virtual_output_destroy(output);
+            return;
+        }
+    }
+}
+
+/* action */
+static void reload_config(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
+    config_watch_reload(server->config_watch);
+}
+
 /* action */
 static void terminate_server(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
     wl_display_terminate(server->wl_display);
@@ -71,12 +121,58 @@ static void terminate_server(struct sycamore_server *server, struct sycamore_key
 static void switch_vt(struct sycamore_server *server, struct sycamore_keybinding *keybinding) {
     struct wlr_session *session = wlr_backend_get_session(server->backend);
 
-    if (session != NULL) {
+    /* Bound from the config file, it may be on any key */
+    if (session != NULL && keybinding->sym >= XKB_KEY_XF86Switch_VT_1 &&
+            keybinding->sym <= XKB_KEY_XF86Switch_VT_12) {
         unsigned vt = keybinding->sym - XKB_KEY_XF86Switch_VT_1 + 1;
         wlr_session_change_vt(session, vt);
     }
 }
 
+static const struct {
+    const char *name;
+    keybinding_action action;
+} keybinding_actions[] = {
+    { "none", NULL },
+    { "exec", exec_command },
+    { "launcher", open_launcher },
+    { "terminal", open_terminal },
+    { "close", close_focused_view },
+    { "cycle-view", cycle_view },
+    { "dump-stats", dump_stats },
+    { "cycle-damage-mode", cycle_damage_mode },
+    { "add-virtual-output", add_virtual_output },
+    { "remove-virtual-output", remove_virtual_output },
+    { "reload", reload_config },
+    { "terminate", terminate_server },
+    { "switch-vt", switch_vt },
+};
+
+bool keybinding_action_from_name(const char *name, keybinding_action *action) {
+    for (size_t i = 0; i < sizeof(keybinding_actions) / sizeof(keybinding_actions[0]); ++i) {
+        if (strcmp(name, keybinding_actions[i].name) == 0) {
+            *action = keybinding_actions[i].action;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool keybinding_action_check_argument(keybinding_action action, const char *argument) {
+    if (action == exec_command) {
+        return argument != NULL;
+    } else if (action == add_virtual_output) {
+        struct virtual_output_spec spec;
+        return !argument || virtual_output_parse_spec(argument, &spec);
+    } else if (action == remove_virtual_output) {
+        /* An output name, which may only show up later */
+        return true;
+    }
+
+    return argument == NULL;
+}
+
 static struct keybinding_modifiers_node *keybinding_modifiers_node_create(
         struct sycamore_keybinding_manager *manager, uint32_t modifiers) {
     struct keybinding_modifiers_node *node =
@@ -94,6 +190,12 @@ static struct keybinding_modifiers_node *keybinding_modifiers_node_create(
     return node;
 }
 
+static void sycamore_keybinding_destroy(struct sycamore_keybinding *keybinding) {
+    wl_list_remove(&keybinding->link);
+    free(keybinding->argument);
+    free(keybinding);
+}
+
 static struct sycamore_keybinding *sycamore_keybinding_create(struct keybinding_modifiers_node *node,
         uint32_t modifiers, xkb_keysym_t sym, keybinding_action action) {
     struct sycamore_keybinding *keybinding = calloc(1, sizeof(struct sycamore_keybinding));
@@ -111,6 +213,53 @@ static struct sycamore_keybinding *sycamore_keybinding_create(struct keybinding_
     return keybinding;
 }
 
+bool sycamore_keybinding_manager_add(struct sycamore_keybinding_manager *manager,
+        uint32_t modifiers, xkb_keysym_t sym, keybinding_action action, const char *argument) {
+    struct keybinding_modifiers_node *node = NULL, *iter;
+    wl_list_for_each(iter, &manager->modifiers_nodes, link) {
+        if (iter->modifiers == modifiers) {
+            node = iter;
+            break;
+        }
+    }
+
+    if (node) {
+        struct sycamore_keybinding *keybinding, *next;
+        wl_list_for_each_safe(keybinding, next, &node->keybindings, link) {
+            if (keybinding->sym == sym) {
+                sycamore_keybinding_destroy(keybinding);
+            }
+        }
+    }
+
+    if (!action) {
+        return true;
+    }
+
+    if (!node) {
+        node = keybinding_modifiers_node_create(manager, modifiers);
+        if (!node) {
+            return false;
+        }
+    }
+
+    struct sycamore_keybinding *keybinding =
+            sycamore_keybinding_create(node, modifiers, sym, action);
+    if (!keybinding) {
+        return false;
+    }
+
+    if (argument) {
+        keybinding->argument = strdup(argument);
+        if (!keybinding->argument) {
+            sycamore_keybinding_destroy(keybinding);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void sycamore_keybinding_manager_destroy(struct sycamore_keybinding_manager *manager) {
     if (!manager) {
         return;
@@ -120,8 +269,7 @@ void sycamore_keybinding_manager_destroy(struct sycamore_keybinding_manager *man
     wl_list_for_each_safe(node, next_node, &manager->modifiers_nodes, link) {
         struct sycamore_keybinding *keybinding, *next_keybinding;
         wl_list_for_each_safe(keybinding, next_keybinding, &node->keybindings, link) {
-            wl_list_remove(&keybinding->link);
-            free(keybinding);
+            sycamore_keybinding_destroy(keybinding);
         }
         wl_list_remove(&node->link);
         free(node);
@@ -153,6 +301,19 @@ struct sycamore_keybinding_manager *sycamore_keybinding_manager_create(struct sy
     sycamore_keybinding_create(logo, logo->modifiers, XKB_KEY_q, close_focused_view);
     sycamore_keybinding_create(logo, logo->modifiers, XKB_KEY_Tab, cycle_view);
 
+    /* logo+shift */
+    struct keybinding_modifiers_node *logo_shift =
+            keybinding_modifiers_node_create(manager, WLR_MODIFIER_LOGO | WLR_MODIFIER_SHIFT);
+    if (!logo_shift) {
+        wlr_log(WLR_ERROR, "Unable to create keybinding_modifiers_node: logo_shift");
+        sycamore_keybinding_manager_destroy(manager);
+        return NULL;
+    }
+    sycamore_keybinding_create(logo_shift, logo_shift->modifiers, XKB_KEY_S, dump_stats);
+    sycamore_keybinding_create(logo_shift, logo_shift->modifiers, XKB_KEY_D, cycle_damage_mode);
+    sycamore_keybinding_create(logo_shift, logo_shift->modifiers, XKB_KEY_O, add_virtual_output);
+    sycamore_keybinding_create(logo_shift, logo_shift->modifiers, XKB_KEY_U, remove_virtual_output);
+
     /* ctrl+alt */
     struct keybinding_modifiers_node *ctrl_alt =
             keybinding_modifiers_node_create(manager, WLR_MODIFIER_CTRL | WLR_MODIFIER_ALT);
@@ -169,5 +330,15 @@ struct sycamore_keybinding_manager *sycamore_keybinding_manager_create(struct sy
     sycamore_keybinding_create(ctrl_alt, ctrl_alt->modifiers, XKB_KEY_XF86Switch_VT_5, switch_vt);
     sycamore_keybinding_create(ctrl_alt, ctrl_alt->modifiers, XKB_KEY_XF86Switch_VT_6, switch_vt);
 
+    struct config_keybinding *binding;
+    wl_array_for_each(binding, &server->config->keybindings) {
+        if (!sycamore_keybinding_manager_add(manager, binding->modifiers,
+                                             binding->sym, binding->action, binding->argument)) {
+            wlr_log(WLR_ERROR, "Unable to add keybinding from config");
+            sycamore_keybinding_manager_destroy(manager);
+            return NULL;
+        }
+    }
+
     return manager;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <wlr/util/log.h>
 #include "sycamore/input/keyboard.h"
 #include "sycamore/input/keybinding.h"
+#include "sycamore/util/prefetch.h"
 #include "sycamore/server.h"
 
 static void handle_keyboard_modifiers(struct wl_listener *listener, void *data) {
@@ -23,6 +24,8 @@ static void handle_keyboard_key(struct wl_listener *listener, void *data) {
     struct wlr_keyboard_key_event *event = data;
     struct wlr_seat *seat = keyboard->base->seat->wlr_seat;
 
+    seat_notify_activity(keyboard->base->seat);
+
     /* Translate libinput keycode -> xkbcommon */
     uint32_t keycode = event->keycode + 8;
     /* Get a list of keysyms based on the keymap for this keyboard */
@@ -63,12 +66,12 @@ static void sycamore_keyboard_destroy(struct sycamore_seat_device *seat_device)
         wlr_seat_set_keyboard(wlr_seat, NULL);
     }
 
-    free(seat_device->keyboard);
+    pool_free(&seat_device->seat->server->pools[POOL_KEYBOARD], seat_device->keyboard);
 }
 
 struct sycamore_keyboard *sycamore_keyboard_create(struct sycamore_seat *seat,
         struct wlr_input_device *wlr_device) {
-    struct sycamore_keyboard *keyboard = calloc(1, sizeof(struct sycamore_keyboard));
+    struct sycamore_keyboard *keyboard = pool_alloc(&seat->server->pools[POOL_KEYBOARD]);
     if (!keyboard) {
         wlr_log(WLR_ERROR, "Unable to allocate sycamore_keyboard");
         return NULL;
@@ -78,7 +81,7 @@ struct sycamore_keyboard *sycamore_keyboard_create(struct sycamore_seat *seat,
                                         sycamore_keyboard_destroy);
     if (!keyboard->base) {
         wlr_log(WLR_ERROR, "Unable to create seat_device");
-        free(keyboard);
+        pool_free(&seat->server->pools[POOL_KEYBOARD], keyboard);
         return NULL;
     }
 
@@ -108,12 +111,20 @@ struct xkb_keymap *sycamore_keyboard_compile_keymap() {
 }
 
 void sycamore_keyboard_configure(struct sycamore_keyboard *keyboard) {
-    struct xkb_keymap *keymap = sycamore_keyboard_compile_keymap();
-    if (!keymap) {
-        wlr_log(WLR_ERROR, "Unable to compile xkb_keymap");
-        return;
+    /* Every keyboard gets the same keymap, compiled once. It may be on its
+     * way from the prefetch thread already. */
+    struct sycamore_seat *seat = keyboard->base->seat;
+    if (!seat->keymap) {
+        prefetch_finish(seat->server->prefetch);
+    }
+
+    if (!seat->keymap) {
+        seat->keymap = sycamore_keyboard_compile_keymap();
+        if (!seat->keymap) {
+            wlr_log(WLR_ERROR, "Unable to compile xkb_keymap");
+            return;
+        }
     }
 
-    wlr_keyboard_set_keymap(keyboard->wlr_keyboard, keymap);
-    xkb_keymap_unref(keymap);
+    wlr_keyboard_set_keymap(keyboard->wlr_keyboard, seat->keymap);
 }
\ No newline at end of file
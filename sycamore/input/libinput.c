@@ -56,22 +56,22 @@ static bool device_is_touchpad(struct wlr_input_device *device) {
     return libinput_device_config_tap_get_finger_count(libinput_device) > 0;
 }
 
-void touchpad_set_natural_scroll(struct wlr_input_device *device) {
+void touchpad_set_natural_scroll(struct wlr_input_device *device, bool enabled) {
     if (!device_is_touchpad(device)) {
         return;
     }
 
     struct libinput_device *libinput_device = wlr_libinput_get_device_handle(device);
-    set_natural_scroll(libinput_device, true);
+    set_natural_scroll(libinput_device, enabled);
 }
 
-void touchpad_set_tap_to_click(struct wlr_input_device *device) {
+void touchpad_set_tap_to_click(struct wlr_input_device *device, bool enabled) {
     if (!device_is_touchpad(device)) {
         return;
     }
 
     struct libinput_device *libinput_device = wlr_libinput_get_device_handle(device);
-    set_tap(libinput_device, LIBINPUT_CONFIG_TAP_ENABLED);
+    set_tap(libinput_device, enabled ? LIBINPUT_CONFIG_TAP_ENABLED : LIBINPUT_CONFIG_TAP_DISABLED);
 }
 
 void touchpad_set_accel_speed(struct wlr_input_device* device, double speed) {
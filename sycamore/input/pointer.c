@@ -2,6 +2,7 @@
 #include <wlr/util/log.h>
 #include "sycamore/input/pointer.h"
 #include "sycamore/input/seat.h"
+#include "sycamore/server.h"
 
 static void sycamore_pointer_destroy(struct sycamore_seat_device *seat_device) {
     if (!seat_device) {
@@ -11,12 +12,12 @@ static void sycamore_pointer_destroy(struct sycamore_seat_device *seat_device) {
     wlr_cursor_detach_input_device(seat_device->seat->cursor->wlr_cursor,
                                    seat_device->wlr_device);
 
-    free(seat_device->pointer);
+    pool_free(&seat_device->seat->server->pools[POOL_POINTER], seat_device->pointer);
 }
 
 struct sycamore_pointer *sycamore_pointer_create(struct sycamore_seat *seat,
         struct wlr_input_device *wlr_device) {
-    struct sycamore_pointer *pointer = calloc(1, sizeof(struct sycamore_pointer));
+    struct sycamore_pointer *pointer = pool_alloc(&seat->server->pools[POOL_POINTER]);
     if (!pointer) {
         wlr_log(WLR_ERROR, "Unable to allocate sycamore_pointer");
         return NULL;
@@ -26,7 +27,7 @@ struct sycamore_pointer *sycamore_pointer_create(struct sycamore_seat *seat,
                                        sycamore_pointer_destroy);
     if (!pointer->base) {
         wlr_log(WLR_ERROR, "Unable to create seat_device");
-        free(pointer);
+        pool_free(&seat->server->pools[POOL_POINTER], pointer);
         return NULL;
     }
 
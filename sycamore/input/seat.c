@@ -41,13 +41,13 @@ static void handle_sycamore_drag_destroy(struct wl_listener *listener, void *dat
     wl_list_remove(&drag->destroy.link);
     drag->wlr_drag->data = NULL;
 
-    free(drag);
+    pool_free(&drag->seat->server->pools[POOL_DRAG], drag);
 }
 
 static void handle_start_drag(struct wl_listener *listener, void *data) {
     struct sycamore_seat *seat = wl_container_of(listener, seat, start_drag);
     struct wlr_drag *wlr_drag = data;
-    struct sycamore_drag *drag = calloc(1, sizeof(struct sycamore_drag));
+    struct sycamore_drag *drag = pool_alloc(&seat->server->pools[POOL_DRAG]);
     if (!drag) {
         wlr_log(WLR_ERROR, "Unable to allocate sycamore_drag");
         return;
@@ -76,7 +76,8 @@ static void handle_seat_device_destroy(struct wl_listener *listener, void *data)
 
 struct sycamore_seat_device *seat_device_create(struct sycamore_seat *seat, struct wlr_input_device *wlr_device,
         void *derived_device, void (*derived_destroy)(struct sycamore_seat_device *seat_device)) {
-    struct sycamore_seat_device *seat_device = calloc(1, sizeof(struct sycamore_seat_device));
+    struct sycamore_seat_device *seat_device =
+            pool_alloc(&seat->server->pools[POOL_SEAT_DEVICE]);
     if (!seat_device) {
         return NULL;
     }
@@ -104,7 +105,11 @@ void seat_device_destroy(struct sycamore_seat_device *seat_device) {
         seat_device->derived_destroy(seat_device);
     }
 
-    free(seat_device);
+    pool_free(&seat_device->seat->server->pools[POOL_SEAT_DEVICE], seat_device);
+}
+
+void seat_notify_activity(struct sycamore_seat *seat) {
+    idle_manager_notify_activity(seat->server->idle_manager, seat);
 }
 
 void seat_update_capabilities(struct sycamore_seat *seat) {
@@ -154,6 +159,23 @@ static void seat_configure_keyboard(struct sycamore_seat *seat,
     wl_list_insert(&seat->devices, &keyboard->base->link);
 }
 
+static void seat_configure_touchpad(struct sycamore_seat *seat,
+                                    struct wlr_input_device *device) {
+    const struct sycamore_config *config = seat->server->config;
+    touchpad_set_tap_to_click(device, config->touchpad.tap);
+    touchpad_set_natural_scroll(device, config->touchpad.natural_scroll);
+    touchpad_set_accel_speed(device, config->touchpad.accel_speed);
+}
+
+void seat_configure_touchpads(struct sycamore_seat *seat) {
+    struct sycamore_seat_device *device;
+    wl_list_for_each(device, &seat->devices, link) {
+        if (device->wlr_device->type == WLR_INPUT_DEVICE_POINTER) {
+            seat_configure_touchpad(seat, device->wlr_device);
+        }
+    }
+}
+
 static void seat_configure_pointer(struct sycamore_seat *seat,
                                    struct wlr_input_device *device) {
     wlr_log(WLR_DEBUG, "new pointer: %s", device->name);
@@ -168,9 +190,7 @@ static void seat_configure_pointer(struct sycamore_seat *seat,
     wlr_cursor_attach_input_device(seat->cursor->wlr_cursor, device);
     wl_list_insert(&seat->devices, &pointer->base->link);
 
-    touchpad_set_tap_to_click(device);
-    touchpad_set_natural_scroll(device);
-    touchpad_set_accel_speed(device, 0.3);
+    seat_configure_touchpad(seat, device);
 }
 
 static void seat_configure_touch(struct sycamore_seat *seat,
@@ -298,6 +318,10 @@ void sycamore_seat_destroy(struct sycamore_seat *seat) {
         sycamore_cursor_destroy(seat->cursor);
     }
 
+    if (seat->keymap) {
+        xkb_keymap_unref(seat->keymap);
+    }
+
     free(seat);
 }
 
@@ -0,0 +1,823 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/util/log.h>
+#include "sycamore/desktop/client.h"
+#include "sycamore/desktop/view.h"
+#include "sycamore/input/cursor.h"
+#include "sycamore/input/seat.h"
+#include "sycamore/output/output.h"
+#include "sycamore/output/virtual_output.h"
+#include "sycamore/ipc.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+static void copy_string(char *dst, size_t size, const char *src) {
+    snprintf(dst, size, "%s", src ? src : "");
+}
+
+static void fill_view(struct ipc_view *info, struct sycamore_view *view) {
+    struct sycamore_server *server = view->server;
+    struct sycamore_client *client =
+            client_from_surface(server->client_manager, view->wlr_surface);
+
+    struct wlr_box box;
+    view->interface->get_geometry(view, &box);
+
+    *info = (struct ipc_view){
+        .id = view->id,
+        .pid = client ? client->pid : 0,
+        .x = view->x,
+        .y = view->y,
+        .width = box.width,
+        .height = box.height,
+        .focused = server->focused_view.view == view,
+        .maximized = view->is_maximized,
+        .fullscreen = view->is_fullscreen,
+    };
+    copy_string(info->app_id, sizeof(info->app_id), view_get_app_id(view));
+    copy_string(info->title, sizeof(info->title), view_get_title(view));
+}
+
+static void fill_output(struct ipc_output *info, struct sycamore_output *output) {
+    struct wlr_output *wlr_output = output->wlr_output;
+    struct wlr_box box;
+    wlr_output_layout_get_box(output->server->output_layout, wlr_output, &box);
+
+    *info = (struct ipc_output){
+        .x = box.x,
+        .y = box.y,
+        .width = wlr_output->width,
+        .height = wlr_output->height,
+        .refresh = wlr_output->refresh,
+        .scale = wlr_output->scale,
+        .enabled = wlr_output->enabled,
+    };
+    copy_string(info->name, sizeof(info->name), wlr_output->name);
+}
+
+static void fill_seat(struct ipc_seat *info, struct sycamore_seat *seat) {
+    struct sycamore_view *focused = seat->server->focused_view.view;
+
+    *info = (struct ipc_seat){
+        .capabilities = seat->wlr_seat->capabilities,
+        .devices = wl_list_length(&seat->devices),
+        .cursor_x = seat->cursor->wlr_cursor->x,
+        .cursor_y = seat->cursor->wlr_cursor->y,
+        .focused_view = focused ? focused->id : 0,
+    };
+    copy_string(info->name, sizeof(info->name), seat->wlr_seat->name);
+}
+
+static void fill_stats(struct ipc_stats *info, struct sycamore_ipc *ipc) {
+    struct sycamore_server *server = ipc->server;
+
+    *info = (struct ipc_stats){
+        .views = wl_list_length(&server->mapped_views),
+        .outputs = wl_list_length(&server->all_outputs),
+        .clients = wl_list_length(&server->client_manager->clients),
+        .ipc_clients = wl_list_length(&ipc->clients),
+        .ipc_events_sent = ipc->events_sent,
+        .ipc_events_dropped = ipc->events_dropped,
+    };
+}
+
+static struct ipc_frame_stats_snapshot *frame_stats_snapshot(struct sycamore_ipc *ipc,
+        struct sycamore_output *output) {
+    struct ipc_frame_stats_snapshot *snapshot;
+    wl_list_for_each(snapshot, &ipc->frame_stats, link) {
+        if (snapshot->output == output) {
+            return snapshot;
+        }
+    }
+
+    /* New outputs count from when their counters started */
+    snapshot = calloc(1, sizeof(struct ipc_frame_stats_snapshot));
+    if (!snapshot) {
+        wlr_log(WLR_ERROR, "Unable to allocate ipc_frame_stats_snapshot");
+        return NULL;
+    }
+
+    snapshot->output = output;
+    snapshot->taken_nsec = output->render_cost.since_nsec;
+    wl_list_insert(&ipc->frame_stats, &snapshot->link);
+    return snapshot;
+}
+
+static void frame_stats_snapshot_take(struct ipc_frame_stats_snapshot *snapshot, uint64_t now) {
+    struct stats_render_cost *cost = &snapshot->output->render_cost;
+
+    snapshot->frames = cost->frames;
+    snapshot->rendered = cost->rendered;
+    snapshot->nsec = cost->nsec;
+    snapshot->taken_nsec = now;
+    cost->ipc_max_nsec = 0;
+}
+
+static void frame_stats_snapshot_destroy(struct ipc_frame_stats_snapshot *snapshot) {
+    wl_list_remove(&snapshot->link);
+    free(snapshot);
+}
+
+static void fill_frame_stats(struct ipc_frame_stats *info,
+        struct ipc_frame_stats_snapshot *snapshot, uint64_t now) {
+    const struct stats_render_cost *cost = &snapshot->output->render_cost;
+
+    /* A stats dump restarted the counters since, count from there */
+    struct ipc_frame_stats_snapshot base = *snapshot;
+    if (cost->since_nsec > snapshot->taken_nsec) {
+        base = (struct ipc_frame_stats_snapshot){ .taken_nsec = cost->since_nsec };
+    }
+
+    uint64_t frames = cost->frames - base.frames;
+    *info = (struct ipc_frame_stats){
+        .frames = frames,
+        .rendered = cost->rendered - base.rendered,
+        .avg_nsec = frames ? (cost->nsec - base.nsec) / frames : 0,
+        .max_nsec = cost->ipc_max_nsec,
+        .interval_nsec = now - base.taken_nsec,
+    };
+    copy_string(info->output, sizeof(info->output), snapshot->output->wlr_output->name);
+}
+
+static void json_printf(struct wl_array *json, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    /* One more for vsnprintf's NUL, which is dropped again */
+    char *dst = len >= 0 ? wl_array_add(json, len + 1) : NULL;
+    if (!dst) {
+        return;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(dst, len + 1, fmt, args);
+    va_end(args);
+    json->size--;
+}
+
+static void json_string(struct wl_array *json, const char *key, const char *str) {
+    json_printf(json, "\"%s\":\"", key);
+    for (const unsigned char *c = (const unsigned char *)str; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            json_printf(json, "\\%c", *c);
+        } else if (*c < 0x20) {
+            json_printf(json, "\\u%04x", *c);
+        } else {
+            json_printf(json, "%c", *c);
+        }
+    }
+    json_printf(json, "\"");
+}
+
+/* One struct of the given message type as a JSON object */
+static void json_append(struct wl_array *json, uint32_t type, const void *body) {
+    switch (type) {
+        case IPC_MSG_GET_VIEWS:
+        case IPC_EVENT_FOCUS:
+        case IPC_EVENT_MAP:
+        case IPC_EVENT_UNMAP: {
+            const struct ipc_view *view = body;
+            json_printf(json, "{\"id\":%u,\"pid\":%d,\"x\":%d,\"y\":%d,\"width\":%d,"
+                        "\"height\":%d,\"focused\":%s,\"maximized\":%s,\"fullscreen\":%s,",
+                        view->id, view->pid, view->x, view->y, view->width, view->height,
+                        view->focused ? "true" : "false", view->maximized ? "true" : "false",
+                        view->fullscreen ? "true" : "false");
+            json_string(json, "app_id", view->app_id);
+            json_printf(json, ",");
+            json_string(json, "title", view->title);
+            json_printf(json, "}");
+            break;
+        }
+        case IPC_MSG_GET_OUTPUTS:
+        case IPC_MSG_ADD_VIRTUAL_OUTPUT:
+        case IPC_MSG_REMOVE_VIRTUAL_OUTPUT:
+        case IPC_EVENT_OUTPUT_ADD:
+        case IPC_EVENT_OUTPUT_REMOVE: {
+            const struct ipc_output *output = body;
+            json_printf(json, "{");
+            json_string(json, "name", output->name);
+            json_printf(json, ",\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,\"refresh\":%d,"
+                        "\"scale\":%.3f,\"enabled\":%s}", output->x, output->y, output->width,
+                        output->height, output->refresh, output->scale,
+                        output->enabled ? "true" : "false");
+            break;
+        }
+        case IPC_MSG_GET_SEATS: {
+            const struct ipc_seat *seat = body;
+            json_printf(json, "{");
+            json_string(json, "name", seat->name);
+            json_printf(json, ",\"capabilities\":%u,\"devices\":%u,\"cursor_x\":%d,"
+                        "\"cursor_y\":%d,\"focused_view\":%u}", seat->capabilities,
+                        seat->devices, seat->cursor_x, seat->cursor_y, seat->focused_view);
+            break;
+        }
+        case IPC_MSG_GET_STATS: {
+            const struct ipc_stats *stats = body;
+            json_printf(json, "{\"views\":%u,\"outputs\":%u,\"clients\":%u,\"ipc_clients\":%u,"
+                        "\"ipc_events_sent\":%" PRIu64 ",\"ipc_events_dropped\":%" PRIu64 "}",
+                        stats->views, stats->outputs, stats->clients, stats->ipc_clients,
+                        stats->ipc_events_sent, stats->ipc_events_dropped);
+            break;
+        }
+        case IPC_EVENT_FRAME_STATS: {
+            const struct ipc_frame_stats *stats = body;
+            json_printf(json, "{");
+            json_string(json, "output", stats->output);
+            json_printf(json, ",\"frames\":%" PRIu64 ",\"rendered\":%" PRIu64 ",\"avg_nsec\":%"
+                        PRIu64 ",\"max_nsec\":%" PRIu64 ",\"interval_nsec\":%" PRIu64 "}",
+                        stats->frames, stats->rendered, stats->avg_nsec, stats->max_nsec,
+                        stats->interval_nsec);
+            break;
+        }
+        case IPC_MSG_SUBSCRIBE: {
+            const struct ipc_subscribe *subscribe = body;
+            json_printf(json, "{\"events\":%u}", subscribe->events);
+            break;
+        }
+        case IPC_MSG_SET_FORMAT: {
+            const struct ipc_set_format *format = body;
+            json_printf(json, "{\"format\":%u}", format->format);
+            break;
+        }
+        case IPC_EVENT_DROPPED: {
+            const struct ipc_dropped *dropped = body;
+            json_printf(json, "{\"events\":%u}", dropped->events);
+            break;
+        }
+        default:
+            json_printf(json, "null");
+            break;
+    }
+}
+
+/* The union of what clients subscribed to */
+static void ipc_update_events(struct sycamore_ipc *ipc) {
+    ipc->events = 0;
+    struct ipc_client *client;
+    wl_list_for_each(client, &ipc->clients, link) {
+        ipc->events |= client->events;
+    }
+}
+
+static void ipc_client_destroy(struct ipc_client *client) {
+    wl_list_remove(&client->link);
+    wl_event_source_remove(client->source);
+    close(client->fd);
+    wl_array_release(&client->in);
+    wl_array_release(&client->out);
+
+    ipc_update_events(client->ipc);
+    free(client);
+}
+
+static size_t ipc_client_queued(struct ipc_client *client) {
+    return client->out.size - client->out_offset;
+}
+
+static void ipc_client_flush(struct ipc_client *client) {
+    while (client->out_offset < client->out.size) {
+        ssize_t n = send(client->fd, (char *)client->out.data + client->out_offset,
+                         client->out.size - client->out_offset, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN) {
+                break;
+            }
+
+            wlr_log_errno(WLR_DEBUG, "IPC client gone");
+            ipc_client_destroy(client);
+            return;
+        }
+
+        client->out_offset += n;
+    }
+
+    if (client->out_offset == client->out.size) {
+        client->out.size = 0;
+        client->out_offset = 0;
+    } else if (client->out_offset > client->out.size / 2) {
+        client->out.size -= client->out_offset;
+        memmove(client->out.data, (char *)client->out.data + client->out_offset,
+                client->out.size);
+        client->out_offset = 0;
+    }
+
+    wl_event_source_fd_update(client->source, client->out.size ?
+            WL_EVENT_READABLE | WL_EVENT_WRITABLE : WL_EVENT_READABLE);
+}
+
+static bool ipc_client_queue(struct ipc_client *client, uint32_t type,
+        const void *body, size_t len) {
+    if (ipc_client_queued(client) + sizeof(struct ipc_msg_header) + len > IPC_MAX_QUEUED_BYTES) {
+        wlr_log(WLR_ERROR, "IPC client isn't reading its replies, disconnecting");
+        ipc_client_destroy(client);
+        return false;
+    }
+
+    struct ipc_msg_header header = {
+        .type = type,
+        .length = len,
+    };
+
+    char *dst = wl_array_add(&client->out, sizeof(header) + len);
+    if (!dst) {
+        wlr_log(WLR_ERROR, "Unable to queue IPC message");
+        return true;
+    }
+
+    memcpy(dst, &header, sizeof(header));
+    if (len) {
+        memcpy(dst + sizeof(header), body, len);
+    }
+
+    return true;
+}
+
+/* Queue an array of count structs of the given size, in the client's format */
+static bool ipc_client_reply(struct ipc_client *client, uint32_t type,
+        const void *items, size_t count, size_t size, bool array) {
+    if (client->format == IPC_FORMAT_BINARY) {
+        return ipc_client_queue(client, type, items, count * size);
+    }
+
+    struct wl_array json;
+    wl_array_init(&json);
+    if (array) {
+        json_printf(&json, "[");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            json_printf(&json, ",");
+        }
+        json_append(&json, type, (const char *)items + i * size);
+    }
+    if (array) {
+        json_printf(&json, "]");
+    }
+
+    bool ok = ipc_client_queue(client, type, json.data, json.size);
+    wl_array_release(&json);
+    return ok;
+}
+
+/* Events are dropped rather than queued past the limit, and the client is
+ * told how many before the next one it gets */
+static void ipc_client_send_event(struct ipc_client *client, uint32_t type,
+        const void *body, size_t size) {
+    struct sycamore_ipc *ipc = client->ipc;
+
+    size_t needed = 2 * sizeof(struct ipc_msg_header) + size + sizeof(struct ipc_dropped);
+    if (client->format == IPC_FORMAT_JSON) {
+        /* Escaping may blow strings up to six times their size */
+        needed += 6 * size + 256;
+    }
+
+    if (ipc_client_queued(client) + needed > IPC_MAX_QUEUED_EVENT_BYTES) {
+        client->dropped++;
+        ipc->events_dropped++;
+        return;
+    }
+
+    if (client->dropped) {
+        struct ipc_dropped dropped = {
+            .events = client->dropped,
+        };
+        client->dropped = 0;
+        if (!ipc_client_reply(client, IPC_EVENT_DROPPED, &dropped, 1, sizeof(dropped), false)) {
+            return;
+        }
+    }
+
+    if (ipc_client_reply(client, type, body, 1, size, false)) {
+        ipc->events_sent++;
+        ipc_client_flush(client);
+    }
+}
+
+static void ipc_broadcast(struct sycamore_ipc *ipc, uint32_t subscription, uint32_t type,
+        const void *body, size_t size) {
+    struct ipc_client *client, *next;
+    wl_list_for_each_safe(client, next, &ipc->clients, link) {
+        if (client->events & subscription) {
+            ipc_client_send_event(client, type, body, size);
+        }
+    }
+}
+
+void ipc_notify_view(struct sycamore_ipc *ipc, uint32_t type, struct sycamore_view *view) {
+    uint32_t subscription = type == IPC_EVENT_FOCUS ? IPC_SUBSCRIBE_FOCUS : IPC_SUBSCRIBE_VIEWS;
+    if (!ipc || !(ipc->events & subscription)) {
+        return;
+    }
+
+    struct ipc_view info;
+    fill_view(&info, view);
+    ipc_broadcast(ipc, subscription, type, &info, sizeof(info));
+}
+
+void ipc_notify_output(struct sycamore_ipc *ipc, uint32_t type, struct sycamore_output *output) {
+    if (!ipc) {
+        return;
+    }
+
+    if (type == IPC_EVENT_OUTPUT_REMOVE) {
+        struct ipc_frame_stats_snapshot *snapshot;
+        wl_list_for_each(snapshot, &ipc->frame_stats, link) {
+            if (snapshot->output == output) {
+                frame_stats_snapshot_destroy(snapshot);
+                break;
+            }
+        }
+    }
+
+    if (!(ipc->events & IPC_SUBSCRIBE_OUTPUTS)) {
+        return;
+    }
+
+    struct ipc_output info;
+    fill_output(&info, output);
+    ipc_broadcast(ipc, IPC_SUBSCRIBE_OUTPUTS, type, &info, sizeof(info));
+}
+
+static int handle_frame_stats_timer(void *data) {
+    struct sycamore_ipc *ipc = data;
+    if (!(ipc->events & IPC_SUBSCRIBE_FRAME_STATS)) {
+        return 0;
+    }
+
+    uint64_t now = get_current_time_nsec();
+    struct sycamore_output *output;
+    wl_list_for_each(output, &ipc->server->all_outputs, link) {
+        struct ipc_frame_stats_snapshot *snapshot = frame_stats_snapshot(ipc, output);
+        if (!snapshot) {
+            continue;
+        }
+
+        struct ipc_frame_stats info;
+        fill_frame_stats(&info, snapshot, now);
+        frame_stats_snapshot_take(snapshot, now);
+        ipc_broadcast(ipc, IPC_SUBSCRIBE_FRAME_STATS, IPC_EVENT_FRAME_STATS, &info, sizeof(info));
+    }
+
+    wl_event_source_timer_update(ipc->frame_stats_timer, IPC_FRAME_STATS_INTERVAL_MSEC);
+    return 0;
+}
+
+static bool ipc_client_reply_list(struct ipc_client *client, uint32_t type) {
+    struct sycamore_server *server = client->ipc->server;
+    struct wl_array items;
+    wl_array_init(&items);
+
+    size_t size = 0;
+    if (type == IPC_MSG_GET_VIEWS) {
+        size = sizeof(struct ipc_view);
+        struct sycamore_view *view;
+        wl_list_for_each(view, &server->mapped_views, link) {
+            struct ipc_view *info = wl_array_add(&items, size);
+            if (info) {
+                fill_view(info, view);
+            }
+        }
+    } else if (type == IPC_MSG_GET_OUTPUTS) {
+        size = sizeof(struct ipc_output);
+        struct sycamore_output *output;
+        wl_list_for_each(output, &server->all_outputs, link) {
+            struct ipc_output *info = wl_array_add(&items, size);
+            if (info) {
+                fill_output(info, output);
+            }
+        }
+    } else if (type == IPC_MSG_GET_SEATS) {
+        size = sizeof(struct ipc_seat);
+        struct ipc_seat *info = wl_array_add(&items, size);
+        if (info) {
+            fill_seat(info, server->seat);
+        }
+    }
+
+    bool ok = ipc_client_reply(client, type, items.data, size ? items.size / size : 0, size, true);
+    wl_array_release(&items);
+    return ok;
+}
+
+/* Return false if the client is gone */
+static bool ipc_client_handle_message(struct ipc_client *client,
+        const struct ipc_msg_header *header, const void *body) {
+    struct sycamore_ipc *ipc = client->ipc;
+
+    switch (header->type) {
+        case IPC_MSG_GET_VIEWS:
+        case IPC_MSG_GET_OUTPUTS:
+        case IPC_MSG_GET_SEATS:
+            return ipc_client_reply_list(client, header->type);
+        case IPC_MSG_GET_STATS: {
+            struct ipc_stats stats;
+            fill_stats(&stats, ipc);
+            return ipc_client_reply(client, header->type, &stats, 1, sizeof(stats), false);
+        }
+        case IPC_MSG_SUBSCRIBE: {
+            struct ipc_subscribe subscribe;
+            if (header->length < sizeof(subscribe)) {
+                break;
+            }
+            memcpy(&subscribe, body, sizeof(subscribe));
+
+            client->events = subscribe.events & IPC_SUBSCRIBE_ALL;
+            subscribe.events = client->events;
+
+            /* Only tick while someone listens */
+            bool ticking = ipc->events & IPC_SUBSCRIBE_FRAME_STATS;
+            ipc_update_events(ipc);
+            if (!ticking && (ipc->events & IPC_SUBSCRIBE_FRAME_STATS)) {
+                /* The first events cover the first interval, not all since the last tick */
+                uint64_t now = get_current_time_nsec();
+                struct sycamore_output *output;
+                wl_list_for_each(output, &ipc->server->all_outputs, link) {
+                    struct ipc_frame_stats_snapshot *snapshot = frame_stats_snapshot(ipc, output);
+                    if (snapshot) {
+                        frame_stats_snapshot_take(snapshot, now);
+                    }
+                }
+
+                wl_event_source_timer_update(ipc->frame_stats_timer,
+                                             IPC_FRAME_STATS_INTERVAL_MSEC);
+            }
+
+            return ipc_client_reply(client, header->type, &subscribe, 1,
+                                    sizeof(subscribe), false);
+        }
+        case IPC_MSG_ADD_VIRTUAL_OUTPUT: {
+            struct ipc_add_virtual_output add;
+            if (header->length < sizeof(add)) {
+                break;
+            }
+            memcpy(&add, body, sizeof(add));
+            add.spec[sizeof(add.spec) - 1] = '\0';
+
+            /* Events sent meanwhile may flush the client and find it gone. It
+             * learns about its output from the reply instead. */
+            struct virtual_output_spec spec;
+            struct sycamore_output *output = NULL;
+            if (virtual_output_parse_spec(add.spec, &spec)) {
+                uint32_t events = client->events;
+                client->events = 0;
+                output = virtual_output_create_from_spec(ipc->server, &spec);
+                client->events = events;
+            } else {
+                wlr_log(WLR_ERROR, "Invalid virtual output spec '%s' from IPC client", add.spec);
+            }
+
+            struct ipc_output info;
+            if (output) {
+                fill_output(&info, output);
+            }
+            return ipc_client_reply(client, header->type, &info, output ? 1 : 0,
+                                    sizeof(info), true);
+        }
+        case IPC_MSG_REMOVE_VIRTUAL_OUTPUT: {
+            struct ipc_remove_virtual_output remove_output;
+            if (header->length < sizeof(remove_output)) {
+                break;
+            }
+            memcpy(&remove_output, body, sizeof(remove_output));
+            remove_output.name[sizeof(remove_output.name) - 1] = '\0';
+
+            struct ipc_output info;
+            struct sycamore_output *output =
+                    virtual_output_from_name(ipc->server, remove_output.name);
+            if (output) {
+                /* Same as adding one, the reply tells the client */
+                fill_output(&info, output);
+                uint32_t events = client->events;
+                client->events = 0;
+                virtual_output_destroy(output);
+                client->events = events;
+            } else {
+                wlr_log(WLR_ERROR, "No virtual output '%s' to remove for IPC client",
+                        remove_output.name);
+            }
+
+            return ipc_client_reply(client, header->type, &info, output ? 1 : 0,
+                                    sizeof(info), true);
+        }
+        case IPC_MSG_SET_FORMAT: {
+            struct ipc_set_format format;
+            if (header->length < sizeof(format)) {
+                break;
+            }
+            memcpy(&format, body, sizeof(format));
+
+            if (format.format == IPC_FORMAT_BINARY || format.format == IPC_FORMAT_JSON) {
+                client->format = format.format;
+            }
+            format.format = client->format;
+            return ipc_client_reply(client, header->type, &format, 1, sizeof(format), false);
+        }
+        default:
+            break;
+    }
+
+    /* Unknown or short messages are skipped, not trusted */
+    return true;
+}
+
+static void ipc_client_read(struct ipc_client *client) {
+    char *dst = wl_array_add(&client->in, 4096);
+    if (!dst) {
+        ipc_client_destroy(client);
+        return;
+    }
+
+    ssize_t n = recv(client->fd, dst, 4096, 0);
+    client->in.size -= 4096 - (n > 0 ? n : 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        ipc_client_destroy(client);
+        return;
+    }
+
+    size_t offset = 0;
+    while (client->in.size - offset >= sizeof(struct ipc_msg_header)) {
+        struct ipc_msg_header header;
+        memcpy(&header, (char *)client->in.data + offset, sizeof(header));
+        if (header.length > IPC_MSG_MAX_LENGTH) {
+            wlr_log(WLR_ERROR, "IPC client sent an oversized message, disconnecting");
+            ipc_client_destroy(client);
+            return;
+        }
+
+        if (client->in.size - offset - sizeof(header) < header.length) {
+            break;
+        }
+
+        const char *body = (char *)client->in.data + offset + sizeof(header);
+        if (!ipc_client_handle_message(client, &header, body)) {
+            return;
+        }
+
+        offset += sizeof(header) + header.length;
+    }
+
+    client->in.size -= offset;
+    memmove(client->in.data, (char *)client->in.data + offset, client->in.size);
+
+    ipc_client_flush(client);
+}
+
+static int handle_ipc_client_fd(int fd, uint32_t mask, void *data) {
+    struct ipc_client *client = data;
+
+    if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+        ipc_client_destroy(client);
+        return 0;
+    }
+
+    if (mask & WL_EVENT_READABLE) {
+        ipc_client_read(client);
+    } else if (mask & WL_EVENT_WRITABLE) {
+        ipc_client_flush(client);
+    }
+
+    return 0;
+}
+
+static int handle_ipc_listen(int fd, uint32_t mask, void *data) {
+    struct sycamore_ipc *ipc = data;
+
+    int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to accept IPC client");
+        return 0;
+    }
+
+    struct ipc_client *client = calloc(1, sizeof(struct ipc_client));
+    if (!client) {
+        wlr_log(WLR_ERROR, "Unable to allocate ipc_client");
+        close(client_fd);
+        return 0;
+    }
+
+    client->source = wl_event_loop_add_fd(wl_display_get_event_loop(ipc->server->wl_display),
+            client_fd, WL_EVENT_READABLE, handle_ipc_client_fd, client);
+    if (!client->source) {
+        wlr_log(WLR_ERROR, "Unable to watch IPC client");
+        close(client_fd);
+        free(client);
+        return 0;
+    }
+
+    client->fd = client_fd;
+    client->ipc = ipc;
+    wl_array_init(&client->in);
+    wl_array_init(&client->out);
+    wl_list_insert(&ipc->clients, &client->link);
+
+    return 0;
+}
+
+static bool ipc_listen(struct sycamore_ipc *ipc) {
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+    if (strlen(ipc->socket_path) >= sizeof(addr.sun_path)) {
+        wlr_log(WLR_ERROR, "IPC socket path too long: %s", ipc->socket_path);
+        return false;
+    }
+    strcpy(addr.sun_path, ipc->socket_path);
+
+    ipc->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ipc->listen_fd < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to create IPC socket");
+        return false;
+    }
+
+    unlink(ipc->socket_path);
+    if (bind(ipc->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(ipc->listen_fd, 16) < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to listen on %s", ipc->socket_path);
+        return false;
+    }
+
+    ipc->listen_source = wl_event_loop_add_fd(
+            wl_display_get_event_loop(ipc->server->wl_display), ipc->listen_fd,
+            WL_EVENT_READABLE, handle_ipc_listen, ipc);
+    return ipc->listen_source != NULL;
+}
+
+void sycamore_ipc_destroy(struct sycamore_ipc *ipc) {
+    if (!ipc) {
+        return;
+    }
+
+    struct ipc_client *client, *next;
+    wl_list_for_each_safe(client, next, &ipc->clients, link) {
+        ipc_client_destroy(client);
+    }
+
+    if (ipc->frame_stats_timer) {
+        wl_event_source_remove(ipc->frame_stats_timer);
+    }
+
+    struct ipc_frame_stats_snapshot *snapshot, *next_snapshot;
+    wl_list_for_each_safe(snapshot, next_snapshot, &ipc->frame_stats, link) {
+        frame_stats_snapshot_destroy(snapshot);
+    }
+
+    if (ipc->listen_source) {
+        wl_event_source_remove(ipc->listen_source);
+    }
+
+    if (ipc->listen_fd >= 0) {
+        close(ipc->listen_fd);
+        unlink(ipc->socket_path);
+    }
+
+    free(ipc->socket_path);
+    free(ipc);
+}
+
+struct sycamore_ipc *sycamore_ipc_create(struct sycamore_server *server,
+        const char *socket_path) {
+    struct sycamore_ipc *ipc = calloc(1, sizeof(struct sycamore_ipc));
+    if (!ipc) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_ipc");
+        return NULL;
+    }
+
+    ipc->server = server;
+    ipc->listen_fd = -1;
+    wl_list_init(&ipc->clients);
+    wl_list_init(&ipc->frame_stats);
+
+    ipc->socket_path = strdup(socket_path);
+    if (!ipc->socket_path || !ipc_listen(ipc)) {
+        sycamore_ipc_destroy(ipc);
+        return NULL;
+    }
+
+    ipc->frame_stats_timer = wl_event_loop_add_timer(
+            wl_display_get_event_loop(server->wl_display), handle_frame_stats_timer, ipc);
+    if (!ipc->frame_stats_timer) {
+        wlr_log(WLR_ERROR, "Unable to add IPC frame stats timer");
+        sycamore_ipc_destroy(ipc);
+        return NULL;
+    }
+
+    setenv("SYCAMORE_SOCK", ipc->socket_path, true);
+    wlr_log(WLR_INFO, "IPC listening on %s", ipc->socket_path);
+
+    return ipc;
+}
@@ -1,35 +1,95 @@
+#include <stdbool.h>
 #include <stdlib.h>
 #include <getopt.h>
-#include <unistd.h>
 #include <wlr/util/log.h>
 #include "sycamore/server.h"
 
+static void print_usage(const char *name) {
+    printf("Usage: %s [-c config file] [-s startup command] [-m [output=]mode policy]... "
+           "[-S [output=]scale]... [-M output=source output]... [-i idle seconds]\n"
+           "Mode policies: preferred, max-refresh, max-resolution, WxH[@Hz]\n", name);
+}
+
 int main(int argc, char **argv) {
     wlr_log_init(WLR_DEBUG, NULL);
 
+    char *config_path = NULL;
     char *startup_cmd = NULL;
+    char **mode_rules = calloc(argc, sizeof(char *));
+    int mode_rules_len = 0;
+    char **scale_rules = calloc(argc, sizeof(char *));
+    int scale_rules_len = 0;
+    char **mirror_rules = calloc(argc, sizeof(char *));
+    int mirror_rules_len = 0;
+    uint32_t idle_timeout = 0;
     int c;
-    while ((c = getopt(argc, argv, "s:h")) != -1) {
+    while ((c = getopt(argc, argv, "c:s:m:S:M:i:h")) != -1) {
         switch (c) {
+            case 'c':
+                config_path = optarg;
+                break;
             case 's':
                 startup_cmd = optarg;
                 break;
+            case 'm':
+                mode_rules[mode_rules_len++] = optarg;
+                break;
+            case 'S':
+                scale_rules[scale_rules_len++] = optarg;
+                break;
+            case 'M':
+                mirror_rules[mirror_rules_len++] = optarg;
+                break;
+            case 'i':
+                idle_timeout = strtoul(optarg, NULL, 10);
+                break;
             default:
-                printf("Usage: %s [-s startup command]\n", argv[0]);
+                print_usage(argv[0]);
+                free(mode_rules);
+                free(scale_rules);
+                free(mirror_rules);
                 return EXIT_SUCCESS;
         }
     }
     if (optind < argc) {
-        printf("Usage: %s [-s startup command]\n", argv[0]);
+        print_usage(argv[0]);
+        free(mode_rules);
+        free(scale_rules);
+        free(mirror_rules);
         return EXIT_SUCCESS;
     }
 
-    struct sycamore_server *server = server_create();
+    struct sycamore_server *server = server_create(config_path);
     if (!server) {
+        free(mode_rules);
+        free(scale_rules);
+        free(mirror_rules);
         exit(EXIT_FAILURE);
     }
 
-    setenv("WAYLAND_DISPLAY", server->socket, true);
+    /* Rules must be in place before the backend announces its outputs.
+     * They win over those of the config file. */
+    bool rules_ok = true;
+    for (int i = 0; i < mode_rules_len && rules_ok; ++i) {
+        rules_ok = mode_policy_add_rule(server->mode_policy, mode_rules[i]);
+    }
+    for (int i = 0; i < scale_rules_len && rules_ok; ++i) {
+        rules_ok = mode_policy_add_scale_rule(server->mode_policy, scale_rules[i]);
+    }
+    for (int i = 0; i < mirror_rules_len && rules_ok; ++i) {
+        rules_ok = mirror_manager_add_rule(server->mirror_manager, mirror_rules[i]);
+    }
+    free(mode_rules);
+    free(scale_rules);
+    free(mirror_rules);
+
+    if (!rules_ok) {
+        print_usage(argv[0]);
+        server_destroy(server);
+        exit(EXIT_FAILURE);
+    }
+
+    idle_manager_set_timeout(server->idle_manager, idle_timeout * 1000);
 
     if (!server_start(server)) {
         server_destroy(server);
@@ -37,9 +97,7 @@ int main(int argc, char **argv) {
     }
 
     if (startup_cmd) {
-        if (fork() == 0) {
-            execl("/bin/sh", "/bin/sh", "-c", startup_cmd, (void *)NULL);
-        }
+        launcher_spawn(server->launcher, startup_cmd);
     }
 
     server_run(server);
@@ -0,0 +1,522 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wlr/render/dmabuf.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_damage_ring.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include <wlr/util/region.h>
+#include "sycamore/output/capture.h"
+#include "sycamore/output/output.h"
+#include "sycamore/server.h"
+
+static bool session_send(struct capture_session *session, const void *msg, size_t len,
+        const int *fds, size_t fds_len) {
+    struct iovec iov = {
+        .iov_base = (void *)msg,
+        .iov_len = len,
+    };
+    char control[CMSG_SPACE(sizeof(int) * CAPTURE_MAX_PLANES)] = {0};
+    struct msghdr header = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+
+    if (fds_len) {
+        header.msg_control = control;
+        header.msg_controllen = CMSG_SPACE(sizeof(int) * fds_len);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds_len);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fds_len);
+    }
+
+    /* Frames are throttled by releases, so the socket only fills up
+     * if the client stopped reading altogether */
+    ssize_t n;
+    do {
+        n = sendmsg(session->fd, &header, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to write to capture client");
+        return false;
+    }
+
+    return true;
+}
+
+static void known_buffer_forget(struct capture_known_buffer *known) {
+    if (!known->buffer) {
+        return;
+    }
+
+    wl_list_remove(&known->destroy.link);
+    known->buffer = NULL;
+
+    struct capture_buffer_gone msg = {
+        .type = CAPTURE_MSG_BUFFER_GONE,
+        .id = known->id,
+    };
+    session_send(known->session, &msg, sizeof(msg), NULL, 0);
+}
+
+static void handle_known_buffer_destroy(struct wl_listener *listener, void *data) {
+    struct capture_known_buffer *known = wl_container_of(listener, known, destroy);
+
+    known_buffer_forget(known);
+}
+
+static bool session_holds(struct capture_session *session, struct wlr_buffer *buffer) {
+    for (int i = 0; i < CAPTURE_MAX_FRAMES_HELD; ++i) {
+        if (session->held[i].buffer == buffer) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Whether the buffer may be held for the session without its output running
+ * short of buffers to render to. All sessions of an output count. */
+static bool output_can_hold(struct capture_session *session, struct wlr_buffer *buffer) {
+    struct capture_session *other;
+    wl_list_for_each(other, &session->manager->sessions, link) {
+        if (other->output == session->output && session_holds(other, buffer)) {
+            return true;
+        }
+    }
+
+    struct wlr_buffer *held[CAPTURE_MAX_OUTPUT_BUFFERS_HELD];
+    size_t held_len = 0;
+    wl_list_for_each(other, &session->manager->sessions, link) {
+        if (other->output != session->output) {
+            continue;
+        }
+
+        for (int i = 0; i < CAPTURE_MAX_FRAMES_HELD; ++i) {
+            struct wlr_buffer *other_buffer = other->held[i].buffer;
+            size_t j = 0;
+            while (j < held_len && held[j] != other_buffer) {
+                ++j;
+            }
+            if (!other_buffer || j < held_len) {
+                continue;
+            } else if (held_len == CAPTURE_MAX_OUTPUT_BUFFERS_HELD) {
+                return false;
+            }
+            held[held_len++] = other_buffer;
+        }
+    }
+
+    return held_len < CAPTURE_MAX_OUTPUT_BUFFERS_HELD;
+}
+
+/* Tell the client about a buffer, with its fds, unless it already knows it */
+static struct capture_known_buffer *session_know_buffer(struct capture_session *session,
+        struct wlr_buffer *buffer) {
+    for (int i = 0; i < CAPTURE_BUFFER_CACHE_SIZE; ++i) {
+        if (session->known[i].buffer == buffer) {
+            return &session->known[i];
+        }
+    }
+
+    struct capture_buffer msg = {
+        .type = CAPTURE_MSG_BUFFER,
+        .id = ++session->next_buffer_id,
+        .width = buffer->width,
+        .height = buffer->height,
+    };
+    int fds[CAPTURE_MAX_PLANES];
+
+    struct wlr_dmabuf_attributes dmabuf;
+    struct wlr_shm_attributes shm;
+    if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+        msg.buffer_type = CAPTURE_BUFFER_DMABUF;
+        msg.format = dmabuf.format;
+        msg.modifier = dmabuf.modifier;
+        msg.planes = dmabuf.n_planes;
+        for (int i = 0; i < dmabuf.n_planes; ++i) {
+            msg.offset[i] = dmabuf.offset[i];
+            msg.stride[i] = dmabuf.stride[i];
+            fds[i] = dmabuf.fd[i];
+        }
+    } else if (wlr_buffer_get_shm(buffer, &shm)) {
+        msg.buffer_type = CAPTURE_BUFFER_SHM;
+        msg.format = shm.format;
+        msg.planes = 1;
+        msg.offset[0] = shm.offset;
+        msg.stride[0] = shm.stride;
+        fds[0] = shm.fd;
+    } else {
+        wlr_log(WLR_ERROR, "Output buffers can't be shared with capture clients");
+        return NULL;
+    }
+
+    /* Evict the next buffer the client doesn't hold, there are always some */
+    struct capture_known_buffer *known;
+    do {
+        known = &session->known[session->known_next];
+        session->known_next = (session->known_next + 1) % CAPTURE_BUFFER_CACHE_SIZE;
+    } while (known->buffer && session_holds(session, known->buffer));
+    known_buffer_forget(known);
+
+    if (!session_send(session, &msg, sizeof(msg), fds, msg.planes)) {
+        return NULL;
+    }
+
+    known->buffer = buffer;
+    known->id = msg.id;
+    known->session = session;
+    known->destroy.notify = handle_known_buffer_destroy;
+    wl_signal_add(&buffer->events.destroy, &known->destroy);
+
+    return known;
+}
+
+static void capture_session_destroy(struct capture_session *session) {
+    wlr_log(WLR_INFO, "Capture client gone: %" PRIu64 " frames, %" PRIu64
+            " output frames skipped while it was behind", session->frames, session->skipped);
+
+    wl_event_source_remove(session->source);
+    close(session->fd);
+
+    for (int i = 0; i < CAPTURE_BUFFER_CACHE_SIZE; ++i) {
+        if (session->known[i].buffer) {
+            wl_list_remove(&session->known[i].destroy.link);
+        }
+    }
+
+    for (int i = 0; i < CAPTURE_MAX_FRAMES_HELD; ++i) {
+        if (session->held[i].buffer) {
+            wlr_buffer_unlock(session->held[i].buffer);
+        }
+    }
+
+    if (session->latest) {
+        wlr_buffer_unlock(session->latest);
+    }
+
+    wl_list_remove(&session->output_commit.link);
+    wl_list_remove(&session->output_destroy.link);
+    wl_list_remove(&session->link);
+    pixman_region32_fini(&session->pending);
+
+    free(session);
+}
+
+static void capture_session_send_frame(struct capture_session *session) {
+    if (!session->latest || !pixman_region32_not_empty(&session->pending)) {
+        return;
+    }
+
+    struct capture_held_frame *held = NULL;
+    for (int i = 0; i < CAPTURE_MAX_FRAMES_HELD && !held; ++i) {
+        if (!session->held[i].buffer) {
+            held = &session->held[i];
+        }
+    }
+    if (!held || !output_can_hold(session, session->latest)) {
+        /* The damage stays pending and goes with the next frame sent */
+        session->skipped++;
+        return;
+    }
+
+    struct capture_known_buffer *known = session_know_buffer(session, session->latest);
+    if (!known) {
+        capture_session_destroy(session);
+        return;
+    }
+
+    struct capture_frame frame = {
+        .type = CAPTURE_MSG_FRAME,
+        .seq = ++session->seq,
+        .buffer_id = known->id,
+        .tv_sec = session->latest_when.tv_sec,
+        .tv_nsec = session->latest_when.tv_nsec,
+    };
+
+    pixman_region32_intersect_rect(&session->pending, &session->pending, 0, 0,
+                                   session->latest->width, session->latest->height);
+    int rects_len;
+    pixman_box32_t *rects = pixman_region32_rectangles(&session->pending, &rects_len);
+    if (rects_len > CAPTURE_MAX_DAMAGE_RECTS) {
+        rects = pixman_region32_extents(&session->pending);
+        rects_len = 1;
+    }
+    for (int i = 0; i < rects_len; ++i) {
+        frame.damage[i] = (struct capture_rect){
+            .x = rects[i].x1,
+            .y = rects[i].y1,
+            .width = rects[i].x2 - rects[i].x1,
+            .height = rects[i].y2 - rects[i].y1,
+        };
+    }
+    frame.rects = rects_len;
+
+    /* Unused damage rects aren't sent */
+    size_t len = sizeof(frame) - sizeof(frame.damage) + sizeof(struct capture_rect) * rects_len;
+    if (!session_send(session, &frame, len, NULL, 0)) {
+        capture_session_destroy(session);
+        return;
+    }
+
+    held->seq = frame.seq;
+    held->buffer = wlr_buffer_lock(session->latest);
+    pixman_region32_clear(&session->pending);
+    session->frames++;
+}
+
+static void handle_session_output_commit(struct wl_listener *listener, void *data) {
+    struct capture_session *session = wl_container_of(listener, session, output_commit);
+    struct wlr_output_event_commit *event = data;
+
+    if (!(event->committed & WLR_OUTPUT_STATE_BUFFER) || !event->buffer) {
+        return;
+    }
+
+    if (session->latest) {
+        wlr_buffer_unlock(session->latest);
+    }
+    session->latest = wlr_buffer_lock(event->buffer);
+    session->latest_when = *event->when;
+
+    capture_session_send_frame(session);
+}
+
+static void handle_session_output_destroy(struct wl_listener *listener, void *data) {
+    struct capture_session *session = wl_container_of(listener, session, output_destroy);
+
+    capture_session_destroy(session);
+}
+
+static bool capture_session_bind(struct capture_session *session, const struct capture_bind *bind) {
+    if (session->output) {
+        return false;
+    }
+
+    struct sycamore_output *output;
+    wl_list_for_each(output, &session->manager->server->all_outputs, link) {
+        struct wlr_output *wlr_output = output->wlr_output;
+        if (strncmp(wlr_output->name, bind->output, sizeof(bind->output)) != 0) {
+            continue;
+        }
+
+        session->output = output;
+        session->output_commit.notify = handle_session_output_commit;
+        wl_signal_add(&wlr_output->events.commit, &session->output_commit);
+        session->output_destroy.notify = handle_session_output_destroy;
+        wl_signal_add(&wlr_output->events.destroy, &session->output_destroy);
+
+        /* The first frame is all damage, render it now rather than on the next change */
+        pixman_region32_union_rect(&session->pending, &session->pending,
+                                   0, 0, wlr_output->width, wlr_output->height);
+        struct wlr_scene_output *scene_output =
+                wlr_scene_get_scene_output(output->scene, wlr_output);
+        if (scene_output) {
+            wlr_damage_ring_add_whole(&scene_output->damage_ring);
+        }
+        wlr_output_schedule_frame(wlr_output);
+
+        wlr_log(WLR_INFO, "Capture client bound to %s", wlr_output->name);
+        return true;
+    }
+
+    wlr_log(WLR_ERROR, "Capture client asked for unknown output '%.*s'",
+            (int)sizeof(bind->output), bind->output);
+    return false;
+}
+
+static void capture_session_release(struct capture_session *session,
+        const struct capture_release *release) {
+    for (int i = 0; i < CAPTURE_MAX_FRAMES_HELD; ++i) {
+        struct capture_held_frame *held = &session->held[i];
+        if (held->buffer && held->seq == release->seq) {
+            wlr_buffer_unlock(held->buffer);
+            held->buffer = NULL;
+            break;
+        }
+    }
+
+    /* Damage that piled up meanwhile goes out right away, also to the other
+     * sessions of the output that were held back by this one */
+    struct sycamore_output *output = session->output;
+    struct capture_session *other, *next;
+    wl_list_for_each_safe(other, next, &session->manager->sessions, link) {
+        if (other->output == output) {
+            capture_session_send_frame(other);
+        }
+    }
+}
+
+static int handle_session_fd(int fd, uint32_t mask, void *data) {
+    struct capture_session *session = data;
+
+    if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+        capture_session_destroy(session);
+        return 0;
+    }
+
+    union {
+        uint32_t type;
+        struct capture_bind bind;
+        struct capture_release release;
+    } msg;
+    ssize_t n = recv(fd, &msg, sizeof(msg), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return 0;
+    } else if (n < (ssize_t)sizeof(msg.type)) {
+        capture_session_destroy(session);
+        return 0;
+    }
+
+    if (msg.type == CAPTURE_MSG_BIND && n >= (ssize_t)sizeof(msg.bind)) {
+        if (!capture_session_bind(session, &msg.bind)) {
+            capture_session_destroy(session);
+        }
+    } else if (msg.type == CAPTURE_MSG_RELEASE && n >= (ssize_t)sizeof(msg.release)) {
+        capture_session_release(session, &msg.release);
+    } else {
+        wlr_log(WLR_DEBUG, "Ignoring capture message type %u", msg.type);
+    }
+
+    return 0;
+}
+
+static int handle_capture_listen(int fd, uint32_t mask, void *data) {
+    struct sycamore_capture_manager *manager = data;
+
+    int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to accept capture client");
+        return 0;
+    }
+
+    struct capture_session *session = calloc(1, sizeof(struct capture_session));
+    if (!session) {
+        wlr_log(WLR_ERROR, "Unable to allocate capture_session");
+        close(client_fd);
+        return 0;
+    }
+
+    session->source = wl_event_loop_add_fd(wl_display_get_event_loop(manager->server->wl_display),
+            client_fd, WL_EVENT_READABLE, handle_session_fd, session);
+    if (!session->source) {
+        wlr_log(WLR_ERROR, "Unable to watch capture client");
+        close(client_fd);
+        free(session);
+        return 0;
+    }
+
+    session->fd = client_fd;
+    session->manager = manager;
+    pixman_region32_init(&session->pending);
+    wl_list_init(&session->output_commit.link);
+    wl_list_init(&session->output_destroy.link);
+    wl_list_insert(&manager->sessions, &session->link);
+
+    return 0;
+}
+
+void capture_manager_record_damage(struct sycamore_capture_manager *manager,
+        struct sycamore_output *output, struct wlr_scene_output *scene_output) {
+    struct wlr_output *wlr_output = output->wlr_output;
+
+    /* The damage ring is in transformed coordinates, the protocol promises
+     * buffer ones: undo the output transform like wlr_scene_output_commit() */
+    int width, height;
+    wlr_output_transformed_resolution(wlr_output, &width, &height);
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    wlr_region_transform(&damage, &scene_output->damage_ring.current,
+                         wlr_output_transform_invert(wlr_output->transform), width, height);
+
+    struct capture_session *session;
+    wl_list_for_each(session, &manager->sessions, link) {
+        if (session->output == output) {
+            pixman_region32_union(&session->pending, &session->pending, &damage);
+        }
+    }
+
+    pixman_region32_fini(&damage);
+}
+
+void sycamore_capture_manager_destroy(struct sycamore_capture_manager *manager) {
+    if (!manager) {
+        return;
+    }
+
+    struct capture_session *session, *next;
+    wl_list_for_each_safe(session, next, &manager->sessions, link) {
+        capture_session_destroy(session);
+    }
+
+    if (manager->listen_source) {
+        wl_event_source_remove(manager->listen_source);
+    }
+
+    if (manager->listen_fd >= 0) {
+        close(manager->listen_fd);
+        unlink(manager->socket_path);
+    }
+
+    free(manager->socket_path);
+    free(manager);
+}
+
+struct sycamore_capture_manager *sycamore_capture_manager_create(
+        struct sycamore_server *server, const char *socket_path) {
+    struct sycamore_capture_manager *manager =
+            calloc(1, sizeof(struct sycamore_capture_manager));
+    if (!manager) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_capture_manager");
+        return NULL;
+    }
+
+    manager->server = server;
+    manager->listen_fd = -1;
+    wl_list_init(&manager->sessions);
+
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        wlr_log(WLR_ERROR, "Capture socket path too long: %s", socket_path);
+        sycamore_capture_manager_destroy(manager);
+        return NULL;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    manager->socket_path = strdup(socket_path);
+    manager->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (!manager->socket_path || manager->listen_fd < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to create capture socket");
+        sycamore_capture_manager_destroy(manager);
+        return NULL;
+    }
+
+    unlink(socket_path);
+    if (bind(manager->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(manager->listen_fd, 4) < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to listen on %s", socket_path);
+        sycamore_capture_manager_destroy(manager);
+        return NULL;
+    }
+
+    manager->listen_source = wl_event_loop_add_fd(wl_display_get_event_loop(server->wl_display),
+            manager->listen_fd, WL_EVENT_READABLE, handle_capture_listen, manager);
+    if (!manager->listen_source) {
+        wlr_log(WLR_ERROR, "Unable to watch capture socket");
+        sycamore_capture_manager_destroy(manager);
+        return NULL;
+    }
+
+    wlr_log(WLR_INFO, "Capture socket listening on %s", socket_path);
+    return manager;
+}
@@ -0,0 +1,388 @@
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_matrix.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include <wlr/util/region.h>
+#include "sycamore/output/mirror.h"
+#include "sycamore/output/output.h"
+#include "sycamore/server.h"
+
+static void mirror_texture_reset(struct mirror_texture *entry) {
+    if (!entry->buffer) {
+        return;
+    }
+
+    wl_list_remove(&entry->buffer_destroy.link);
+    wlr_texture_destroy(entry->texture);
+    entry->buffer = NULL;
+    entry->texture = NULL;
+}
+
+static void handle_texture_buffer_destroy(struct wl_listener *listener, void *data) {
+    struct mirror_texture *entry = wl_container_of(listener, entry, buffer_destroy);
+
+    mirror_texture_reset(entry);
+}
+
+/* The source renders into a small swapchain, so its buffers are imported
+ * once and their textures reused frame after frame */
+static struct wlr_texture *mirror_get_texture(struct sycamore_mirror *mirror,
+        struct wlr_buffer *buffer) {
+    for (size_t i = 0; i < MIRROR_TEXTURE_CACHE_SIZE; ++i) {
+        if (mirror->textures[i].buffer == buffer) {
+            return mirror->textures[i].texture;
+        }
+    }
+
+    struct wlr_texture *texture = wlr_texture_from_buffer(
+            mirror->dst->wlr_output->renderer, buffer);
+    if (!texture) {
+        wlr_log(WLR_ERROR, "Unable to import the buffer of %s",
+                mirror->src->wlr_output->name);
+        return NULL;
+    }
+
+    struct mirror_texture *entry = &mirror->textures[mirror->textures_next];
+    mirror->textures_next = (mirror->textures_next + 1) % MIRROR_TEXTURE_CACHE_SIZE;
+    mirror_texture_reset(entry);
+
+    entry->buffer = buffer;
+    entry->texture = texture;
+    entry->buffer_destroy.notify = handle_texture_buffer_destroy;
+    wl_signal_add(&buffer->events.destroy, &entry->buffer_destroy);
+
+    return texture;
+}
+
+/* Where the source lands on dst: scaled to fit, keeping its aspect ratio,
+ * and centered. Coordinates are in dst's transformed space. */
+static double mirror_get_box(struct sycamore_mirror *mirror, struct wlr_box *box) {
+    int src_width, src_height, dst_width, dst_height;
+    wlr_output_transformed_resolution(mirror->src->wlr_output, &src_width, &src_height);
+    wlr_output_transformed_resolution(mirror->dst->wlr_output, &dst_width, &dst_height);
+    if (src_width <= 0 || src_height <= 0) {
+        *box = (struct wlr_box){0};
+        return 0.0;
+    }
+
+    double scale_x = (double)dst_width / src_width;
+    double scale_y = (double)dst_height / src_height;
+    double scale = scale_x < scale_y ? scale_x : scale_y;
+    box->width = src_width * scale + 0.5;
+    box->height = src_height * scale + 0.5;
+    box->x = (dst_width - box->width) / 2;
+    box->y = (dst_height - box->height) / 2;
+
+    return scale;
+}
+
+bool mirror_render(struct sycamore_mirror *mirror) {
+    struct wlr_output *output = mirror->dst->wlr_output;
+    struct wlr_output *src = mirror->src->wlr_output;
+    if (!mirror->src_buffer || !output->enabled) {
+        return false;
+    }
+
+    int width, height;
+    wlr_output_transformed_resolution(output, &width, &height);
+    if (mirror->damage_ring.width != width || mirror->damage_ring.height != height) {
+        wlr_damage_ring_set_bounds(&mirror->damage_ring, width, height);
+        wlr_damage_ring_add_whole(&mirror->damage_ring);
+    }
+
+    int buffer_age;
+    if (!wlr_output_attach_render(output, &buffer_age)) {
+        return false;
+    }
+
+    pixman_region32_t damage;
+    pixman_region32_init(&damage);
+    wlr_damage_ring_get_buffer_damage(&mirror->damage_ring, buffer_age, &damage);
+    if (!pixman_region32_not_empty(&damage)) {
+        pixman_region32_fini(&damage);
+        wlr_output_rollback(output);
+        return false;
+    }
+
+    struct wlr_texture *texture = mirror_get_texture(mirror, mirror->src_buffer);
+    if (!texture) {
+        pixman_region32_fini(&damage);
+        wlr_output_rollback(output);
+        return false;
+    }
+
+    struct wlr_box box;
+    mirror_get_box(mirror, &box);
+    float matrix[9];
+    wlr_matrix_project_box(matrix, &box, wlr_output_transform_invert(src->transform),
+                           0, output->transform_matrix);
+
+    /* One textured quad per damaged rect: the scene is never walked for dst */
+    struct wlr_renderer *renderer = output->renderer;
+    enum wl_output_transform transform = wlr_output_transform_invert(output->transform);
+    wlr_renderer_begin(renderer, output->width, output->height);
+
+    int rects_len;
+    const pixman_box32_t *rects = pixman_region32_rectangles(&damage, &rects_len);
+    for (int i = 0; i < rects_len; ++i) {
+        struct wlr_box scissor = {
+            .x = rects[i].x1,
+            .y = rects[i].y1,
+            .width = rects[i].x2 - rects[i].x1,
+            .height = rects[i].y2 - rects[i].y1,
+        };
+        wlr_box_transform(&scissor, &scissor, transform, width, height);
+        wlr_renderer_scissor(renderer, &scissor);
+        wlr_renderer_clear(renderer, (float[4]){0.0f, 0.0f, 0.0f, 1.0f});
+        wlr_render_texture_with_matrix(renderer, texture, matrix, 1.0f);
+    }
+
+    wlr_renderer_scissor(renderer, NULL);
+    wlr_renderer_end(renderer);
+
+    pixman_region32_t frame_damage;
+    pixman_region32_init(&frame_damage);
+    wlr_region_transform(&frame_damage, &mirror->damage_ring.current,
+                         transform, width, height);
+    wlr_output_set_damage(output, &frame_damage);
+    pixman_region32_fini(&frame_damage);
+    pixman_region32_fini(&damage);
+
+    if (!wlr_output_commit(output)) {
+        return false;
+    }
+
+    wlr_damage_ring_rotate(&mirror->damage_ring);
+    return true;
+}
+
+static void handle_src_commit(struct wl_listener *listener, void *data) {
+    struct sycamore_mirror *mirror = wl_container_of(listener, mirror, src_commit);
+    struct wlr_output_event_commit *event = data;
+
+    if (event->committed & (WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_TRANSFORM |
+                            WLR_OUTPUT_STATE_SCALE)) {
+        wlr_damage_ring_add_whole(&mirror->damage_ring);
+    }
+
+    if (!(event->committed & WLR_OUTPUT_STATE_BUFFER) || !event->buffer) {
+        return;
+    }
+
+    /* Keep the buffer readable until the next one replaces it */
+    if (mirror->src_buffer) {
+        wlr_buffer_unlock(mirror->src_buffer);
+    }
+    mirror->src_buffer = wlr_buffer_lock(event->buffer);
+
+    wlr_output_schedule_frame(mirror->dst->wlr_output);
+}
+
+void mirror_manager_record_damage(struct sycamore_mirror_manager *manager,
+        struct sycamore_output *output, struct wlr_scene_output *scene_output) {
+    struct sycamore_mirror *mirror;
+    wl_list_for_each(mirror, &manager->mirrors, link) {
+        if (mirror->src != output) {
+            continue;
+        }
+
+        struct wlr_box box;
+        double scale = mirror_get_box(mirror, &box);
+
+        /* Scaling blends neighbouring pixels, so damage bleeds by one */
+        pixman_region32_t damage;
+        pixman_region32_init(&damage);
+        wlr_region_scale(&damage, &scene_output->damage_ring.current, scale);
+        pixman_region32_translate(&damage, box.x, box.y);
+        wlr_region_expand(&damage, &damage, 1);
+        pixman_region32_intersect_rect(&damage, &damage,
+                                       box.x, box.y, box.width, box.height);
+        wlr_damage_ring_add(&mirror->damage_ring, &damage);
+        pixman_region32_fini(&damage);
+    }
+}
+
+struct sycamore_mirror *mirror_create(struct sycamore_mirror_manager *manager,
+        struct sycamore_output *src, struct sycamore_output *dst) {
+    if (src == dst || dst->mirror || src->mirror) {
+        wlr_log(WLR_ERROR, "Unable to mirror %s onto %s",
+                src->wlr_output->name, dst->wlr_output->name);
+        return NULL;
+    }
+
+    /* No chains: an output others mirror keeps rendering the scene */
+    struct sycamore_mirror *iter;
+    wl_list_for_each(iter, &manager->mirrors, link) {
+        if (iter->src == dst) {
+            wlr_log(WLR_ERROR, "Output %s is mirrored already", dst->wlr_output->name);
+            return NULL;
+        }
+    }
+
+    struct sycamore_mirror *mirror = calloc(1, sizeof(struct sycamore_mirror));
+    if (!mirror) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_mirror");
+        return NULL;
+    }
+
+    mirror->src = src;
+    mirror->dst = dst;
+    mirror->manager = manager;
+    wlr_damage_ring_init(&mirror->damage_ring);
+
+    mirror->src_commit.notify = handle_src_commit;
+    wl_signal_add(&src->wlr_output->events.commit, &mirror->src_commit);
+
+    wl_list_insert(&manager->mirrors, &mirror->link);
+    dst->mirror = mirror;
+
+    /* A hardware cursor never makes it into the buffers dst shows */
+    wlr_output_lock_software_cursors(src->wlr_output, true);
+
+    /* Views can't be placed on dst anymore, and the scene drops its
+     * scene output along with it */
+    wlr_output_layout_remove(manager->server->output_layout, dst->wlr_output);
+
+    /* Have src render a full frame for dst to start from */
+    struct wlr_scene_output *scene_output =
+            wlr_scene_get_scene_output(src->scene, src->wlr_output);
+    if (scene_output) {
+        wlr_damage_ring_add_whole(&scene_output->damage_ring);
+    }
+    wlr_output_schedule_frame(src->wlr_output);
+
+    wlr_log(WLR_INFO, "Mirroring %s onto %s", src->wlr_output->name, dst->wlr_output->name);
+    return mirror;
+}
+
+static void mirror_destroy_full(struct sycamore_mirror *mirror, bool restore) {
+    wl_list_remove(&mirror->link);
+    wl_list_remove(&mirror->src_commit.link);
+    wlr_output_lock_software_cursors(mirror->src->wlr_output, false);
+
+    for (size_t i = 0; i < MIRROR_TEXTURE_CACHE_SIZE; ++i) {
+        mirror_texture_reset(&mirror->textures[i]);
+    }
+    if (mirror->src_buffer) {
+        wlr_buffer_unlock(mirror->src_buffer);
+    }
+    wlr_damage_ring_finish(&mirror->damage_ring);
+
+    struct sycamore_output *dst = mirror->dst;
+    dst->mirror = NULL;
+    if (restore) {
+        wlr_output_layout_add_auto(mirror->manager->server->output_layout, dst->wlr_output);
+        wlr_output_schedule_frame(dst->wlr_output);
+    }
+
+    free(mirror);
+}
+
+void mirror_destroy(struct sycamore_mirror *mirror) {
+    if (!mirror) {
+        return;
+    }
+
+    mirror_destroy_full(mirror, true);
+}
+
+void mirror_manager_handle_output_destroy(struct sycamore_mirror_manager *manager,
+        struct sycamore_output *output) {
+    struct sycamore_mirror *mirror, *next;
+    wl_list_for_each_safe(mirror, next, &manager->mirrors, link) {
+        if (mirror->src == output || mirror->dst == output) {
+            /* A dst that outlives its source goes back to the layout */
+            mirror_destroy_full(mirror, mirror->dst != output);
+        }
+    }
+}
+
+static struct sycamore_output *find_output(struct sycamore_server *server, const char *name) {
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        if (strcmp(output->wlr_output->name, name) == 0) {
+            return output;
+        }
+    }
+
+    return NULL;
+}
+
+void mirror_manager_apply_rules(struct sycamore_mirror_manager *manager) {
+    struct mirror_rule *rule;
+    wl_list_for_each(rule, &manager->rules, link) {
+        struct sycamore_output *dst = find_output(manager->server, rule->dst);
+        struct sycamore_output *src = find_output(manager->server, rule->src);
+        if (dst && src && !dst->mirror) {
+            mirror_create(manager, src, dst);
+        }
+    }
+}
+
+bool mirror_manager_add_rule(struct sycamore_mirror_manager *manager, const char *str) {
+    const char *separator = strchr(str, '=');
+    if (!separator || separator == str || separator[1] == '\0') {
+        wlr_log(WLR_ERROR, "Invalid mirror rule '%s', expected dst=src", str);
+        return false;
+    }
+
+    struct mirror_rule *rule = calloc(1, sizeof(struct mirror_rule));
+    if (!rule) {
+        wlr_log(WLR_ERROR, "Unable to allocate mirror_rule");
+        return false;
+    }
+
+    rule->dst = strndup(str, separator - str);
+    rule->src = strdup(separator + 1);
+    if (!rule->dst || !rule->src) {
+        wlr_log(WLR_ERROR, "Unable to allocate mirror_rule");
+        free(rule->dst);
+        free(rule->src);
+        free(rule);
+        return false;
+    }
+
+    wl_list_insert(manager->rules.prev, &rule->link);
+
+    return true;
+}
+
+struct sycamore_mirror_manager *sycamore_mirror_manager_create(struct sycamore_server *server) {
+    struct sycamore_mirror_manager *manager =
+            calloc(1, sizeof(struct sycamore_mirror_manager));
+    if (!manager) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_mirror_manager");
+        return NULL;
+    }
+
+    wl_list_init(&manager->mirrors);
+    wl_list_init(&manager->rules);
+    manager->server = server;
+
+    return manager;
+}
+
+void sycamore_mirror_manager_destroy(struct sycamore_mirror_manager *manager) {
+    if (!manager) {
+        return;
+    }
+
+    struct sycamore_mirror *mirror, *next_mirror;
+    wl_list_for_each_safe(mirror, next_mirror, &manager->mirrors, link) {
+        mirror_destroy_full(mirror, false);
+    }
+
+    struct mirror_rule *rule, *next_rule;
+    wl_list_for_each_safe(rule, next_rule, &manager->rules, link) {
+        wl_list_remove(&rule->link);
+        free(rule->dst);
+        free(rule->src);
+        free(rule);
+    }
+
+    free(manager);
+}
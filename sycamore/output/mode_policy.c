@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include "sycamore/output/mode_policy.h"
+
+static const char *policy_names[] = {
+    [MODE_POLICY_PREFERRED] = "preferred",
+    [MODE_POLICY_MAX_REFRESH] = "max-refresh",
+    [MODE_POLICY_MAX_RESOLUTION] = "max-resolution",
+    [MODE_POLICY_EXPLICIT] = "explicit",
+};
+
+static int compare_max_resolution(const void *a, const void *b) {
+    const struct wlr_output_mode *mode_a = *(struct wlr_output_mode *const *)a;
+    const struct wlr_output_mode *mode_b = *(struct wlr_output_mode *const *)b;
+
+    int64_t resolution_a = (int64_t)mode_a->width * mode_a->height;
+    int64_t resolution_b = (int64_t)mode_b->width * mode_b->height;
+    if (resolution_a != resolution_b) {
+        return resolution_a < resolution_b ? 1 : -1;
+    }
+
+    return mode_b->refresh - mode_a->refresh;
+}
+
+static int compare_max_refresh(const void *a, const void *b) {
+    const struct wlr_output_mode *mode_a = *(struct wlr_output_mode *const *)a;
+    const struct wlr_output_mode *mode_b = *(struct wlr_output_mode *const *)b;
+    if (mode_a->refresh != mode_b->refresh) {
+        return mode_b->refresh - mode_a->refresh;
+    }
+
+    return compare_max_resolution(a, b);
+}
+
+static int compare_preferred(const void *a, const void *b) {
+    const struct wlr_output_mode *mode_a = *(struct wlr_output_mode *const *)a;
+    const struct wlr_output_mode *mode_b = *(struct wlr_output_mode *const *)b;
+    if (mode_a->preferred != mode_b->preferred) {
+        return mode_a->preferred ? -1 : 1;
+    }
+
+    return compare_max_resolution(a, b);
+}
+
+static bool mode_matches_rule(const struct wlr_output_mode *mode, const struct mode_rule *rule) {
+    /* Allow for rounding, e.g. 144 vs 143.998Hz */
+    return mode->width == rule->width && mode->height == rule->height &&
+           (rule->refresh == 0 || abs(mode->refresh - rule->refresh) <= 500);
+}
+
+static int compare_explicit(const void *a, const void *b, const struct mode_rule *rule) {
+    const struct wlr_output_mode *mode_a = *(struct wlr_output_mode *const *)a;
+    const struct wlr_output_mode *mode_b = *(struct wlr_output_mode *const *)b;
+    bool match_a = mode_matches_rule(mode_a, rule);
+    bool match_b = mode_matches_rule(mode_b, rule);
+    if (match_a != match_b) {
+        return match_a ? -1 : 1;
+    }
+
+    return match_a ? compare_max_refresh(a, b) : compare_max_resolution(a, b);
+}
+
+static bool match_output(const char *match, const struct wlr_output *output) {
+    if (!match) {
+        return true;
+    }
+
+    if (strcmp(match, output->name) == 0 ||
+            strcmp(match, output->make) == 0 ||
+            strcmp(match, output->model) == 0) {
+        return true;
+    }
+
+    size_t make_len = strlen(output->make);
+    return strncmp(match, output->make, make_len) == 0 &&
+           match[make_len] == ' ' &&
+           strcmp(match + make_len + 1, output->model) == 0;
+}
+
+static bool output_test_mode(struct wlr_output *output, struct wlr_output_mode *mode) {
+    /* Keep the mode the output is already in, to skip a modeset */
+    if (mode != output->current_mode) {
+        wlr_output_set_mode(output, mode);
+    }
+    wlr_output_enable(output, true);
+    if (wlr_output_test(output)) {
+        return true;
+    }
+
+    wlr_output_rollback(output);
+    return false;
+}
+
+static bool output_test_custom_mode(struct wlr_output *output, const struct mode_rule *rule) {
+    wlr_output_set_custom_mode(output, rule->width, rule->height, rule->refresh);
+    wlr_output_enable(output, true);
+    if (wlr_output_test(output)) {
+        return true;
+    }
+
+    wlr_output_rollback(output);
+    return false;
+}
+
+static struct mode_rule *find_mode_rule(struct wl_list *rules, struct wlr_output *output) {
+    struct mode_rule *rule;
+    wl_list_for_each(rule, rules, link) {
+        if (match_output(rule->match, output)) {
+            return rule;
+        }
+    }
+
+    return NULL;
+}
+
+static struct scale_rule *find_scale_rule(struct wl_list *rules, struct wlr_output *output) {
+    struct scale_rule *rule;
+    wl_list_for_each(rule, rules, link) {
+        if (match_output(rule->match, output)) {
+            return rule;
+        }
+    }
+
+    return NULL;
+}
+
+bool mode_policy_apply(struct mode_policy *policy, struct wlr_output *output) {
+    struct mode_rule fallback_rule = {
+        .type = policy->fallback,
+    };
+
+    /* Command line rules win over the config file */
+    const struct mode_rule *rule = find_mode_rule(&policy->rules, output);
+    if (!rule) {
+        rule = find_mode_rule(&policy->config_rules, output);
+    }
+    if (!rule) {
+        rule = &fallback_rule;
+    }
+
+    size_t modes_len = wl_list_length(&output->modes);
+    if (modes_len == 0) {
+        /* Backends without modes only take custom ones */
+        return rule->type == MODE_POLICY_EXPLICIT && output_test_custom_mode(output, rule);
+    }
+
+    struct wlr_output_mode **modes = calloc(modes_len, sizeof(struct wlr_output_mode *));
+    if (!modes) {
+        wlr_log(WLR_ERROR, "Unable to allocate mode candidates");
+        return false;
+    }
+
+    size_t i = 0;
+    struct wlr_output_mode *mode;
+    wl_list_for_each(mode, &output->modes, link) {
+        modes[i++] = mode;
+    }
+
+    switch (rule->type) {
+        case MODE_POLICY_PREFERRED:
+            qsort(modes, modes_len, sizeof(struct wlr_output_mode *), compare_preferred);
+            break;
+        case MODE_POLICY_MAX_REFRESH:
+            qsort(modes, modes_len, sizeof(struct wlr_output_mode *), compare_max_refresh);
+            break;
+        case MODE_POLICY_MAX_RESOLUTION:
+            qsort(modes, modes_len, sizeof(struct wlr_output_mode *), compare_max_resolution);
+            break;
+        case MODE_POLICY_EXPLICIT:
+            /* Insertion sort, since qsort can't carry the rule along */
+            for (size_t j = 1; j < modes_len; ++j) {
+                struct wlr_output_mode *key = modes[j];
+                size_t k = j;
+                while (k > 0 && compare_explicit(&modes[k - 1], &key, rule) > 0) {
+                    modes[k] = modes[k - 1];
+                    --k;
+                }
+                modes[k] = key;
+            }
+            break;
+    }
+
+    /* Candidates are tested in order until one passes */
+    struct wlr_output_mode picked = {0};
+    bool found = false;
+    if (rule->type == MODE_POLICY_EXPLICIT && !mode_matches_rule(modes[0], rule)) {
+        found = output_test_custom_mode(output, rule);
+        picked.width = rule->width;
+        picked.height = rule->height;
+        picked.refresh = rule->refresh;
+    }
+
+    for (i = 0; i < modes_len && !found; ++i) {
+        found = output_test_mode(output, modes[i]);
+        picked = *modes[i];
+    }
+
+    if (found) {
+        wlr_log(WLR_INFO, "Output %s: %s policy picked %dx%d@%.3fHz", output->name,
+                policy_names[rule->type], picked.width, picked.height,
+                picked.refresh / 1000.0);
+    } else {
+        wlr_log(WLR_ERROR, "Output %s accepted none of its modes", output->name);
+    }
+
+    free(modes);
+    return found;
+}
+
+bool mode_policy_apply_scale(struct mode_policy *policy, struct wlr_output *output) {
+    struct scale_rule *rule = find_scale_rule(&policy->scale_rules, output);
+    if (!rule) {
+        rule = find_scale_rule(&policy->config_scale_rules, output);
+    }
+    if (!rule) {
+        return false;
+    }
+
+    wlr_log(WLR_INFO, "Output %s: scale %.3f", output->name, rule->scale);
+    wlr_output_set_scale(output, rule->scale);
+    return true;
+}
+
+void scale_rule_destroy(struct scale_rule *rule) {
+    if (!rule) {
+        return;
+    }
+
+    free(rule->match);
+    free(rule);
+}
+
+struct scale_rule *scale_rule_create(const char *str) {
+    struct scale_rule *rule = calloc(1, sizeof(struct scale_rule));
+    if (!rule) {
+        wlr_log(WLR_ERROR, "Unable to allocate scale_rule");
+        return NULL;
+    }
+
+    const char *scale_str = str;
+    const char *separator = strrchr(str, '=');
+    if (separator) {
+        rule->match = strndup(str, separator - str);
+        scale_str = separator + 1;
+    }
+
+    char *end;
+    rule->scale = strtof(scale_str, &end);
+    if (end == scale_str || *end != '\0' || rule->scale < 0.25f || rule->scale > 8.0f) {
+        wlr_log(WLR_ERROR, "Invalid output scale rule '%s'", str);
+        scale_rule_destroy(rule);
+        return NULL;
+    }
+
+    wl_list_init(&rule->link);
+    return rule;
+}
+
+bool mode_policy_add_scale_rule(struct mode_policy *policy, const char *str) {
+    struct scale_rule *rule = scale_rule_create(str);
+    if (!rule) {
+        return false;
+    }
+
+    wl_list_insert(policy->scale_rules.prev, &rule->link);
+    return true;
+}
+
+static bool parse_policy(struct mode_rule *rule, const char *str) {
+    for (size_t i = 0; i < MODE_POLICY_EXPLICIT; ++i) {
+        if (strcmp(str, policy_names[i]) == 0) {
+            rule->type = i;
+            return true;
+        }
+    }
+
+    char *end;
+    rule->type = MODE_POLICY_EXPLICIT;
+    rule->width = strtol(str, &end, 10);
+    if (end == str || *end != 'x') {
+        return false;
+    }
+
+    str = end + 1;
+    rule->height = strtol(str, &end, 10);
+    if (end == str || (*end != '\0' && *end != '@')) {
+        return false;
+    }
+
+    if (*end == '@') {
+        str = end + 1;
+        rule->refresh = strtod(str, &end) * 1000;
+        if (end == str || *end != '\0') {
+            return false;
+        }
+    }
+
+    return rule->width > 0 && rule->height > 0 && rule->refresh >= 0;
+}
+
+void mode_rule_destroy(struct mode_rule *rule) {
+    if (!rule) {
+        return;
+    }
+
+    free(rule->match);
+    free(rule);
+}
+
+struct mode_rule *mode_rule_create(const char *str) {
+    struct mode_rule *rule = calloc(1, sizeof(struct mode_rule));
+    if (!rule) {
+        wlr_log(WLR_ERROR, "Unable to allocate mode_rule");
+        return NULL;
+    }
+
+    const char *policy_str = str;
+    const char *separator = strrchr(str, '=');
+    if (separator) {
+        rule->match = strndup(str, separator - str);
+        policy_str = separator + 1;
+    }
+
+    if (!parse_policy(rule, policy_str)) {
+        wlr_log(WLR_ERROR, "Invalid output mode rule '%s'", str);
+        mode_rule_destroy(rule);
+        return NULL;
+    }
+
+    wl_list_init(&rule->link);
+    return rule;
+}
+
+bool mode_policy_add_rule(struct mode_policy *policy, const char *str) {
+    struct mode_rule *rule = mode_rule_create(str);
+    if (!rule) {
+        return false;
+    }
+
+    wl_list_insert(policy->rules.prev, &rule->link);
+    return true;
+}
+
+static void mode_rules_destroy(struct wl_list *rules) {
+    struct mode_rule *rule, *next;
+    wl_list_for_each_safe(rule, next, rules, link) {
+        wl_list_remove(&rule->link);
+        mode_rule_destroy(rule);
+    }
+}
+
+static void scale_rules_destroy(struct wl_list *rules) {
+    struct scale_rule *rule, *next;
+    wl_list_for_each_safe(rule, next, rules, link) {
+        wl_list_remove(&rule->link);
+        scale_rule_destroy(rule);
+    }
+}
+
+bool mode_policy_set_config_rules(struct mode_policy *policy,
+        char *const *mode_rules, size_t mode_rules_len,
+        char *const *scale_rules, size_t scale_rules_len) {
+    /* Built aside, so a bad rule leaves the current ones in place */
+    struct wl_list modes, scales;
+    wl_list_init(&modes);
+    wl_list_init(&scales);
+
+    for (size_t i = 0; i < mode_rules_len; ++i) {
+        struct mode_rule *rule = mode_rule_create(mode_rules[i]);
+        if (!rule) {
+            mode_rules_destroy(&modes);
+            return false;
+        }
+        wl_list_insert(modes.prev, &rule->link);
+    }
+
+    for (size_t i = 0; i < scale_rules_len; ++i) {
+        struct scale_rule *rule = scale_rule_create(scale_rules[i]);
+        if (!rule) {
+            mode_rules_destroy(&modes);
+            scale_rules_destroy(&scales);
+            return false;
+        }
+        wl_list_insert(scales.prev, &rule->link);
+    }
+
+    mode_rules_destroy(&policy->config_rules);
+    scale_rules_destroy(&policy->config_scale_rules);
+    wl_list_insert_list(&policy->config_rules, &modes);
+    wl_list_insert_list(&policy->config_scale_rules, &scales);
+    return true;
+}
+
+void mode_policy_destroy(struct mode_policy *policy) {
+    if (!policy) {
+        return;
+    }
+
+    mode_rules_destroy(&policy->rules);
+    mode_rules_destroy(&policy->config_rules);
+    scale_rules_destroy(&policy->scale_rules);
+    scale_rules_destroy(&policy->config_scale_rules);
+
+    free(policy);
+}
+
+struct mode_policy *mode_policy_create() {
+    struct mode_policy *policy = calloc(1, sizeof(struct mode_policy));
+    if (!policy) {
+        wlr_log(WLR_ERROR, "Unable to allocate mode_policy");
+        return NULL;
+    }
+
+    wl_list_init(&policy->rules);
+    wl_list_init(&policy->scale_rules);
+    wl_list_init(&policy->config_rules);
+    wl_list_init(&policy->config_scale_rules);
+    policy->fallback = MODE_POLICY_MAX_RESOLUTION;
+
+    return policy;
+}
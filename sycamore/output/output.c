@@ -1,34 +1,134 @@
+#include <pixman.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <time.h>
+#include <wlr/types/wlr_damage_ring.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/util/log.h>
 #include "sycamore/desktop/layer.h"
 #include "sycamore/input/cursor.h"
+#include "sycamore/output/mirror.h"
+#include "sycamore/output/mode_policy.h"
 #include "sycamore/output/output.h"
+#include "sycamore/output/remote.h"
+#include "sycamore/util/time.h"
 #include "sycamore/server.h"
 
+struct output_frame_done_data {
+    struct wlr_scene_output *scene_output;
+    struct sycamore_client_manager *client_manager;
+    struct timespec now;
+    uint32_t msec;
+};
+
+static void output_frame_done_iterator(struct wlr_scene_buffer *buffer,
+        int sx, int sy, void *data) {
+    struct output_frame_done_data *frame_data = data;
+    if (buffer->primary_output != frame_data->scene_output) {
+        return;
+    }
+
+    /* Hold back frame events of throttled clients */
+    struct wlr_scene_surface *scene_surface = wlr_scene_surface_from_buffer(buffer);
+    if (scene_surface && !client_surface_frame_allowed(frame_data->client_manager,
+            scene_surface->surface, frame_data->msec)) {
+        return;
+    }
+
+    wlr_scene_buffer_send_frame_done(buffer, &frame_data->now);
+}
+
 static void handle_output_frame(struct wl_listener *listener, void *data) {
     /* This function is called every time an output is ready to display a frame,
      * generally at the output's refresh rate (e.g. 60Hz). */
     struct sycamore_output *output = wl_container_of(listener, output, frame);
 
+    /* Rendering isn't the last dispatched client's time */
+    client_manager_dispatch_break(output->server->client_manager);
+
+    /* Mirrors have no scene output, they show their source's last frame */
+    if (output->mirror) {
+        uint64_t start = get_current_time_nsec();
+        bool rendered = mirror_render(output->mirror);
+        stats_record_render(&output->render_cost, rendered, get_current_time_nsec() - start);
+        return;
+    }
+
     struct wlr_scene_output *scene_output =
             wlr_scene_get_scene_output(output->scene, output->wlr_output);
 
+    /* Let rate limited surfaces catch up before rendering */
+    client_manager_flush_deferred(output->server->client_manager);
+
+    stats_record_damage(output->server->stats, scene_output);
+    if (output->remote) {
+        remote_record_damage(output->remote, scene_output);
+    }
+    if (output->server->capture_manager) {
+        capture_manager_record_damage(output->server->capture_manager, output, scene_output);
+    }
+    if (output->server->mirror_manager) {
+        mirror_manager_record_damage(output->server->mirror_manager, output, scene_output);
+    }
+
     /* Render the scene if needed and commit the output */
+    bool damaged = pixman_region32_not_empty(&scene_output->damage_ring.current);
+    uint64_t start = get_current_time_nsec();
     wlr_scene_output_commit(scene_output);
+    stats_record_render(&output->render_cost, damaged, get_current_time_nsec() - start);
 
-    struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
-    wlr_scene_output_send_frame_done(scene_output, &now);
+    struct output_frame_done_data frame_data = {
+        .scene_output = scene_output,
+        .client_manager = output->server->client_manager,
+    };
+    clock_gettime(CLOCK_MONOTONIC, &frame_data.now);
+    frame_data.msec = frame_data.now.tv_sec * 1000 + frame_data.now.tv_nsec / 1000000;
+    wlr_scene_output_for_each_buffer(scene_output, output_frame_done_iterator, &frame_data);
+}
+
+/* Link the frame listener while the output is enabled. Surfaces only on a
+ * disabled output lose their primary output in the scene, so their frame
+ * callbacks stop along with the frame loop. */
+static void output_update_frame_loop(struct sycamore_output *output) {
+    struct wlr_output *wlr_output = output->wlr_output;
+    bool linked = !wl_list_empty(&output->frame.link);
+    if (wlr_output->enabled == linked) {
+        return;
+    }
+
+    if (wlr_output->enabled) {
+        wl_signal_add(&wlr_output->events.frame, &output->frame);
+
+        struct wlr_scene_output *scene_output =
+                wlr_scene_get_scene_output(output->scene, wlr_output);
+        if (scene_output) {
+            wlr_damage_ring_add_whole(&scene_output->damage_ring);
+        }
+        wlr_output_schedule_frame(wlr_output);
+    } else {
+        wl_list_remove(&output->frame.link);
+        wl_list_init(&output->frame.link);
+    }
+}
+
+/* Every path enabling or disabling the output, idle, output power clients,
+ * output management or the mode policy, ends up in a commit */
+static void handle_output_commit(struct wl_listener *listener, void *data) {
+    struct sycamore_output *output = wl_container_of(listener, output, commit);
+    struct wlr_output_event_commit *event = data;
+
+    if (event->committed & WLR_OUTPUT_STATE_ENABLED) {
+        output_update_frame_loop(output);
+    }
 }
 
 static void handle_output_destroy(struct wl_listener *listener, void *data) {
     struct sycamore_output *output = wl_container_of(listener, output, destroy);
 
+    /* While its name can still be reported */
+    ipc_notify_output(output->server->ipc, IPC_EVENT_OUTPUT_REMOVE, output);
     output->wlr_output = NULL;
 
     sycamore_output_destroy(output);
@@ -46,19 +146,40 @@ struct sycamore_output *sycamore_output_create(struct sycamore_server *server,
     output->wlr_output = wlr_output;
     output->scene = server->scene->wlr_scene;
     output->server = server;
+    output->render_cost.since_nsec = get_current_time_nsec();
 
     for (int i = 0; i < LAYERS_ALL; ++i) {
         wl_list_init(&output->layers[i]);
     }
 
     output->frame.notify = handle_output_frame;
-    wl_signal_add(&wlr_output->events.frame, &output->frame);
+    wl_list_init(&output->frame.link);
+    output->commit.notify = handle_output_commit;
+    wl_signal_add(&wlr_output->events.commit, &output->commit);
     output->destroy.notify = handle_output_destroy;
     wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 
+    output_update_frame_loop(output);
+
     return output;
 }
 
+bool output_set_power(struct sycamore_output *output, bool on) {
+    struct wlr_output *wlr_output = output->wlr_output;
+    if (wlr_output->enabled == on) {
+        return true;
+    }
+
+    wlr_output_enable(wlr_output, on);
+    if (!wlr_output_commit(wlr_output)) {
+        wlr_log(WLR_ERROR, "Unable to power %s output %s", on ? "on" : "off", wlr_output->name);
+        wlr_output_rollback(wlr_output);
+        return false;
+    }
+
+    return true;
+}
+
 void output_get_center_coords(struct sycamore_output *output, struct wlr_fbox *box) {
     struct wlr_box output_box;
     wlr_output_layout_get_box(output->server->output_layout,
@@ -68,37 +189,24 @@ void output_get_center_coords(struct sycamore_output *output, struct wlr_fbox *b
     box->y = output_box.y + output_box.height / 2.0;
 }
 
-struct wlr_output_mode *output_max_mode(struct wlr_output *output) {
-    if (!output || wl_list_empty(&output->modes)) {
-        return NULL;
-    }
-
-    int32_t max_refresh = 0, max_resolution = 0;
-    struct wlr_output_mode *mode, *max_mode;
-    wl_list_for_each(mode, &output->modes, link) {
-        int32_t resolution = mode->width * mode->height;
-        if (resolution > max_resolution) {
-            max_resolution = resolution;
-            max_refresh = mode->refresh;
-            max_mode = mode;
-        } else if (resolution == max_resolution && mode->refresh > max_refresh) {
-            max_refresh = mode->refresh;
-            max_mode = mode;
-        }
-    }
-
-    return max_mode;
-}
-
 void sycamore_output_destroy(struct sycamore_output *output) {
     if (!output) {
         return;
     }
 
     wl_list_remove(&output->destroy.link);
+    wl_list_remove(&output->commit.link);
     wl_list_remove(&output->frame.link);
     wl_list_remove(&output->link);
 
+    if (output->wlr_output) {
+        ipc_notify_output(output->server->ipc, IPC_EVENT_OUTPUT_REMOVE, output);
+    }
+
+    if (output->server->mirror_manager) {
+        mirror_manager_handle_output_destroy(output->server->mirror_manager, output);
+    }
+
     for (int i = 0; i < LAYERS_ALL; ++i) {
         struct sycamore_layer *layer, *next;
         wl_list_for_each_safe(layer, next, &output->layers[i], link) {
@@ -114,12 +222,36 @@ void sycamore_output_destroy(struct sycamore_output *output) {
     free(output);
 }
 
+void output_apply_mode_policy(struct sycamore_output *output) {
+    struct wlr_output *wlr_output = output->wlr_output;
+    if (output->virtual || !wlr_output->enabled) {
+        return;
+    }
+
+    struct mode_policy *policy = output->server->mode_policy;
+    bool staged = mode_policy_apply(policy, wlr_output);
+    staged |= mode_policy_apply_scale(policy, wlr_output);
+
+    /* Unchanged mode, scale and enabled state aren't staged at all */
+    if (!staged || wlr_output->pending.committed == 0) {
+        wlr_output_rollback(wlr_output);
+        return;
+    }
+
+    if (!wlr_output_commit(wlr_output)) {
+        wlr_log(WLR_ERROR, "Unable to apply the mode policy to output %s", wlr_output->name);
+        wlr_output_rollback(wlr_output);
+    }
+}
+
 void handle_backend_new_output(struct wl_listener *listener, void *data) {
     struct sycamore_server *server =
             wl_container_of(listener, server, backend_new_output);
     struct wlr_output *wlr_output = data;
     wlr_log(WLR_DEBUG, "new output: %s", wlr_output->name);
 
+    startup_watch_output(server->startup, wlr_output);
+
     /* Configures the output created by the backend to use our allocator
      * and our renderer. Must be done once, before commiting the output */
     if (!wlr_output_init_render(wlr_output, server->allocator,
@@ -128,16 +260,18 @@ void handle_backend_new_output(struct wl_listener *listener, void *data) {
         return;
     }
 
+    /* Set by virtual_output_create(), which picks their mode itself */
+    const struct wlr_box *virtual_box = server->new_virtual_output;
+
     /* Some backends don't have modes. DRM+KMS does, and we need to set a mode
      * before we can use the output. The mode is a tuple of (width, height,
-     * refresh rate), and each monitor supports only a specific set of modes. We
-     * just pick the monitor's preferred mode, a more sophisticated compositor
-     * would let the user configure it. */
-    if (!wl_list_empty(&wlr_output->modes)) {
-        struct wlr_output_mode *mode = output_max_mode(wlr_output);
-        wlr_output_set_mode(wlr_output, mode);
-        wlr_output_enable(wlr_output, true);
-        if (!wlr_output_commit(wlr_output)) {
+     * refresh rate), and each monitor supports only a specific set of modes.
+     * The mode policy ranks them and picks the first one passing a test commit.
+     * A configured scale goes into the same commit. */
+    if (!virtual_box) {
+        bool staged = mode_policy_apply(server->mode_policy, wlr_output);
+        staged |= mode_policy_apply_scale(server->mode_policy, wlr_output);
+        if (staged && !wlr_output_commit(wlr_output)) {
             return;
         }
     }
@@ -149,11 +283,35 @@ void handle_backend_new_output(struct wl_listener *listener, void *data) {
     }
 
     wlr_output->data = output;
+    output->virtual = virtual_box != NULL;
 
-    wlr_output_layout_add_auto(server->output_layout, wlr_output);
+    if (virtual_box) {
+        wlr_output_layout_add(server->output_layout, wlr_output, virtual_box->x, virtual_box->y);
+    } else {
+        wlr_output_layout_add_auto(server->output_layout, wlr_output);
+    }
 
     wlr_output_layout_get_box(server->output_layout, wlr_output, &output->usable_area);
     wl_list_insert(&server->all_outputs, &output->link);
 
     output_setup_xcursor(server->seat->cursor, output);
+
+    mirror_manager_apply_rules(server->mirror_manager);
+
+    ipc_notify_output(server->ipc, IPC_EVENT_OUTPUT_ADD, output);
+}
+
+void handle_output_layout_change(struct wl_listener *listener, void *data) {
+    struct sycamore_server *server =
+            wl_container_of(listener, server, output_layout_change);
+
+    /* Outputs may have moved or changed size */
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        if (wlr_output_layout_get(server->output_layout, output->wlr_output)) {
+            arrange_layers(output);
+        }
+    }
+
+    output_manager_schedule_update(server->output_manager);
 }
\ No newline at end of file
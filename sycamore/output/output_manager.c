@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_output_management_v1.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include "sycamore/input/cursor.h"
+#include "sycamore/output/output.h"
+#include "sycamore/output/output_manager.h"
+#include "sycamore/server.h"
+
+/* Output state before a configuration is applied, to revert to on failure */
+struct output_state_backup {
+    struct wlr_output *wlr_output;
+    bool enabled;
+    struct wlr_output_mode *mode;
+    int32_t width, height, refresh;
+    float scale;
+    enum wl_output_transform transform;
+    bool adaptive_sync;
+    bool committed;
+};
+
+static void output_state_backup_save(struct output_state_backup *backup,
+        struct wlr_output *wlr_output) {
+    backup->wlr_output = wlr_output;
+    backup->enabled = wlr_output->enabled;
+    backup->mode = wlr_output->current_mode;
+    backup->width = wlr_output->width;
+    backup->height = wlr_output->height;
+    backup->refresh = wlr_output->refresh;
+    backup->scale = wlr_output->scale;
+    backup->transform = wlr_output->transform;
+    backup->adaptive_sync =
+            wlr_output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+    backup->committed = false;
+}
+
+static void output_state_backup_restore(struct output_state_backup *backup) {
+    struct wlr_output *wlr_output = backup->wlr_output;
+    wlr_output_enable(wlr_output, backup->enabled);
+    if (backup->enabled) {
+        if (backup->mode) {
+            wlr_output_set_mode(wlr_output, backup->mode);
+        } else {
+            wlr_output_set_custom_mode(wlr_output, backup->width,
+                                       backup->height, backup->refresh);
+        }
+        wlr_output_set_scale(wlr_output, backup->scale);
+        wlr_output_set_transform(wlr_output, backup->transform);
+        wlr_output_enable_adaptive_sync(wlr_output, backup->adaptive_sync);
+    }
+
+    if (!wlr_output_commit(wlr_output)) {
+        wlr_log(WLR_ERROR, "Unable to restore configuration of output %s",
+                wlr_output->name);
+    }
+}
+
+static void head_stage(struct wlr_output_configuration_head_v1 *head) {
+    struct wlr_output *wlr_output = head->state.output;
+
+    wlr_output_enable(wlr_output, head->state.enabled);
+    if (!head->state.enabled) {
+        return;
+    }
+
+    /* Only touch the mode if it changes, to avoid needless modesets */
+    if (head->state.mode) {
+        if (head->state.mode != wlr_output->current_mode) {
+            wlr_output_set_mode(wlr_output, head->state.mode);
+        }
+    } else if (head->state.custom_mode.width != wlr_output->width ||
+               head->state.custom_mode.height != wlr_output->height ||
+               head->state.custom_mode.refresh != wlr_output->refresh) {
+        wlr_output_set_custom_mode(wlr_output, head->state.custom_mode.width,
+                                   head->state.custom_mode.height,
+                                   head->state.custom_mode.refresh);
+    }
+
+    wlr_output_set_scale(wlr_output, head->state.scale);
+    wlr_output_set_transform(wlr_output, head->state.transform);
+    wlr_output_enable_adaptive_sync(wlr_output, head->state.adaptive_sync_enabled);
+}
+
+/* Commit staged heads, disabling outputs first so that their CRTCs are free
+ * for the ones being enabled. Return false and revert if any commit failed. */
+static bool output_manager_commit(struct output_state_backup *backups,
+        struct wlr_output_configuration_head_v1 **heads, size_t heads_len) {
+    bool ok = true;
+    for (int pass = 0; pass < 2 && ok; ++pass) {
+        bool enabling = pass == 1;
+        for (size_t i = 0; i < heads_len; ++i) {
+            if (heads[i]->state.enabled != enabling) {
+                continue;
+            }
+
+            if (!wlr_output_commit(heads[i]->state.output)) {
+                wlr_log(WLR_ERROR, "Unable to commit output %s",
+                        heads[i]->state.output->name);
+                ok = false;
+                break;
+            }
+            backups[i].committed = true;
+        }
+    }
+
+    if (ok) {
+        return true;
+    }
+
+    for (size_t i = 0; i < heads_len; ++i) {
+        if (!backups[i].committed) {
+            wlr_output_rollback(heads[i]->state.output);
+        }
+    }
+
+    for (size_t i = heads_len; i-- > 0;) {
+        if (backups[i].committed) {
+            output_state_backup_restore(&backups[i]);
+        }
+    }
+
+    return false;
+}
+
+/* Apply a configuration to all its heads or to none of them */
+static bool output_manager_apply(struct sycamore_output_manager *manager,
+        struct wlr_output_configuration_v1 *config, bool test_only) {
+    size_t heads_len = wl_list_length(&config->heads);
+    if (heads_len == 0) {
+        return true;
+    }
+
+    struct wlr_output_configuration_head_v1 **heads =
+            calloc(heads_len, sizeof(struct wlr_output_configuration_head_v1 *));
+    struct output_state_backup *backups =
+            calloc(heads_len, sizeof(struct output_state_backup));
+    if (!heads || !backups) {
+        wlr_log(WLR_ERROR, "Unable to allocate output configuration state");
+        free(heads);
+        free(backups);
+        return false;
+    }
+
+    /* Stage and test every head before anything is committed */
+    bool ok = true;
+    size_t i = 0;
+    struct wlr_output_configuration_head_v1 *head;
+    wl_list_for_each(head, &config->heads, link) {
+        heads[i] = head;
+        output_state_backup_save(&backups[i], head->state.output);
+        head_stage(head);
+        if (!wlr_output_test(head->state.output)) {
+            wlr_log(WLR_INFO, "Output %s rejected the new configuration",
+                    head->state.output->name);
+            ok = false;
+        }
+        ++i;
+    }
+
+    if (!ok || test_only) {
+        for (i = 0; i < heads_len; ++i) {
+            wlr_output_rollback(heads[i]->state.output);
+        }
+    } else {
+        ok = output_manager_commit(backups, heads, heads_len);
+    }
+
+    if (ok && !test_only) {
+        struct sycamore_server *server = manager->server;
+        for (i = 0; i < heads_len; ++i) {
+            struct wlr_output *wlr_output = heads[i]->state.output;
+            struct sycamore_output *output = wlr_output->data;
+            if (heads[i]->state.enabled && output && output->mirror) {
+                /* Mirrors stay out of the layout */
+                continue;
+            } else if (heads[i]->state.enabled) {
+                wlr_output_layout_add(server->output_layout, wlr_output,
+                                      heads[i]->state.x, heads[i]->state.y);
+                if (wlr_output->data) {
+                    output_setup_xcursor(server->seat->cursor, wlr_output->data);
+                }
+            } else {
+                wlr_output_layout_remove(server->output_layout, wlr_output);
+            }
+        }
+    }
+
+    free(heads);
+    free(backups);
+    return ok;
+}
+
+static void output_manager_handle_config(struct sycamore_output_manager *manager,
+        struct wlr_output_configuration_v1 *config, bool test_only) {
+    if (output_manager_apply(manager, config, test_only)) {
+        wlr_output_configuration_v1_send_succeeded(config);
+    } else {
+        wlr_output_configuration_v1_send_failed(config);
+    }
+
+    wlr_output_configuration_v1_destroy(config);
+
+    if (!test_only) {
+        output_manager_schedule_update(manager);
+    }
+}
+
+static void handle_output_manager_apply(struct wl_listener *listener, void *data) {
+    struct sycamore_output_manager *manager = wl_container_of(listener, manager, apply);
+
+    output_manager_handle_config(manager, data, false);
+}
+
+static void handle_output_manager_test(struct wl_listener *listener, void *data) {
+    struct sycamore_output_manager *manager = wl_container_of(listener, manager, test);
+
+    output_manager_handle_config(manager, data, true);
+}
+
+static void output_manager_update(void *data) {
+    struct sycamore_output_manager *manager = data;
+    struct sycamore_server *server = manager->server;
+    manager->update_idle = NULL;
+
+    struct wlr_output_configuration_v1 *config = wlr_output_configuration_v1_create();
+    if (!config) {
+        wlr_log(WLR_ERROR, "Unable to create wlr_output_configuration_v1");
+        return;
+    }
+
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        struct wlr_output_configuration_head_v1 *head =
+                wlr_output_configuration_head_v1_create(config, output->wlr_output);
+        if (!head) {
+            wlr_log(WLR_ERROR, "Unable to create wlr_output_configuration_head_v1");
+            wlr_output_configuration_v1_destroy(config);
+            return;
+        }
+
+        struct wlr_box box;
+        wlr_output_layout_get_box(server->output_layout, output->wlr_output, &box);
+        head->state.enabled = output->wlr_output->enabled &&
+                (output->mirror || !wlr_box_empty(&box));
+        head->state.x = box.x;
+        head->state.y = box.y;
+    }
+
+    wlr_output_manager_v1_set_configuration(manager->wlr_output_manager, config);
+}
+
+void output_manager_schedule_update(struct sycamore_output_manager *manager) {
+    if (!manager || manager->update_idle) {
+        return;
+    }
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(manager->server->wl_display);
+    manager->update_idle = wl_event_loop_add_idle(loop, output_manager_update, manager);
+}
+
+void sycamore_output_manager_destroy(struct sycamore_output_manager *manager) {
+    if (!manager) {
+        return;
+    }
+
+    if (manager->update_idle) {
+        wl_event_source_remove(manager->update_idle);
+    }
+
+    wl_list_remove(&manager->apply.link);
+    wl_list_remove(&manager->test.link);
+
+    free(manager);
+}
+
+struct sycamore_output_manager *sycamore_output_manager_create(
+        struct sycamore_server *server, struct wl_display *display) {
+    struct sycamore_output_manager *manager =
+            calloc(1, sizeof(struct sycamore_output_manager));
+    if (!manager) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_output_manager");
+        return NULL;
+    }
+
+    manager->server = server;
+
+    manager->wlr_output_manager = wlr_output_manager_v1_create(display);
+    if (!manager->wlr_output_manager) {
+        wlr_log(WLR_ERROR, "Unable to create wlr_output_manager_v1");
+        free(manager);
+        return NULL;
+    }
+
+    manager->apply.notify = handle_output_manager_apply;
+    wl_signal_add(&manager->wlr_output_manager->events.apply, &manager->apply);
+    manager->test.notify = handle_output_manager_test;
+    wl_signal_add(&manager->wlr_output_manager->events.test, &manager->test);
+
+    return manager;
+}
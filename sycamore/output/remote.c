@@ -0,0 +1,724 @@
+#include <drm_fourcc.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wlr/backend/headless.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_cursor.h>
+#include <wlr/util/log.h>
+#include "sycamore/input/cursor.h"
+#include "sycamore/input/seat.h"
+#include "sycamore/output/output.h"
+#include "sycamore/output/remote.h"
+#include "sycamore/output/remote_protocol.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+/* Frames sent but not acked yet. Damage keeps accumulating past this,
+ * so a slow viewer gets fewer, larger frames instead of a growing backlog. */
+#define REMOTE_MAX_FRAMES_IN_FLIGHT 2
+#define REMOTE_MAX_QUEUED_BYTES (16 * 1024 * 1024)
+
+/* Shorter runs are cheaper as literals */
+#define REMOTE_RLE_MIN_RUN 3
+
+static const struct wlr_keyboard_impl remote_keyboard_impl = {
+    .name = "sycamore-remote-keyboard",
+};
+
+static const struct wlr_pointer_impl remote_pointer_impl = {
+    .name = "sycamore-remote-pointer",
+};
+
+static void remote_queue(struct sycamore_remote *remote, uint32_t type,
+        const void *body, size_t body_len, const void *payload, size_t payload_len) {
+    struct remote_msg_header header = {
+        .type = type,
+        .length = body_len + payload_len,
+    };
+
+    char *dst = wl_array_add(&remote->out, sizeof(header) + body_len + payload_len);
+    if (!dst) {
+        wlr_log(WLR_ERROR, "Unable to queue remote message");
+        return;
+    }
+
+    memcpy(dst, &header, sizeof(header));
+    memcpy(dst + sizeof(header), body, body_len);
+    if (payload_len) {
+        memcpy(dst + sizeof(header) + body_len, payload, payload_len);
+    }
+}
+
+static void remote_disconnect(struct sycamore_remote *remote) {
+    if (remote->fd < 0) {
+        return;
+    }
+
+    wlr_log(WLR_INFO, "Remote viewer disconnected: %" PRIu64 " bytes, %" PRIu64
+            " tiles sent, %" PRIu64 " damaged tiles unchanged", remote->bytes_sent,
+            remote->tiles_sent, remote->tiles_skipped);
+
+    wl_event_source_remove(remote->fd_source);
+    close(remote->fd);
+    remote->fd = -1;
+    remote->fd_source = NULL;
+
+    remote->in.size = 0;
+    remote->out.size = 0;
+    remote->out_offset = 0;
+    pixman_region32_clear(&remote->pending);
+}
+
+static void remote_flush(struct sycamore_remote *remote) {
+    while (remote->out_offset < remote->out.size) {
+        ssize_t n = send(remote->fd, (char *)remote->out.data + remote->out_offset,
+                         remote->out.size - remote->out_offset, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN) {
+                break;
+            }
+
+            wlr_log_errno(WLR_ERROR, "Unable to write to remote viewer");
+            remote_disconnect(remote);
+            return;
+        }
+
+        remote->out_offset += n;
+        remote->bytes_sent += n;
+    }
+
+    if (remote->out_offset == remote->out.size) {
+        remote->out.size = 0;
+        remote->out_offset = 0;
+    } else if (remote->out_offset > remote->out.size / 2) {
+        remote->out.size -= remote->out_offset;
+        memmove(remote->out.data, (char *)remote->out.data + remote->out_offset,
+                remote->out.size);
+        remote->out_offset = 0;
+    }
+
+    wl_event_source_fd_update(remote->fd_source, remote->out.size ?
+            WL_EVENT_READABLE | WL_EVENT_WRITABLE : WL_EVENT_READABLE);
+}
+
+/* Returns the number of uint32 written to out, which must hold len + 1 */
+static size_t rle_encode(const uint32_t *pixels, size_t len, uint32_t *out) {
+    size_t written = 0, literal = SIZE_MAX;
+    for (size_t i = 0; i < len;) {
+        size_t run = 1;
+        while (i + run < len && pixels[i + run] == pixels[i]) {
+            run++;
+        }
+
+        if (run >= REMOTE_RLE_MIN_RUN) {
+            out[written++] = REMOTE_RLE_RUN | run;
+            out[written++] = pixels[i];
+            literal = SIZE_MAX;
+        } else {
+            if (literal == SIZE_MAX) {
+                literal = written++;
+                out[literal] = 0;
+            }
+            for (size_t j = 0; j < run; ++j) {
+                out[written++] = pixels[i + j];
+            }
+            out[literal] += run;
+        }
+
+        i += run;
+    }
+
+    return written;
+}
+
+/* Delta-encode one tile against the shadow. Returns false if it is unchanged. */
+static bool remote_send_tile(struct sycamore_remote *remote, const void *data,
+        size_t stride, const pixman_box32_t *box) {
+    static uint32_t pixels[REMOTE_TILE_SIZE * REMOTE_TILE_SIZE];
+    static uint32_t delta[REMOTE_TILE_SIZE * REMOTE_TILE_SIZE];
+    static uint32_t rle[REMOTE_TILE_SIZE * REMOTE_TILE_SIZE + 1];
+
+    int width = box->x2 - box->x1, height = box->y2 - box->y1;
+    uint32_t changed = 0;
+    for (int y = 0; y < height; ++y) {
+        const uint32_t *src = (const uint32_t *)((const char *)data +
+                (box->y1 + y) * stride) + box->x1;
+        uint32_t *shadow = remote->shadow + (box->y1 + y) * remote->width + box->x1;
+        for (int x = 0; x < width; ++x) {
+            /* Alpha is meaningless on the output */
+            uint32_t pixel = src[x] & 0x00ffffff;
+            pixels[y * width + x] = pixel;
+            delta[y * width + x] = pixel ^ shadow[x];
+            changed |= pixel ^ shadow[x];
+            shadow[x] = pixel;
+        }
+    }
+
+    if (!changed) {
+        return false;
+    }
+
+    size_t len = (size_t)width * height;
+    size_t rle_len = rle_encode(delta, len, rle);
+
+    struct remote_tile tile = {
+        .x = box->x1,
+        .y = box->y1,
+        .width = width,
+        .height = height,
+        .encoding = rle_len < len ? REMOTE_TILE_XOR_RLE : REMOTE_TILE_RAW,
+    };
+    if (tile.encoding == REMOTE_TILE_XOR_RLE) {
+        remote_queue(remote, REMOTE_MSG_TILE, &tile, sizeof(tile), rle, rle_len * 4);
+    } else {
+        remote_queue(remote, REMOTE_MSG_TILE, &tile, sizeof(tile), pixels, len * 4);
+    }
+
+    return true;
+}
+
+/* For buffers without data pointer access, read damaged pixels back through the renderer */
+static bool remote_read_pixels(struct sycamore_remote *remote) {
+    struct wlr_renderer *renderer = remote->server->renderer;
+    if (!wlr_renderer_begin_with_buffer(renderer, remote->buffer)) {
+        return false;
+    }
+
+    bool ok = true;
+    int rects_len;
+    pixman_box32_t *rects = pixman_region32_rectangles(&remote->pending, &rects_len);
+    for (int i = 0; i < rects_len && ok; ++i) {
+        ok = wlr_renderer_read_pixels(renderer, DRM_FORMAT_XRGB8888, remote->width * 4,
+                rects[i].x2 - rects[i].x1, rects[i].y2 - rects[i].y1,
+                rects[i].x1, rects[i].y1, rects[i].x1, rects[i].y1, remote->staging);
+    }
+
+    wlr_renderer_end(renderer);
+    return ok;
+}
+
+static void remote_tile_box(struct sycamore_remote *remote, int x, int y, pixman_box32_t *box) {
+    box->x1 = x;
+    box->y1 = y;
+    box->x2 = x + REMOTE_TILE_SIZE < remote->width ? x + REMOTE_TILE_SIZE : remote->width;
+    box->y2 = y + REMOTE_TILE_SIZE < remote->height ? y + REMOTE_TILE_SIZE : remote->height;
+}
+
+/* Whole tiles are encoded, so grow the damage to tile boundaries */
+static void remote_snap_pending(struct sycamore_remote *remote) {
+    pixman_region32_t tiles;
+    pixman_region32_init(&tiles);
+
+    pixman_box32_t *extents = pixman_region32_extents(&remote->pending);
+    int x1 = extents->x1 / REMOTE_TILE_SIZE * REMOTE_TILE_SIZE;
+    int y1 = extents->y1 / REMOTE_TILE_SIZE * REMOTE_TILE_SIZE;
+    for (int y = y1; y < extents->y2; y += REMOTE_TILE_SIZE) {
+        for (int x = x1; x < extents->x2; x += REMOTE_TILE_SIZE) {
+            pixman_box32_t box;
+            remote_tile_box(remote, x, y, &box);
+            if (pixman_region32_contains_rectangle(&remote->pending, &box) != PIXMAN_REGION_OUT) {
+                pixman_region32_union_rect(&tiles, &tiles, box.x1, box.y1,
+                                           box.x2 - box.x1, box.y2 - box.y1);
+            }
+        }
+    }
+
+    pixman_region32_copy(&remote->pending, &tiles);
+    pixman_region32_fini(&tiles);
+}
+
+static void remote_send_frame(struct sycamore_remote *remote) {
+    if (remote->fd < 0 || !remote->buffer ||
+            !pixman_region32_not_empty(&remote->pending) ||
+            remote->seq - remote->acked_seq >= REMOTE_MAX_FRAMES_IN_FLIGHT ||
+            remote->out.size - remote->out_offset > REMOTE_MAX_QUEUED_BYTES) {
+        return;
+    }
+
+    pixman_region32_intersect_rect(&remote->pending, &remote->pending,
+                                   0, 0, remote->width, remote->height);
+    if (!pixman_region32_not_empty(&remote->pending)) {
+        return;
+    }
+    remote_snap_pending(remote);
+
+    void *data;
+    uint32_t format;
+    size_t stride;
+    bool direct = wlr_buffer_begin_data_ptr_access(remote->buffer,
+            WLR_BUFFER_DATA_PTR_ACCESS_READ, &data, &format, &stride);
+    if (direct && format != DRM_FORMAT_XRGB8888 && format != DRM_FORMAT_ARGB8888) {
+        wlr_buffer_end_data_ptr_access(remote->buffer);
+        wlr_log(WLR_ERROR, "Unsupported remote buffer format 0x%08x", format);
+        return;
+    } else if (!direct) {
+        if (!remote_read_pixels(remote)) {
+            wlr_log(WLR_ERROR, "Unable to read back remote output");
+            return;
+        }
+        data = remote->staging;
+        stride = remote->width * 4;
+    }
+
+    uint32_t tiles = 0;
+    pixman_box32_t *extents = pixman_region32_extents(&remote->pending);
+    for (int y = extents->y1; y < extents->y2; y += REMOTE_TILE_SIZE) {
+        for (int x = extents->x1; x < extents->x2; x += REMOTE_TILE_SIZE) {
+            pixman_box32_t box;
+            remote_tile_box(remote, x, y, &box);
+            if (pixman_region32_contains_rectangle(&remote->pending, &box) != PIXMAN_REGION_IN) {
+                continue;
+            }
+
+            if (remote_send_tile(remote, data, stride, &box)) {
+                tiles++;
+            } else {
+                remote->tiles_skipped++;
+            }
+        }
+    }
+
+    if (direct) {
+        wlr_buffer_end_data_ptr_access(remote->buffer);
+    }
+
+    pixman_region32_clear(&remote->pending);
+    remote->tiles_sent += tiles;
+
+    struct remote_frame_end end = {
+        .seq = ++remote->seq,
+        .tiles = tiles,
+    };
+    remote_queue(remote, REMOTE_MSG_FRAME_END, &end, sizeof(end), NULL, 0);
+    remote_flush(remote);
+}
+
+/* Forget what the viewer has and send everything again */
+static void remote_reset(struct sycamore_remote *remote) {
+    struct remote_hello hello = {
+        .version = REMOTE_PROTOCOL_VERSION,
+        .width = remote->width,
+        .height = remote->height,
+        .tile_size = REMOTE_TILE_SIZE,
+    };
+    remote_queue(remote, REMOTE_MSG_HELLO, &hello, sizeof(hello), NULL, 0);
+
+    memset(remote->shadow, 0, (size_t)remote->width * remote->height * 4);
+    pixman_region32_union_rect(&remote->pending, &remote->pending,
+                               0, 0, remote->width, remote->height);
+    remote->acked_seq = remote->seq;
+
+    remote_send_frame(remote);
+    remote_flush(remote);
+}
+
+static bool remote_resize(struct sycamore_remote *remote) {
+    int width = remote->wlr_output->width, height = remote->wlr_output->height;
+    if (width == remote->width && height == remote->height) {
+        return true;
+    }
+
+    size_t size = (size_t)width * height * 4;
+    uint32_t *shadow = realloc(remote->shadow, size);
+    uint32_t *staging = shadow ? realloc(remote->staging, size) : NULL;
+    if (shadow) {
+        remote->shadow = shadow;
+    }
+    if (staging) {
+        remote->staging = staging;
+    }
+    if (!shadow || !staging) {
+        wlr_log(WLR_ERROR, "Unable to allocate remote framebuffers");
+        return false;
+    }
+
+    remote->width = width;
+    remote->height = height;
+    return true;
+}
+
+static void remote_pointer_frame(struct sycamore_remote *remote) {
+    wl_signal_emit(&remote->pointer.events.frame, &remote->pointer);
+}
+
+static void remote_handle_message(struct sycamore_remote *remote,
+        const struct remote_msg_header *header, const void *body) {
+    uint32_t time_msec = get_current_time_msec();
+
+    switch (header->type) {
+        case REMOTE_MSG_FRAME_ACK: {
+            const struct remote_frame_ack *ack = body;
+            if (ack->seq <= remote->seq) {
+                remote->acked_seq = ack->seq;
+            }
+            remote_send_frame(remote);
+            break;
+        }
+        case REMOTE_MSG_KEY: {
+            const struct remote_key *key = body;
+            struct wlr_keyboard_key_event event = {
+                .time_msec = time_msec,
+                .keycode = key->keycode,
+                .update_state = true,
+                .state = key->pressed ?
+                        WL_KEYBOARD_KEY_STATE_PRESSED : WL_KEYBOARD_KEY_STATE_RELEASED,
+            };
+            wlr_keyboard_notify_key(&remote->keyboard, &event);
+            break;
+        }
+        case REMOTE_MSG_POINTER_MOTION: {
+            const struct remote_pointer_motion *motion = body;
+            struct wlr_pointer_motion_absolute_event event = {
+                .pointer = &remote->pointer,
+                .time_msec = time_msec,
+                .x = (double)motion->x / remote->width,
+                .y = (double)motion->y / remote->height,
+            };
+            wl_signal_emit(&remote->pointer.events.motion_absolute, &event);
+            remote_pointer_frame(remote);
+            break;
+        }
+        case REMOTE_MSG_POINTER_BUTTON: {
+            const struct remote_pointer_button *button = body;
+            struct wlr_pointer_button_event event = {
+                .pointer = &remote->pointer,
+                .time_msec = time_msec,
+                .button = button->button,
+                .state = button->pressed ? WLR_BUTTON_PRESSED : WLR_BUTTON_RELEASED,
+            };
+            wl_signal_emit(&remote->pointer.events.button, &event);
+            remote_pointer_frame(remote);
+            break;
+        }
+        case REMOTE_MSG_POINTER_AXIS: {
+            const struct remote_pointer_axis *axis = body;
+            struct wlr_pointer_axis_event event = {
+                .pointer = &remote->pointer,
+                .time_msec = time_msec,
+                .source = WLR_AXIS_SOURCE_WHEEL,
+                .orientation = axis->horizontal ?
+                        WLR_AXIS_ORIENTATION_HORIZONTAL : WLR_AXIS_ORIENTATION_VERTICAL,
+                .delta = axis->steps * 15.0,
+                .delta_discrete = axis->steps * WLR_POINTER_AXIS_DISCRETE_STEP,
+            };
+            wl_signal_emit(&remote->pointer.events.axis, &event);
+            remote_pointer_frame(remote);
+            break;
+        }
+        default:
+            wlr_log(WLR_DEBUG, "Ignoring remote message type %u", header->type);
+            break;
+    }
+}
+
+static size_t remote_msg_body_size(uint32_t type) {
+    switch (type) {
+        case REMOTE_MSG_FRAME_ACK:
+            return sizeof(struct remote_frame_ack);
+        case REMOTE_MSG_KEY:
+            return sizeof(struct remote_key);
+        case REMOTE_MSG_POINTER_MOTION:
+            return sizeof(struct remote_pointer_motion);
+        case REMOTE_MSG_POINTER_BUTTON:
+            return sizeof(struct remote_pointer_button);
+        case REMOTE_MSG_POINTER_AXIS:
+            return sizeof(struct remote_pointer_axis);
+        default:
+            return 0;
+    }
+}
+
+static void remote_read(struct sycamore_remote *remote) {
+    char *dst = wl_array_add(&remote->in, 4096);
+    if (!dst) {
+        remote_disconnect(remote);
+        return;
+    }
+
+    ssize_t n = recv(remote->fd, dst, 4096, 0);
+    remote->in.size -= 4096 - (n > 0 ? n : 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        remote_disconnect(remote);
+        return;
+    }
+
+    size_t offset = 0;
+    while (remote->in.size - offset >= sizeof(struct remote_msg_header)) {
+        struct remote_msg_header header;
+        memcpy(&header, (char *)remote->in.data + offset, sizeof(header));
+        if (header.length > REMOTE_MSG_MAX_LENGTH) {
+            wlr_log(WLR_ERROR, "Remote viewer sent an oversized message, disconnecting");
+            remote_disconnect(remote);
+            return;
+        }
+
+        if (remote->in.size - offset - sizeof(header) < header.length) {
+            break;
+        }
+
+        /* Unknown or short messages are skipped, not trusted */
+        const char *body = (char *)remote->in.data + offset + sizeof(header);
+        size_t expected = remote_msg_body_size(header.type);
+        if (expected && header.length >= expected) {
+            uint32_t aligned[4];
+            memcpy(aligned, body, expected);
+            remote_handle_message(remote, &header, aligned);
+            if (remote->fd < 0) {
+                return;
+            }
+        }
+
+        offset += sizeof(header) + header.length;
+    }
+
+    remote->in.size -= offset;
+    memmove(remote->in.data, (char *)remote->in.data + offset, remote->in.size);
+}
+
+static int handle_remote_fd(int fd, uint32_t mask, void *data) {
+    struct sycamore_remote *remote = data;
+
+    if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+        remote_disconnect(remote);
+        return 0;
+    }
+
+    if (mask & WL_EVENT_WRITABLE) {
+        remote_flush(remote);
+        /* Queued bytes may have been holding frames back */
+        remote_send_frame(remote);
+    }
+
+    if (remote->fd >= 0 && (mask & WL_EVENT_READABLE)) {
+        remote_read(remote);
+    }
+
+    return 0;
+}
+
+static int handle_remote_listen(int fd, uint32_t mask, void *data) {
+    struct sycamore_remote *remote = data;
+
+    int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to accept remote viewer");
+        return 0;
+    }
+
+    if (remote->fd >= 0) {
+        wlr_log(WLR_INFO, "Rejecting remote viewer, one is already connected");
+        close(client_fd);
+        return 0;
+    }
+
+    remote->fd_source = wl_event_loop_add_fd(wl_display_get_event_loop(remote->server->wl_display),
+            client_fd, WL_EVENT_READABLE, handle_remote_fd, remote);
+    if (!remote->fd_source) {
+        wlr_log(WLR_ERROR, "Unable to watch remote viewer");
+        close(client_fd);
+        return 0;
+    }
+
+    wlr_log(WLR_INFO, "Remote viewer connected to %s", remote->wlr_output->name);
+    remote->fd = client_fd;
+    remote->bytes_sent = 0;
+    remote->tiles_sent = 0;
+    remote->tiles_skipped = 0;
+
+    remote_reset(remote);
+    return 0;
+}
+
+void remote_record_damage(struct sycamore_remote *remote, struct wlr_scene_output *scene_output) {
+    if (remote->fd < 0) {
+        return;
+    }
+
+    pixman_region32_union(&remote->pending, &remote->pending,
+                          &scene_output->damage_ring.current);
+}
+
+static void handle_remote_output_commit(struct wl_listener *listener, void *data) {
+    struct sycamore_remote *remote = wl_container_of(listener, remote, output_commit);
+    struct wlr_output_event_commit *event = data;
+
+    if (event->committed & WLR_OUTPUT_STATE_MODE) {
+        if (!remote_resize(remote)) {
+            remote_disconnect(remote);
+            return;
+        }
+
+        if (remote->fd >= 0) {
+            remote_reset(remote);
+        }
+    }
+
+    if (!(event->committed & WLR_OUTPUT_STATE_BUFFER) || !event->buffer) {
+        return;
+    }
+
+    /* Keep the frame around, a frame held back by the viewer is sent from it later */
+    if (remote->buffer) {
+        wlr_buffer_unlock(remote->buffer);
+    }
+    remote->buffer = wlr_buffer_lock(event->buffer);
+
+    remote_send_frame(remote);
+}
+
+static void handle_remote_output_destroy(struct wl_listener *listener, void *data) {
+    struct sycamore_remote *remote = wl_container_of(listener, remote, output_destroy);
+
+    remote_disconnect(remote);
+
+    wl_list_remove(&remote->output_commit.link);
+    wl_list_remove(&remote->output_destroy.link);
+    wl_list_init(&remote->output_commit.link);
+    wl_list_init(&remote->output_destroy.link);
+    remote->wlr_output = NULL;
+}
+
+static bool remote_listen(struct sycamore_remote *remote) {
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+    if (strlen(remote->socket_path) >= sizeof(addr.sun_path)) {
+        wlr_log(WLR_ERROR, "Remote socket path too long: %s", remote->socket_path);
+        return false;
+    }
+    strcpy(addr.sun_path, remote->socket_path);
+
+    remote->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (remote->listen_fd < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to create remote socket");
+        return false;
+    }
+
+    unlink(remote->socket_path);
+    if (bind(remote->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(remote->listen_fd, 1) < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to listen on %s", remote->socket_path);
+        return false;
+    }
+
+    remote->listen_source = wl_event_loop_add_fd(
+            wl_display_get_event_loop(remote->server->wl_display), remote->listen_fd,
+            WL_EVENT_READABLE, handle_remote_listen, remote);
+    return remote->listen_source != NULL;
+}
+
+void sycamore_remote_destroy(struct sycamore_remote *remote) {
+    if (!remote) {
+        return;
+    }
+
+    remote_disconnect(remote);
+
+    if (remote->listen_source) {
+        wl_event_source_remove(remote->listen_source);
+    }
+
+    if (remote->listen_fd >= 0) {
+        close(remote->listen_fd);
+        unlink(remote->socket_path);
+    }
+
+    wl_list_remove(&remote->output_commit.link);
+    wl_list_remove(&remote->output_destroy.link);
+    if (remote->wlr_output && remote->wlr_output->data) {
+        struct sycamore_output *output = remote->wlr_output->data;
+        output->remote = NULL;
+    }
+
+    if (remote->keyboard.base.name) {
+        wlr_keyboard_finish(&remote->keyboard);
+    }
+
+    if (remote->pointer.base.name) {
+        wlr_pointer_finish(&remote->pointer);
+    }
+
+    if (remote->buffer) {
+        wlr_buffer_unlock(remote->buffer);
+    }
+
+    pixman_region32_fini(&remote->pending);
+    wl_array_release(&remote->in);
+    wl_array_release(&remote->out);
+    free(remote->shadow);
+    free(remote->staging);
+    free(remote->socket_path);
+    free(remote);
+}
+
+struct sycamore_remote *sycamore_remote_create(struct sycamore_server *server,
+        struct wlr_backend *headless, const char *socket_path, int width, int height) {
+    struct sycamore_remote *remote = calloc(1, sizeof(struct sycamore_remote));
+    if (!remote) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_remote");
+        return NULL;
+    }
+
+    remote->server = server;
+    remote->fd = -1;
+    remote->listen_fd = -1;
+    wl_array_init(&remote->in);
+    wl_array_init(&remote->out);
+    pixman_region32_init(&remote->pending);
+    wl_list_init(&remote->output_commit.link);
+    wl_list_init(&remote->output_destroy.link);
+
+    remote->socket_path = strdup(socket_path);
+    if (!remote->socket_path || !remote_listen(remote)) {
+        sycamore_remote_destroy(remote);
+        return NULL;
+    }
+
+    /* Goes through handle_backend_new_output like any other output, which
+     * the headless backend only calls once it is started */
+    remote->wlr_output = wlr_headless_add_output(headless, width, height);
+    if (!remote->wlr_output || !remote->wlr_output->data) {
+        wlr_log(WLR_ERROR, "Unable to create remote output");
+        sycamore_remote_destroy(remote);
+        return NULL;
+    }
+
+    struct sycamore_output *output = remote->wlr_output->data;
+    output->remote = remote;
+
+    remote->output_commit.notify = handle_remote_output_commit;
+    wl_signal_add(&remote->wlr_output->events.commit, &remote->output_commit);
+    remote->output_destroy.notify = handle_remote_output_destroy;
+    wl_signal_add(&remote->wlr_output->events.destroy, &remote->output_destroy);
+
+    wlr_output_set_custom_mode(remote->wlr_output, width, height, 0);
+    wlr_output_enable(remote->wlr_output, true);
+    if (!wlr_output_commit(remote->wlr_output) || !remote_resize(remote)) {
+        wlr_log(WLR_ERROR, "Unable to enable remote output");
+        sycamore_remote_destroy(remote);
+        return NULL;
+    }
+
+    /* The viewer's input, the pointer only moves on the remote output */
+    wlr_keyboard_init(&remote->keyboard, &remote_keyboard_impl, remote_keyboard_impl.name);
+    handle_backend_new_input(&server->backend_new_input, &remote->keyboard.base);
+    wlr_pointer_init(&remote->pointer, &remote_pointer_impl, remote_pointer_impl.name);
+    handle_backend_new_input(&server->backend_new_input, &remote->pointer.base);
+    wlr_cursor_map_input_to_output(server->seat->cursor->wlr_cursor,
+                                   &remote->pointer.base, remote->wlr_output);
+
+    wlr_log(WLR_INFO, "Remote output %s (%dx%d) listening on %s",
+            remote->wlr_output->name, width, height, remote->socket_path);
+
+    return remote;
+}
@@ -73,6 +73,10 @@ struct sycamore_view *view_under(struct sycamore_scene *scene, double lx, double
         tree = tree->node.parent;
     }
 
+    if (!tree) {
+        return NULL;
+    }
+
     enum scene_descriptor_type *descriptor_type = tree->node.data;
     if (*descriptor_type != SCENE_DESC_VIEW) {
         return NULL;
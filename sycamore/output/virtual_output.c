@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/backend/headless.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/log.h>
+#include "sycamore/output/output.h"
+#include "sycamore/output/virtual_output.h"
+#include "sycamore/server.h"
+
+struct sycamore_output *virtual_output_create(struct sycamore_server *server,
+        const struct wlr_box *box, int refresh) {
+    if (box->width <= 0 || box->height <= 0) {
+        wlr_log(WLR_ERROR, "Invalid virtual output size %dx%d", box->width, box->height);
+        return NULL;
+    }
+
+    /* Goes through handle_backend_new_output like any other output, which
+     * flags and places it from the box before anything else sees it */
+    server->new_virtual_output = box;
+    struct wlr_output *wlr_output =
+            wlr_headless_add_output(server->headless_backend, box->width, box->height);
+    server->new_virtual_output = NULL;
+    if (!wlr_output || !wlr_output->data) {
+        wlr_log(WLR_ERROR, "Unable to create virtual output");
+        if (wlr_output) {
+            wlr_output_destroy(wlr_output);
+        }
+        return NULL;
+    }
+
+    struct sycamore_output *output = wlr_output->data;
+
+    wlr_output_set_custom_mode(wlr_output, box->width, box->height, refresh);
+    wlr_output_enable(wlr_output, true);
+    if (!wlr_output_commit(wlr_output)) {
+        wlr_log(WLR_ERROR, "Unable to enable virtual output %s", wlr_output->name);
+        wlr_output_destroy(wlr_output);
+        return NULL;
+    }
+
+    wlr_log(WLR_INFO, "Created virtual output %s: %dx%d@%.3fHz at %d,%d", wlr_output->name,
+            box->width, box->height, wlr_output->refresh / 1000.0, box->x, box->y);
+    return output;
+}
+
+bool virtual_output_parse_spec(const char *str, struct virtual_output_spec *spec) {
+    *spec = (struct virtual_output_spec){0};
+
+    char *end;
+    spec->width = strtol(str, &end, 10);
+    if (end == str || *end != 'x') {
+        return false;
+    }
+
+    str = end + 1;
+    spec->height = strtol(str, &end, 10);
+    if (end == str) {
+        return false;
+    }
+
+    if (*end == '@') {
+        str = end + 1;
+        spec->refresh = strtod(str, &end) * 1000;
+        if (end == str || spec->refresh <= 0) {
+            return false;
+        }
+    }
+
+    if (*end == '+') {
+        str = end + 1;
+        spec->x = strtol(str, &end, 10);
+        if (end == str || *end != ',') {
+            return false;
+        }
+
+        str = end + 1;
+        spec->y = strtol(str, &end, 10);
+        if (end == str) {
+            return false;
+        }
+        spec->positioned = true;
+    }
+
+    return *end == '\0' && spec->width > 0 && spec->height > 0;
+}
+
+struct sycamore_output *virtual_output_create_from_spec(struct sycamore_server *server,
+        const struct virtual_output_spec *spec) {
+    struct wlr_box box = {
+        .x = spec->x,
+        .y = spec->y,
+        .width = spec->width,
+        .height = spec->height,
+    };
+
+    if (!spec->positioned) {
+        /* To the right of everything else */
+        struct wlr_box layout_box;
+        wlr_output_layout_get_box(server->output_layout, NULL, &layout_box);
+        box.x = layout_box.x + layout_box.width;
+        box.y = layout_box.y;
+    }
+
+    return virtual_output_create(server, &box, spec->refresh);
+}
+
+struct sycamore_output *virtual_output_from_name(struct sycamore_server *server,
+        const char *name) {
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        if (strcmp(output->wlr_output->name, name) == 0) {
+            return output->virtual ? output : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+void virtual_output_destroy(struct sycamore_output *output) {
+    if (!output->virtual) {
+        return;
+    }
+
+    wlr_log(WLR_INFO, "Destroying virtual output %s", output->wlr_output->name);
+
+    /* handle_output_destroy frees the sycamore_output */
+    wlr_output_destroy(output->wlr_output);
+}
@@ -1,8 +1,15 @@
+#include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/backend/multi.h>
 #include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_data_control_v1.h>
@@ -16,47 +23,244 @@
 #include <wlr/types/wlr_viewporter.h>
 #include <wlr/types/wlr_xdg_output_v1.h>
 #include <wlr/util/log.h>
+#include "sycamore/desktop/layer.h"
 #include "sycamore/desktop/shell/layer_shell.h"
 #include "sycamore/desktop/shell/xdg_shell.h"
 #include "sycamore/input/keybinding.h"
+#include "sycamore/input/keyboard.h"
+#include "sycamore/input/pointer.h"
 #include "sycamore/input/seat.h"
 #include "sycamore/output/scene.h"
 #include "sycamore/output/output.h"
 #include "sycamore/server.h"
 
-static bool server_init(struct sycamore_server *server) {
+static void server_init_pools(struct sycamore_server *server) {
+    pool_init(&server->pools[POOL_XDG_SHELL_VIEW], "xdg_shell_view",
+              sizeof(struct sycamore_xdg_shell_view));
+    pool_init(&server->pools[POOL_LAYER], "layer",
+              sizeof(struct sycamore_layer));
+    pool_init(&server->pools[POOL_SEAT_DEVICE], "seat_device",
+              sizeof(struct sycamore_seat_device));
+    pool_init(&server->pools[POOL_KEYBOARD], "keyboard",
+              sizeof(struct sycamore_keyboard));
+    pool_init(&server->pools[POOL_POINTER], "pointer",
+              sizeof(struct sycamore_pointer));
+    pool_init(&server->pools[POOL_DRAG], "drag",
+              sizeof(struct sycamore_drag));
+}
+
+static int handle_sigusr2(int signal, void *data) {
+    struct sycamore_server *server = data;
+
+    stats_dump(server);
+    return 0;
+}
+
+static struct wlr_renderer *server_create_renderer(struct sycamore_server *server) {
+    const char *profile = getenv("SYCAMORE_RENDER_PROFILE");
+    server->software_render = profile && strcmp(profile, "software") == 0;
+    if (!server->software_render) {
+        return wlr_renderer_autocreate(server->backend);
+    }
+
+    /* The pixman renderer only takes data pointer buffers, so the allocator
+     * autocreated for it is shm and clients aren't offered linux-dmabuf. */
+    wlr_log(WLR_INFO, "Using the software render profile");
+    return wlr_pixman_renderer_create();
+}
+
+/* Virtual outputs come from a headless backend next to the others. Remote
+ * mode runs on the headless backend alone, without any GPU or seat. */
+static struct wlr_backend *server_create_backend(struct sycamore_server *server) {
+    struct wlr_backend *backend = getenv("SYCAMORE_REMOTE_SOCKET") ?
+            wlr_multi_backend_create(server->wl_display) :
+            wlr_backend_autocreate(server->wl_display);
+    if (!backend || !wlr_backend_is_multi(backend)) {
+        if (backend) {
+            wlr_backend_destroy(backend);
+        }
+        return NULL;
+    }
+
+    server->headless_backend = wlr_headless_backend_create(server->wl_display);
+    if (!server->headless_backend) {
+        wlr_backend_destroy(backend);
+        return NULL;
+    }
+
+    wlr_multi_backend_add(backend, server->headless_backend);
+    return backend;
+}
+
+static bool server_init_remote(struct sycamore_server *server) {
+    const char *socket_path = getenv("SYCAMORE_REMOTE_SOCKET");
+    if (!socket_path) {
+        return true;
+    }
+
+    int width = 1920, height = 1080;
+    const char *size = getenv("SYCAMORE_REMOTE_SIZE");
+    if (size && (sscanf(size, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)) {
+        wlr_log(WLR_ERROR, "Invalid SYCAMORE_REMOTE_SIZE '%s', expected WxH", size);
+        return false;
+    }
+
+    server->remote = sycamore_remote_create(server, server->headless_backend,
+                                            socket_path, width, height);
+    return server->remote != NULL;
+}
+
+static bool server_init_ipc(struct sycamore_server *server) {
+    const char *socket_path = getenv("SYCAMORE_IPC_SOCKET");
+    char default_path[256];
+    if (!socket_path) {
+        const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+        if (!runtime_dir) {
+            wlr_log(WLR_INFO, "XDG_RUNTIME_DIR is not set, no IPC socket");
+            return true;
+        }
+
+        snprintf(default_path, sizeof(default_path), "%s/sycamore-ipc.%d.sock",
+                 runtime_dir, getpid());
+        socket_path = default_path;
+    }
+
+    server->ipc = sycamore_ipc_create(server, socket_path);
+    return server->ipc != NULL;
+}
+
+static int handle_sighup(int signal, void *data) {
+    struct sycamore_server *server = data;
+
+    config_watch_reload(server->config_watch);
+    return 0;
+}
+
+static bool server_init(struct sycamore_server *server, const char *config_path) {
     wlr_log(WLR_INFO, "Initializing Wayland server");
 
+    server->startup = sycamore_startup_create();
+    if (!server->startup) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_startup");
+        return false;
+    }
+
+    server_init_pools(server);
+
+    /* Read first: almost everything below is set up from it */
+    char *default_path = config_path ? NULL : config_default_path();
+    server->config = sycamore_config_load(config_path ? config_path : default_path);
+    free(default_path);
+    if (!server->config) {
+        wlr_log(WLR_ERROR, "Unable to load config");
+        return false;
+    }
+
+    server->stats = sycamore_stats_create();
+    if (!server->stats) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_stats");
+        return false;
+    }
+
+    server->mode_policy = mode_policy_create();
+    if (!server->mode_policy) {
+        wlr_log(WLR_ERROR, "Unable to create mode_policy");
+        return false;
+    }
+
+    struct sycamore_config *config = server->config;
+    if (!mode_policy_set_config_rules(server->mode_policy,
+            config->output.mode_rules.data,
+            config->output.mode_rules.size / sizeof(char *),
+            config->output.scale_rules.data,
+            config->output.scale_rules.size / sizeof(char *))) {
+        return false;
+    }
+
+    server->mirror_manager = sycamore_mirror_manager_create(server);
+    if (!server->mirror_manager) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_mirror_manager");
+        return false;
+    }
+
     wl_list_init(&server->all_outputs);
     wl_list_init(&server->mapped_views);
     server->focused_view.view = NULL;
 
     server->wl_display = wl_display_create();
-    server->backend = wlr_backend_autocreate(server->wl_display);
+
+    /* Fork the launcher helper first, while the compositor is small and
+     * holds no GPU or input fds */
+    server->launcher = sycamore_launcher_create(server, server->wl_display);
+    if (!server->launcher) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_launcher");
+        return false;
+    }
+
+    /* Everything exported to clients is set before the prefetch thread
+     * starts, getenv() there would race with setenv() here. Clients are
+     * only served once the server runs, the sockets may open this early. */
+    startup_begin(server->startup, STARTUP_SOCKET);
+    server->socket = wl_display_add_socket_auto(server->wl_display);
+    if (!server->socket) {
+        wlr_log(WLR_ERROR, "Unable to open wayland socket");
+        return false;
+    }
+    setenv("WAYLAND_DISPLAY", server->socket, true);
+    startup_end(server->startup, STARTUP_SOCKET);
+
+    if (!server_init_ipc(server)) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_ipc");
+        return false;
+    }
+
+    xcursor_setenv(server->config);
+
+    /* Read startup files while the backend comes up. Without it, they are
+     * read when first needed. */
+    server->prefetch = sycamore_prefetch_start(server);
+    if (!server->prefetch) {
+        wlr_log(WLR_ERROR, "Unable to start prefetching");
+    }
+
+    server->config_watch = sycamore_config_watch_create(server, server->config->path);
+    if (!server->config_watch) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_config_watch");
+        return false;
+    }
+
+    startup_begin(server->startup, STARTUP_BACKEND);
+    server->backend = server_create_backend(server);
     if (!server->backend) {
         wlr_log(WLR_ERROR, "Unable to create backend");
         return false;
     }
+    startup_end(server->startup, STARTUP_BACKEND);
 
     server->backend_new_input.notify = handle_backend_new_input;
     wl_signal_add(&server->backend->events.new_input, &server->backend_new_input);
     server->backend_new_output.notify = handle_backend_new_output;
     wl_signal_add(&server->backend->events.new_output, &server->backend_new_output);
 
-    server->renderer = wlr_renderer_autocreate(server->backend);
+    startup_begin(server->startup, STARTUP_RENDERER);
+    server->renderer = server_create_renderer(server);
     if (!server->renderer) {
         wlr_log(WLR_ERROR, "Unable to create renderer");
         return false;
     }
 
     wlr_renderer_init_wl_display(server->renderer, server->wl_display);
+    startup_end(server->startup, STARTUP_RENDERER);
 
+    startup_begin(server->startup, STARTUP_ALLOCATOR);
     server->allocator = wlr_allocator_autocreate(server->backend, server->renderer);
     if (!server->allocator) {
         wlr_log(WLR_ERROR, "Unable to create allocator");
         return false;
     }
+    startup_end(server->startup, STARTUP_ALLOCATOR);
 
+    startup_begin(server->startup, STARTUP_CORE);
     server->compositor = wlr_compositor_create(server->wl_display, server->renderer);
     if (!server->compositor) {
         wlr_log(WLR_ERROR, "Unable to create compositor");
@@ -65,24 +269,44 @@ static bool server_init(struct sycamore_server *server) {
 
     wlr_subcompositor_create(server->wl_display);
 
+    server->client_manager = sycamore_client_manager_create(server,
+            server->wl_display, server->compositor);
+    if (!server->client_manager) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_client_manager");
+        return false;
+    }
+
     server->output_layout = wlr_output_layout_create();
     if (!server->output_layout) {
         wlr_log(WLR_ERROR, "Unable to create output_layout");
         return false;
     }
 
+    server->output_layout_change.notify = handle_output_layout_change;
+    wl_signal_add(&server->output_layout->events.change, &server->output_layout_change);
+
+    server->output_manager = sycamore_output_manager_create(server, server->wl_display);
+    if (!server->output_manager) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_output_manager");
+        return false;
+    }
+
     server->presentation = wlr_presentation_create(server->wl_display, server->backend);
     if (!server->presentation) {
         wlr_log(WLR_ERROR, "Unable to create presentation");
         return false;
     }
+    startup_end(server->startup, STARTUP_CORE);
 
+    startup_begin(server->startup, STARTUP_SEAT);
     server->seat = sycamore_seat_create(server, server->wl_display, server->output_layout);
     if (!server->seat) {
         wlr_log(WLR_ERROR, "Unable to create sycamore_seat");
         return false;
     }
+    startup_end(server->startup, STARTUP_SEAT);
 
+    startup_begin(server->startup, STARTUP_SCENE);
     server->scene = sycamore_scene_create(server, server->output_layout,
                                           server->presentation);
     if (!server->scene) {
@@ -90,6 +314,19 @@ static bool server_init(struct sycamore_server *server) {
         return false;
     }
 
+    if (server->software_render) {
+        /* Repaint damage only, whatever WLR_SCENE_DEBUG_DAMAGE says */
+        server->scene->wlr_scene->debug_damage_option = WLR_SCENE_DEBUG_DAMAGE_NONE;
+    }
+
+    if (getenv("SYCAMORE_REMOTE_SOCKET")) {
+        /* Never paint a cursor into the streamed buffer: the remote viewer
+         * draws its own, where its pointer is */
+        server->seat->cursor->hidden = true;
+    }
+    startup_end(server->startup, STARTUP_SCENE);
+
+    startup_begin(server->startup, STARTUP_SHELLS);
     server->xdg_shell = sycamore_xdg_shell_create(server, server->wl_display);
     if (!server->xdg_shell) {
         wlr_log(WLR_ERROR, "Unable to create sycamore_xdg_shell");
@@ -102,6 +339,22 @@ static bool server_init(struct sycamore_server *server) {
         return false;
     }
 
+#if WLR_HAS_XWAYLAND
+    /* X11 clients are optional, Wayland ones still get a session */
+    server->xwayland = sycamore_xwayland_create(server, server->wl_display);
+    if (!server->xwayland) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_xwayland, running without X11 support");
+    }
+#endif
+    startup_end(server->startup, STARTUP_SHELLS);
+
+    startup_begin(server->startup, STARTUP_GLOBALS);
+    server->idle_manager = sycamore_idle_manager_create(server, server->wl_display);
+    if (!server->idle_manager) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_idle_manager");
+        return false;
+    }
+
     server->keybinding_manager = sycamore_keybinding_manager_create(server);
     if (!server->keybinding_manager) {
         wlr_log(WLR_ERROR, "Unable to create sycamore_keybinding_manager");
@@ -117,12 +370,32 @@ static bool server_init(struct sycamore_server *server) {
     wlr_gamma_control_manager_v1_create(server->wl_display);
     wlr_xdg_output_manager_v1_create(server->wl_display, server->output_layout);
 
-    server->socket = wl_display_add_socket_auto(server->wl_display);
-    if (!server->socket) {
-        wlr_log(WLR_ERROR, "Unable to open wayland socket");
+    const char *capture_socket = getenv("SYCAMORE_CAPTURE_SOCKET");
+    if (capture_socket) {
+        server->capture_manager = sycamore_capture_manager_create(server, capture_socket);
+        if (!server->capture_manager) {
+            wlr_log(WLR_ERROR, "Unable to create sycamore_capture_manager");
+            return false;
+        }
+    }
+
+    /* Headless sessions have no keyboard to press Logo+Shift+s with. Not
+     * SIGUSR1, Xwayland signals readiness to its parent with it. */
+    server->sigusr2 = wl_event_loop_add_signal(wl_display_get_event_loop(server->wl_display),
+                                               SIGUSR2, handle_sigusr2, server);
+    if (!server->sigusr2) {
+        wlr_log(WLR_ERROR, "Unable to add SIGUSR2 handler");
         return false;
     }
 
+    server->sighup = wl_event_loop_add_signal(wl_display_get_event_loop(server->wl_display),
+                                              SIGHUP, handle_sighup, server);
+    if (!server->sighup) {
+        wlr_log(WLR_ERROR, "Unable to add SIGHUP handler");
+        return false;
+    }
+    startup_end(server->startup, STARTUP_GLOBALS);
+
     return true;
 }
 
@@ -131,6 +404,80 @@ void server_destroy(struct sycamore_server *server) {
         return;
     }
 
+#if WLR_HAS_XWAYLAND
+    /* Unmapping its views needs the client manager and seat */
+    if (server->xwayland) {
+        sycamore_xwayland_destroy(server->xwayland);
+        server->xwayland = NULL;
+    }
+#endif
+
+    /* Nothing may notify it while views and outputs go away */
+    if (server->ipc) {
+        sycamore_ipc_destroy(server->ipc);
+        server->ipc = NULL;
+    }
+
+    /* Views unmapped by wl_display_destroy_clients() below look their
+     * client up, and find none once this is NULL */
+    if (server->client_manager) {
+        sycamore_client_manager_destroy(server->client_manager);
+        server->client_manager = NULL;
+    }
+
+    /* Outputs going away must not trigger layout updates anymore */
+    if (server->output_layout) {
+        wl_list_remove(&server->output_layout_change.link);
+    }
+
+    /* Mirrors hold buffers and textures of outputs, drop them first */
+    if (server->mirror_manager) {
+        sycamore_mirror_manager_destroy(server->mirror_manager);
+        server->mirror_manager = NULL;
+    }
+
+    if (server->output_manager) {
+        sycamore_output_manager_destroy(server->output_manager);
+    }
+
+    /* Views unmapped below update idle inhibition, and find none */
+    if (server->idle_manager) {
+        sycamore_idle_manager_destroy(server->idle_manager);
+        server->idle_manager = NULL;
+    }
+
+    if (server->remote) {
+        sycamore_remote_destroy(server->remote);
+    }
+
+    if (server->capture_manager) {
+        sycamore_capture_manager_destroy(server->capture_manager);
+    }
+
+    if (server->sigusr2) {
+        wl_event_source_remove(server->sigusr2);
+    }
+
+    if (server->sighup) {
+        wl_event_source_remove(server->sighup);
+    }
+
+    if (server->config_watch) {
+        sycamore_config_watch_destroy(server->config_watch);
+    }
+
+    if (server->prefetch) {
+        sycamore_prefetch_destroy(server->prefetch);
+    }
+
+    if (server->launcher) {
+        sycamore_launcher_destroy(server->launcher);
+    }
+
+    if (server->startup) {
+        sycamore_startup_destroy(server->startup);
+    }
+
     if (server->backend) {
         wl_list_remove(&server->backend_new_input.link);
         wl_list_remove(&server->backend_new_output.link);
@@ -163,18 +510,34 @@ void server_destroy(struct sycamore_server *server) {
         sycamore_keybinding_manager_destroy(server->keybinding_manager);
     }
 
+    if (server->stats) {
+        sycamore_stats_destroy(server->stats);
+    }
+
+    if (server->mode_policy) {
+        mode_policy_destroy(server->mode_policy);
+    }
+
+    if (server->config) {
+        sycamore_config_destroy(server->config);
+    }
+
+    for (int i = 0; i < POOLS_ALL; ++i) {
+        pool_finish(&server->pools[i]);
+    }
+
     free(server);
 }
 
 /* Return NULL if create failed */
-struct sycamore_server *server_create() {
+struct sycamore_server *server_create(const char *config_path) {
     struct sycamore_server *server = calloc(1, sizeof(struct sycamore_server));
     if (!server) {
         wlr_log(WLR_ERROR, "Unable to allocate server");
         return NULL;
     }
 
-    if (!server_init(server)) {
+    if (!server_init(server, config_path)) {
         server_destroy(server);
         return NULL;
     }
@@ -187,10 +550,21 @@ bool server_start(struct sycamore_server *server) {
     wlr_log(WLR_INFO, "Starting backend on wayland display '%s'",
             server->socket);
 
+    /* Outputs are announced and modeset from within */
+    startup_begin(server->startup, STARTUP_BACKEND_START);
+    startup_begin(server->startup, STARTUP_FIRST_MODESET);
     if (!wlr_backend_start(server->backend)) {
         wlr_log(WLR_ERROR, "Unable to start backend");
         return false;
     }
+    startup_end(server->startup, STARTUP_BACKEND_START);
+
+    /* The headless backend only announces outputs once started, so the
+     * remote output can't be added any earlier */
+    if (!server_init_remote(server)) {
+        wlr_log(WLR_ERROR, "Unable to create sycamore_remote");
+        return false;
+    }
 
     return true;
 }
@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "sycamore/util/launcher.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+extern char **environ;
+
+/* Set by the compositor after the helper was forked, passed along with
+ * every request */
+static const char *client_env[] = {
+    "WAYLAND_DISPLAY",
+    "DISPLAY",
+    "XCURSOR_THEME",
+    "XCURSOR_SIZE",
+    "SYCAMORE_SOCK",
+};
+
+static pid_t spawn_shell(const char *command) {
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+
+    /* Children start clean: nothing blocked, default handlers, and their
+     * own process group */
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigfillset(&mask);
+    posix_spawnattr_setsigdefault(&attr, &mask);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+                             POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+    pid_t pid;
+    char *argv[] = {"/bin/sh", "-c", (char *)command, NULL};
+    int ret = posix_spawn(&pid, "/bin/sh", NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+
+    if (ret != 0) {
+        wlr_log(WLR_ERROR, "Unable to spawn '%s': %s", command, strerror(ret));
+        return -1;
+    }
+
+    return pid;
+}
+
+static void helper_reap(int signal) {
+    int saved_errno = errno;
+    while (waitpid(-1, NULL, WNOHANG) > 0) {}
+    errno = saved_errno;
+}
+
+static void helper_handle_request(char *request, size_t len) {
+    /* All strings but the last are environment changes */
+    char *command = request;
+    for (char *str = request; str < request + len; str += strlen(str) + 1) {
+        command = str;
+    }
+
+    for (char *str = request; str != command; str += strlen(str) + 1) {
+        char *value = strchr(str, '=');
+        if (value) {
+            *value = '\0';
+            setenv(str, value + 1, true);
+        } else {
+            unsetenv(str);
+        }
+    }
+
+    spawn_shell(command);
+}
+
+/* Everything but the request socket belongs to the compositor */
+static void helper_close_fds(int keep_fd) {
+    DIR *dir = opendir("/proc/self/fd");
+    if (!dir) {
+        return;
+    }
+
+    int dir_fd = dirfd(dir);
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        int fd = atoi(entry->d_name);
+        if (fd > STDERR_FILENO && fd != keep_fd && fd != dir_fd) {
+            close(fd);
+        }
+    }
+
+    closedir(dir);
+}
+
+static _Noreturn void helper_run(int fd) {
+    helper_close_fds(fd);
+
+    struct sigaction action = {
+        .sa_handler = helper_reap,
+        .sa_flags = SA_RESTART | SA_NOCLDSTOP,
+    };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, NULL);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+
+    static char request[LAUNCHER_MAX_REQUEST + 1];
+    for (;;) {
+        ssize_t len = recv(fd, request, LAUNCHER_MAX_REQUEST, 0);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        } else if (len <= 0) {
+            /* The compositor is gone, its children live on */
+            _exit(EXIT_SUCCESS);
+        }
+
+        request[len] = '\0';
+        helper_handle_request(request, len);
+    }
+}
+
+static int handle_sigchld(int signal, void *data) {
+    struct sycamore_launcher *launcher = data;
+
+    if (launcher->pid > 0 && waitpid(launcher->pid, NULL, WNOHANG) == launcher->pid) {
+        wlr_log(WLR_ERROR, "Launcher helper exited, spawning directly from now on");
+        launcher->pid = -1;
+    }
+
+    /* Only reap our own, other children (e.g. Xwayland) are waited for elsewhere */
+    pid_t *pids = launcher->orphans.data;
+    size_t len = launcher->orphans.size / sizeof(pid_t);
+    for (size_t i = 0; i < len;) {
+        if (waitpid(pids[i], NULL, WNOHANG) == pids[i]) {
+            pids[i] = pids[--len];
+        } else {
+            ++i;
+        }
+    }
+    launcher->orphans.size = len * sizeof(pid_t);
+
+    return 0;
+}
+
+static bool launcher_send(struct sycamore_launcher *launcher, const char *command) {
+    char request[LAUNCHER_MAX_REQUEST];
+    size_t len = 0;
+
+    for (size_t i = 0; i < sizeof(client_env) / sizeof(client_env[0]); ++i) {
+        const char *value = getenv(client_env[i]);
+        int n = value ?
+                snprintf(request + len, sizeof(request) - len, "%s=%s", client_env[i], value) :
+                snprintf(request + len, sizeof(request) - len, "%s", client_env[i]);
+        if (n < 0 || (size_t)n >= sizeof(request) - len) {
+            return false;
+        }
+        len += n + 1;
+    }
+
+    size_t command_len = strlen(command) + 1;
+    if (command_len > sizeof(request) - len) {
+        wlr_log(WLR_ERROR, "Command too long for the launcher: '%s'", command);
+        return false;
+    }
+    memcpy(request + len, command, command_len);
+    len += command_len;
+
+    return send(launcher->fd, request, len, MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+bool launcher_spawn(struct sycamore_launcher *launcher, const char *command) {
+    uint64_t start = get_current_time_nsec();
+
+    bool ok = launcher->pid > 0 && launcher_send(launcher, command);
+    if (!ok) {
+        /* posix_spawn shares the address space until exec, no page tables
+         * are copied either way */
+        pid_t pid = spawn_shell(command);
+        pid_t *slot = pid > 0 ? wl_array_add(&launcher->orphans, sizeof(pid_t)) : NULL;
+        if (slot) {
+            *slot = pid;
+        }
+        ok = pid > 0;
+    }
+
+    uint64_t nsec = get_current_time_nsec() - start;
+    launcher->spawns++;
+    launcher->spawn_nsec += nsec;
+    if (nsec > launcher->max_spawn_nsec) {
+        launcher->max_spawn_nsec = nsec;
+    }
+    wlr_log(WLR_DEBUG, "Spawned '%s' in %" PRIu64 " us", command, nsec / 1000);
+
+    return ok;
+}
+
+struct sycamore_launcher *sycamore_launcher_create(struct sycamore_server *server,
+        struct wl_display *display) {
+    struct sycamore_launcher *launcher = calloc(1, sizeof(struct sycamore_launcher));
+    if (!launcher) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_launcher");
+        return NULL;
+    }
+
+    wl_array_init(&launcher->orphans);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to create launcher socket");
+        free(launcher);
+        return NULL;
+    }
+
+    launcher->sigchld = wl_event_loop_add_signal(wl_display_get_event_loop(display),
+                                                 SIGCHLD, handle_sigchld, launcher);
+    if (!launcher->sigchld) {
+        wlr_log(WLR_ERROR, "Unable to add SIGCHLD handler");
+        close(fds[0]);
+        close(fds[1]);
+        free(launcher);
+        return NULL;
+    }
+
+    launcher->pid = fork();
+    if (launcher->pid < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to fork launcher helper");
+        wl_event_source_remove(launcher->sigchld);
+        close(fds[0]);
+        close(fds[1]);
+        free(launcher);
+        return NULL;
+    } else if (launcher->pid == 0) {
+        helper_run(fds[1]);
+    }
+
+    close(fds[1]);
+    launcher->fd = fds[0];
+
+    return launcher;
+}
+
+void sycamore_launcher_destroy(struct sycamore_launcher *launcher) {
+    if (!launcher) {
+        return;
+    }
+
+    /* The helper exits once the socket is closed */
+    close(launcher->fd);
+    if (launcher->pid > 0) {
+        waitpid(launcher->pid, NULL, 0);
+    }
+
+    wl_event_source_remove(launcher->sigchld);
+    wl_array_release(&launcher->orphans);
+    free(launcher);
+}
@@ -0,0 +1,108 @@
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "sycamore/util/pool.h"
+
+#define POOL_SLAB_SIZE 16384
+#define POOL_SLAB_MIN_OBJECTS 8
+
+struct pool_slab {
+    struct wl_list link;    //sycamore_pool::slabs
+    size_t used;
+    alignas(max_align_t) unsigned char objects[];
+};
+
+static size_t pool_align(size_t size) {
+    size_t align = alignof(max_align_t);
+    if (size < sizeof(void *)) {
+        size = sizeof(void *);
+    }
+    return (size + align - 1) & ~(align - 1);
+}
+
+void pool_init(struct sycamore_pool *pool, const char *name, size_t object_size) {
+    pool->name = name;
+    pool->object_size = pool_align(object_size);
+    pool->objects_per_slab = POOL_SLAB_SIZE / pool->object_size;
+    if (pool->objects_per_slab < POOL_SLAB_MIN_OBJECTS) {
+        pool->objects_per_slab = POOL_SLAB_MIN_OBJECTS;
+    }
+
+    wl_list_init(&pool->slabs);
+    pool->free_list = NULL;
+    pool->live = 0;
+    pool->peak = 0;
+    pool->capacity = 0;
+}
+
+void pool_finish(struct sycamore_pool *pool) {
+    if (pool->live) {
+        wlr_log(WLR_ERROR, "pool '%s' finished with %zu live objects",
+                pool->name, pool->live);
+    }
+
+    struct pool_slab *slab, *next;
+    wl_list_for_each_safe(slab, next, &pool->slabs, link) {
+        wl_list_remove(&slab->link);
+        free(slab);
+    }
+
+    pool->free_list = NULL;
+    pool->capacity = 0;
+}
+
+static void *pool_take(struct sycamore_pool *pool) {
+    if (pool->free_list) {
+        void *object = pool->free_list;
+        pool->free_list = *(void **)object;
+        return object;
+    }
+
+    /* The newest slab is at the head of the list, the others are full. */
+    struct pool_slab *slab = NULL;
+    if (!wl_list_empty(&pool->slabs)) {
+        slab = wl_container_of(pool->slabs.next, slab, link);
+    }
+
+    if (!slab || slab->used == pool->objects_per_slab) {
+        slab = malloc(sizeof(struct pool_slab) +
+                      pool->objects_per_slab * pool->object_size);
+        if (!slab) {
+            return NULL;
+        }
+
+        slab->used = 0;
+        wl_list_insert(&pool->slabs, &slab->link);
+        pool->capacity += pool->objects_per_slab;
+    }
+
+    return slab->objects + pool->object_size * slab->used++;
+}
+
+void *pool_alloc(struct sycamore_pool *pool) {
+    void *object = pool_take(pool);
+    if (!object) {
+        wlr_log(WLR_ERROR, "Unable to allocate from pool '%s'", pool->name);
+        return NULL;
+    }
+
+    memset(object, 0, pool->object_size);
+
+    if (++pool->live > pool->peak) {
+        pool->peak = pool->live;
+    }
+
+    return object;
+}
+
+void pool_free(struct sycamore_pool *pool, void *object) {
+    if (!object) {
+        return;
+    }
+
+    *(void **)object = pool->free_list;
+    pool->free_list = object;
+    pool->live--;
+}
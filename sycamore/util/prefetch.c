@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "sycamore/input/cursor.h"
+#include "sycamore/input/keyboard.h"
+#include "sycamore/util/prefetch.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+static void *prefetch_run(void *data) {
+    struct sycamore_prefetch *prefetch = data;
+
+    /* Same theme and size as xcursor_init. The config isn't replaced before
+     * this thread is joined. */
+    const struct sycamore_config *config = prefetch->server->config;
+    prefetch->xcursor_manager = wlr_xcursor_manager_create(config->cursor.theme,
+                                                           config->cursor.size);
+    if (prefetch->xcursor_manager &&
+            !wlr_xcursor_manager_load(prefetch->xcursor_manager, 1.0f)) {
+        wlr_xcursor_manager_destroy(prefetch->xcursor_manager);
+        prefetch->xcursor_manager = NULL;
+    }
+
+    prefetch->keymap = sycamore_keyboard_compile_keymap();
+    prefetch->nsec = get_current_time_nsec() - prefetch->start_nsec;
+
+    char byte = 0;
+    while (write(prefetch->fds[1], &byte, 1) < 0 && errno == EINTR) {}
+
+    return NULL;
+}
+
+static int handle_prefetch_done(int fd, uint32_t mask, void *data) {
+    struct sycamore_prefetch *prefetch = data;
+
+    prefetch_finish(prefetch);
+    return 0;
+}
+
+static void prefetch_join(struct sycamore_prefetch *prefetch) {
+    prefetch->done = true;
+    pthread_join(prefetch->thread, NULL);
+
+    wl_event_source_remove(prefetch->source);
+    prefetch->source = NULL;
+    close(prefetch->fds[0]);
+    close(prefetch->fds[1]);
+}
+
+void prefetch_finish(struct sycamore_prefetch *prefetch) {
+    if (!prefetch || prefetch->done) {
+        return;
+    }
+
+    /* Marked done first, taking the results over calls back into consumers */
+    prefetch_join(prefetch);
+
+    wlr_log(WLR_DEBUG, "Prefetched cursor theme and keymap in %" PRIu64 " us",
+            prefetch->nsec / 1000);
+    startup_record(prefetch->server->startup, STARTUP_PREFETCH, prefetch->start_nsec,
+                   prefetch->start_nsec + prefetch->nsec);
+
+    struct sycamore_seat *seat = prefetch->server->seat;
+    if (!seat) {
+        return;
+    }
+
+    if (prefetch->keymap && !seat->keymap) {
+        seat->keymap = prefetch->keymap;
+        prefetch->keymap = NULL;
+    }
+
+    if (prefetch->xcursor_manager &&
+            cursor_adopt_xcursor_manager(seat->cursor, prefetch->xcursor_manager)) {
+        prefetch->xcursor_manager = NULL;
+    }
+}
+
+struct sycamore_prefetch *sycamore_prefetch_start(struct sycamore_server *server) {
+    struct sycamore_prefetch *prefetch = calloc(1, sizeof(struct sycamore_prefetch));
+    if (!prefetch) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_prefetch");
+        return NULL;
+    }
+
+    prefetch->server = server;
+    prefetch->start_nsec = get_current_time_nsec();
+
+    if (pipe2(prefetch->fds, O_CLOEXEC) < 0) {
+        wlr_log_errno(WLR_ERROR, "Unable to create prefetch pipe");
+        free(prefetch);
+        return NULL;
+    }
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(server->wl_display);
+    prefetch->source = wl_event_loop_add_fd(loop, prefetch->fds[0], WL_EVENT_READABLE,
+                                            handle_prefetch_done, prefetch);
+    if (!prefetch->source) {
+        wlr_log(WLR_ERROR, "Unable to add prefetch event source");
+        close(prefetch->fds[0]);
+        close(prefetch->fds[1]);
+        free(prefetch);
+        return NULL;
+    }
+
+    /* Signals are for the main loop, which turns them into events */
+    sigset_t mask, old_mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, &old_mask);
+    int ret = pthread_create(&prefetch->thread, NULL, prefetch_run, prefetch);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    if (ret != 0) {
+        wlr_log(WLR_ERROR, "Unable to start prefetch thread");
+        wl_event_source_remove(prefetch->source);
+        close(prefetch->fds[0]);
+        close(prefetch->fds[1]);
+        free(prefetch);
+        return NULL;
+    }
+
+    return prefetch;
+}
+
+void sycamore_prefetch_destroy(struct sycamore_prefetch *prefetch) {
+    if (!prefetch) {
+        return;
+    }
+
+    /* Results nobody took are dropped here */
+    if (!prefetch->done) {
+        prefetch_join(prefetch);
+    }
+
+    if (prefetch->xcursor_manager) {
+        wlr_xcursor_manager_destroy(prefetch->xcursor_manager);
+    }
+    if (prefetch->keymap) {
+        xkb_keymap_unref(prefetch->keymap);
+    }
+
+    free(prefetch);
+}
@@ -0,0 +1,205 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "sycamore/util/startup.h"
+#include "sycamore/util/time.h"
+
+static const char *phase_names[STARTUP_PHASES_ALL] = {
+    [STARTUP_BACKEND] = "backend",
+    [STARTUP_RENDERER] = "renderer",
+    [STARTUP_ALLOCATOR] = "allocator",
+    [STARTUP_CORE] = "core",
+    [STARTUP_SEAT] = "seat",
+    [STARTUP_SCENE] = "scene",
+    [STARTUP_SHELLS] = "shells",
+    [STARTUP_GLOBALS] = "globals",
+    [STARTUP_SOCKET] = "socket",
+    [STARTUP_BACKEND_START] = "backend_start",
+    [STARTUP_FIRST_MODESET] = "first_modeset",
+    [STARTUP_FIRST_FRAME] = "first_frame",
+    [STARTUP_PREFETCH] = "prefetch",
+};
+
+void startup_begin(struct sycamore_startup *startup, enum startup_phase phase) {
+    if (startup->reported) {
+        return;
+    }
+
+    startup->spans[phase].start_nsec = get_current_time_nsec();
+}
+
+void startup_end(struct sycamore_startup *startup, enum startup_phase phase) {
+    struct startup_span *span = &startup->spans[phase];
+    if (startup->reported || !span->start_nsec || span->end_nsec) {
+        return;
+    }
+
+    span->end_nsec = get_current_time_nsec();
+}
+
+void startup_record(struct sycamore_startup *startup, enum startup_phase phase,
+        uint64_t start_nsec, uint64_t end_nsec) {
+    if (startup->reported) {
+        return;
+    }
+
+    startup->spans[phase].start_nsec = start_nsec;
+    startup->spans[phase].end_nsec = end_nsec;
+}
+
+static bool startup_write_trace(struct sycamore_startup *startup, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        wlr_log(WLR_ERROR, "Unable to open startup trace %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    /* Complete events in microseconds. The prefetch thread gets its own track. */
+    fprintf(f, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (int i = 0; i < STARTUP_PHASES_ALL; ++i) {
+        struct startup_span *span = &startup->spans[i];
+        if (!span->end_nsec) {
+            continue;
+        }
+
+        fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":%d,"
+                "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n",
+                phase_names[i], getpid(), i == STARTUP_PREFETCH ? 2 : 1,
+                (span->start_nsec - startup->origin_nsec) / 1000.0,
+                (span->end_nsec - span->start_nsec) / 1000.0);
+        first = false;
+    }
+    fprintf(f, "\n]}\n");
+
+    if (fclose(f) != 0) {
+        wlr_log(WLR_ERROR, "Unable to write startup trace %s", path);
+        return false;
+    }
+
+    return true;
+}
+
+static void startup_output_destroy(struct startup_output *output) {
+    wl_list_remove(&output->link);
+    wl_list_remove(&output->commit.link);
+    wl_list_remove(&output->present.link);
+    wl_list_remove(&output->destroy.link);
+    free(output);
+}
+
+static void startup_report(struct sycamore_startup *startup) {
+    startup->reported = true;
+
+    struct startup_output *output, *next;
+    wl_list_for_each_safe(output, next, &startup->outputs, link) {
+        startup_output_destroy(output);
+    }
+
+    uint64_t end = startup->spans[STARTUP_FIRST_FRAME].end_nsec;
+    wlr_log(WLR_INFO, "Startup took %.1f ms to the first frame",
+            (end - startup->origin_nsec) / 1000000.0);
+    wlr_log(WLR_INFO, "%-16s %10s %10s", "phase", "start(ms)", "took(ms)");
+    for (int i = 0; i < STARTUP_PHASES_ALL; ++i) {
+        struct startup_span *span = &startup->spans[i];
+        if (!span->end_nsec) {
+            continue;
+        }
+
+        wlr_log(WLR_INFO, "%-16s %10.2f %10.2f", phase_names[i],
+                (span->start_nsec - startup->origin_nsec) / 1000000.0,
+                (span->end_nsec - span->start_nsec) / 1000000.0);
+    }
+
+    const char *trace_path = getenv("SYCAMORE_STARTUP_TRACE");
+    if (trace_path && startup_write_trace(startup, trace_path)) {
+        wlr_log(WLR_INFO, "Startup trace written to %s", trace_path);
+    }
+}
+
+static void handle_output_commit(struct wl_listener *listener, void *data) {
+    struct startup_output *output = wl_container_of(listener, output, commit);
+    struct wlr_output_event_commit *event = data;
+    struct sycamore_startup *startup = output->startup;
+
+    /* Headless outputs have their mode from the start, their first frame
+     * counts as the modeset */
+    if (event->committed & (WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_ENABLED |
+                            WLR_OUTPUT_STATE_BUFFER)) {
+        if (!startup->spans[STARTUP_FIRST_MODESET].end_nsec) {
+            startup_end(startup, STARTUP_FIRST_MODESET);
+            startup_begin(startup, STARTUP_FIRST_FRAME);
+        }
+    }
+}
+
+static void handle_output_present(struct wl_listener *listener, void *data) {
+    struct startup_output *output = wl_container_of(listener, output, present);
+    struct wlr_output_event_present *event = data;
+    struct sycamore_startup *startup = output->startup;
+
+    if (!event->presented || !startup->spans[STARTUP_FIRST_FRAME].start_nsec) {
+        return;
+    }
+
+    startup_end(startup, STARTUP_FIRST_FRAME);
+    startup_report(startup);
+}
+
+static void handle_output_destroy(struct wl_listener *listener, void *data) {
+    struct startup_output *output = wl_container_of(listener, output, destroy);
+
+    startup_output_destroy(output);
+}
+
+void startup_watch_output(struct sycamore_startup *startup, struct wlr_output *wlr_output) {
+    if (startup->reported) {
+        return;
+    }
+
+    struct startup_output *output = calloc(1, sizeof(struct startup_output));
+    if (!output) {
+        wlr_log(WLR_ERROR, "Unable to allocate startup_output");
+        return;
+    }
+
+    output->startup = startup;
+    output->commit.notify = handle_output_commit;
+    wl_signal_add(&wlr_output->events.commit, &output->commit);
+    output->present.notify = handle_output_present;
+    wl_signal_add(&wlr_output->events.present, &output->present);
+    output->destroy.notify = handle_output_destroy;
+    wl_signal_add(&wlr_output->events.destroy, &output->destroy);
+
+    wl_list_insert(&startup->outputs, &output->link);
+}
+
+struct sycamore_startup *sycamore_startup_create() {
+    struct sycamore_startup *startup = calloc(1, sizeof(struct sycamore_startup));
+    if (!startup) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_startup");
+        return NULL;
+    }
+
+    startup->origin_nsec = get_current_time_nsec();
+    wl_list_init(&startup->outputs);
+
+    return startup;
+}
+
+void sycamore_startup_destroy(struct sycamore_startup *startup) {
+    if (!startup) {
+        return;
+    }
+
+    struct startup_output *output, *next;
+    wl_list_for_each_safe(output, next, &startup->outputs, link) {
+        startup_output_destroy(output);
+    }
+
+    free(startup);
+}
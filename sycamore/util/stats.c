@@ -0,0 +1,218 @@
+#include <inttypes.h>
+#include <pixman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_damage_ring.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+#include "sycamore/output/output.h"
+#include "sycamore/util/stats.h"
+#include "sycamore/util/time.h"
+#include "sycamore/server.h"
+
+static const char *damage_mode_names[DAMAGE_MODE_ALL] = {
+    [DAMAGE_MODE_OFF] = "off",
+    [DAMAGE_MODE_RECORD] = "record",
+    [DAMAGE_MODE_HIGHLIGHT] = "highlight",
+};
+
+void stats_record_damage(struct sycamore_stats *stats, struct wlr_scene_output *scene_output) {
+    if (!stats || stats->damage_mode == DAMAGE_MODE_OFF) {
+        return;
+    }
+
+    pixman_region32_t *damage = &scene_output->damage_ring.current;
+    if (!pixman_region32_not_empty(damage)) {
+        return;
+    }
+
+    struct stats_frame *frame = &stats->frames[stats->frames_head];
+    stats->frames_head = (stats->frames_head + 1) % STATS_RING_SIZE;
+    if (stats->frames_len < STATS_RING_SIZE) {
+        stats->frames_len++;
+    }
+
+    int rects_len;
+    pixman_box32_t *rects = pixman_region32_rectangles(damage, &rects_len);
+
+    /* Rectangles of a pixman region never overlap */
+    frame->damage_area = 0;
+    for (int i = 0; i < rects_len; ++i) {
+        frame->damage_area += (uint64_t)(rects[i].x2 - rects[i].x1) * (rects[i].y2 - rects[i].y1);
+    }
+
+    struct wlr_output *output = scene_output->output;
+    snprintf(frame->output, sizeof(frame->output), "%s", output->name);
+    frame->msec = get_current_time_msec();
+    frame->damage_rects = rects_len;
+    frame->full_damage = frame->damage_area >= (uint64_t)output->width * output->height;
+}
+
+void stats_record_render(struct stats_render_cost *cost, bool rendered, uint64_t nsec) {
+    cost->frames++;
+    cost->rendered += rendered;
+    cost->nsec += nsec;
+    if (nsec > cost->max_nsec) {
+        cost->max_nsec = nsec;
+    }
+    if (nsec > cost->ipc_max_nsec) {
+        cost->ipc_max_nsec = nsec;
+    }
+}
+
+void stats_cycle_damage_mode(struct sycamore_server *server) {
+    struct sycamore_stats *stats = server->stats;
+    stats->damage_mode = (stats->damage_mode + 1) % DAMAGE_MODE_ALL;
+    if (stats->damage_mode == DAMAGE_MODE_RECORD) {
+        stats->frames_head = 0;
+        stats->frames_len = 0;
+    }
+
+    struct wlr_scene *scene = server->scene->wlr_scene;
+    scene->debug_damage_option = stats->damage_mode == DAMAGE_MODE_HIGHLIGHT ?
+            WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT : WLR_SCENE_DEBUG_DAMAGE_NONE;
+
+    /* Repaint everything, so that highlights appear or go away at once */
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        struct wlr_scene_output *scene_output =
+                wlr_scene_get_scene_output(scene, output->wlr_output);
+        if (scene_output) {
+            wlr_damage_ring_add_whole(&scene_output->damage_ring);
+        }
+        wlr_output_schedule_frame(output->wlr_output);
+    }
+
+    wlr_log(WLR_INFO, "Damage mode: %s", damage_mode_names[stats->damage_mode]);
+}
+
+static void stats_dump_pools(struct sycamore_server *server) {
+    wlr_log(WLR_INFO, "%-16s %8s %8s %8s %8s", "pool", "live", "peak", "capacity", "size");
+    for (int i = 0; i < POOLS_ALL; ++i) {
+        struct sycamore_pool *pool = &server->pools[i];
+        wlr_log(WLR_INFO, "%-16s %8zu %8zu %8zu %8zu", pool->name,
+                pool->live, pool->peak, pool->capacity, pool->object_size);
+    }
+}
+
+static void stats_dump_clients(struct sycamore_server *server) {
+    wlr_log(WLR_INFO, "%-8s %6s %8s %10s %12s %10s %8s %10s %10s %10s", "client",
+            "views", "surfaces", "shm(KiB)", "dmabuf(KiB)", "commits/s", "frames",
+            "deferred", "load(us/s)", "total(ms)");
+
+    struct sycamore_client *client;
+    wl_list_for_each(client, &server->client_manager->clients, link) {
+        const char *state = "";
+        if (client->throttled) {
+            state = " throttled";
+        } else if (client->over_budget) {
+            state = " over budget";
+        } else if (client->over_limit) {
+            state = " over limit";
+        }
+
+        wlr_log(WLR_INFO, "%-8d %6zu %8zu %10zu %12zu %10u %8zu %10" PRIu64
+                " %10u %10" PRIu64 "%s", client->pid, client->views,
+                client->surfaces_len, client->shm_bytes / 1024,
+                client->dmabuf_bytes / 1024, client->commit_rate,
+                client_frames_pending(client), client->deferred_commits,
+                client->dispatch_load_usec, client->dispatch_nsec / 1000000, state);
+    }
+}
+
+static void stats_dump_render(struct sycamore_server *server) {
+    wlr_log(WLR_INFO, "%-16s %8s %8s %10s %10s %8s", "output", "frames", "rendered",
+            "avg(us)", "max(us)", "load(%)");
+
+    uint64_t now = get_current_time_nsec();
+    struct sycamore_output *output;
+    wl_list_for_each(output, &server->all_outputs, link) {
+        struct stats_render_cost *cost = &output->render_cost;
+        uint64_t elapsed = now - cost->since_nsec;
+
+        wlr_log(WLR_INFO, "%-16s %8" PRIu64 " %8" PRIu64 " %10" PRIu64 " %10" PRIu64 " %8.2f",
+                output->wlr_output->name, cost->frames, cost->rendered,
+                cost->frames ? cost->nsec / cost->frames / 1000 : 0, cost->max_nsec / 1000,
+                elapsed ? 100.0 * cost->nsec / elapsed : 0.0);
+
+        /* Each dump covers the interval since the previous one */
+        *cost = (struct stats_render_cost){
+            .since_nsec = now,
+            .ipc_max_nsec = cost->ipc_max_nsec,
+        };
+    }
+}
+
+static void stats_dump_damage(struct sycamore_stats *stats) {
+    if (stats->frames_len == 0) {
+        return;
+    }
+
+    wlr_log(WLR_INFO, "%-16s %8s %8s %14s %10s", "output", "frames", "full",
+            "area/frame", "rects/frame");
+
+    /* Summarize the ring per output, first seen first */
+    bool done[STATS_RING_SIZE] = {0};
+    size_t start = (stats->frames_head + STATS_RING_SIZE - stats->frames_len) % STATS_RING_SIZE;
+    for (size_t i = 0; i < stats->frames_len; ++i) {
+        size_t index = (start + i) % STATS_RING_SIZE;
+        if (done[index]) {
+            continue;
+        }
+
+        const char *name = stats->frames[index].output;
+        uint64_t frames = 0, full = 0, area = 0, rects = 0;
+        for (size_t j = i; j < stats->frames_len; ++j) {
+            size_t other = (start + j) % STATS_RING_SIZE;
+            struct stats_frame *frame = &stats->frames[other];
+            if (done[other] || strcmp(frame->output, name) != 0) {
+                continue;
+            }
+
+            done[other] = true;
+            frames++;
+            full += frame->full_damage;
+            area += frame->damage_area;
+            rects += frame->damage_rects;
+        }
+
+        wlr_log(WLR_INFO, "%-16s %8" PRIu64 " %8" PRIu64 " %14" PRIu64 " %10.1f",
+                name, frames, full, area / frames, (double)rects / frames);
+    }
+}
+
+static void stats_dump_launcher(struct sycamore_launcher *launcher) {
+    wlr_log(WLR_INFO, "%-16s %8s %10s %10s", "launcher", "spawns", "avg(us)", "max(us)");
+    wlr_log(WLR_INFO, "%-16s %8" PRIu64 " %10" PRIu64 " %10" PRIu64,
+            launcher->pid > 0 ? "helper" : "direct", launcher->spawns,
+            launcher->spawns ? launcher->spawn_nsec / launcher->spawns / 1000 : 0,
+            launcher->max_spawn_nsec / 1000);
+}
+
+void stats_dump(struct sycamore_server *server) {
+    wlr_log(WLR_INFO, "Sycamore stats:");
+    stats_dump_pools(server);
+    stats_dump_clients(server);
+    stats_dump_render(server);
+    stats_dump_damage(server->stats);
+    stats_dump_launcher(server->launcher);
+}
+
+void sycamore_stats_destroy(struct sycamore_stats *stats) {
+    if (!stats) {
+        return;
+    }
+
+    free(stats);
+}
+
+struct sycamore_stats *sycamore_stats_create() {
+    struct sycamore_stats *stats = calloc(1, sizeof(struct sycamore_stats));
+    if (!stats) {
+        wlr_log(WLR_ERROR, "Unable to allocate sycamore_stats");
+        return NULL;
+    }
+
+    return stats;
+}
@@ -0,0 +1,238 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "sycamore/ipc_protocol.h"
+
+/* sycamore-msg: queries the compositor over its IPC socket, or follows
+ * events, printing every reply as one line of JSON. */
+
+static const struct {
+    const char *name;
+    uint32_t type;
+} queries[] = {
+    {"views", IPC_MSG_GET_VIEWS},
+    {"outputs", IPC_MSG_GET_OUTPUTS},
+    {"seats", IPC_MSG_GET_SEATS},
+    {"stats", IPC_MSG_GET_STATS},
+};
+
+static const struct {
+    const char *name;
+    uint32_t events;
+} subscriptions[] = {
+    {"focus", IPC_SUBSCRIBE_FOCUS},
+    {"views", IPC_SUBSCRIBE_VIEWS},
+    {"outputs", IPC_SUBSCRIBE_OUTPUTS},
+    {"frame-stats", IPC_SUBSCRIBE_FRAME_STATS},
+    {"all", IPC_SUBSCRIBE_ALL},
+};
+
+static bool read_full(int fd, void *data, size_t len) {
+    char *dst = data;
+    while (len > 0) {
+        ssize_t n = read(fd, dst, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        dst += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+static bool ipc_send(int fd, uint32_t type, const void *body, size_t len) {
+    char msg[sizeof(struct ipc_msg_header) + sizeof(struct ipc_add_virtual_output)];
+    struct ipc_msg_header header = {
+        .type = type,
+        .length = len,
+    };
+    memcpy(msg, &header, sizeof(header));
+    if (len) {
+        memcpy(msg + sizeof(header), body, len);
+    }
+
+    return send(fd, msg, sizeof(header) + len, MSG_NOSIGNAL) ==
+           (ssize_t)(sizeof(header) + len);
+}
+
+/* Print one message, return its type or 0 once the socket is closed */
+static uint32_t ipc_print(int fd) {
+    struct ipc_msg_header header;
+    if (!read_full(fd, &header, sizeof(header))) {
+        return 0;
+    }
+
+    char *body = malloc(header.length + 1);
+    if (!body || !read_full(fd, body, header.length)) {
+        free(body);
+        return 0;
+    }
+    body[header.length] = '\0';
+
+    printf("%s\n", body);
+    fflush(stdout);
+    free(body);
+    return header.type;
+}
+
+static uint32_t parse_events(const char *list) {
+    uint32_t events = 0;
+    char *copy = strdup(list);
+    char *save = NULL;
+    for (char *name = strtok_r(copy, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        size_t i;
+        for (i = 0; i < sizeof(subscriptions) / sizeof(subscriptions[0]); ++i) {
+            if (strcmp(name, subscriptions[i].name) == 0) {
+                events |= subscriptions[i].events;
+                break;
+            }
+        }
+        if (i == sizeof(subscriptions) / sizeof(subscriptions[0])) {
+            fprintf(stderr, "Unknown event '%s'\n", name);
+            events = 0;
+            break;
+        }
+    }
+
+    free(copy);
+    return events;
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s [options] views|outputs|seats|stats\n"
+           "       %s [options] subscribe EVENTS\n"
+           "       %s [options] add-virtual-output WIDTHxHEIGHT[@HZ][+X,Y]\n"
+           "       %s [options] remove-virtual-output NAME\n"
+           "  -s SOCKET   socket path (default: $SYCAMORE_SOCK)\n"
+           "  EVENTS      comma separated: focus, views, outputs, frame-stats or all\n",
+           name, name, name, name);
+}
+
+int main(int argc, char **argv) {
+    const char *socket_path = getenv("SYCAMORE_SOCK");
+
+    int c;
+    while ((c = getopt(argc, argv, "s:h")) != -1) {
+        switch (c) {
+            case 's':
+                socket_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+        }
+    }
+
+    if (optind >= argc || !socket_path) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t type = 0, events = 0;
+    struct ipc_add_virtual_output add = {0};
+    struct ipc_remove_virtual_output remove_output = {0};
+    if (strcmp(argv[optind], "subscribe") == 0) {
+        if (optind + 1 >= argc || !(events = parse_events(argv[optind + 1]))) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        type = IPC_MSG_SUBSCRIBE;
+    } else if (strcmp(argv[optind], "add-virtual-output") == 0) {
+        /* The compositor checks the spec itself */
+        if (optind + 1 >= argc || strlen(argv[optind + 1]) >= sizeof(add.spec)) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        strcpy(add.spec, argv[optind + 1]);
+        type = IPC_MSG_ADD_VIRTUAL_OUTPUT;
+    } else if (strcmp(argv[optind], "remove-virtual-output") == 0) {
+        if (optind + 1 >= argc || strlen(argv[optind + 1]) >= sizeof(remove_output.name)) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        strcpy(remove_output.name, argv[optind + 1]);
+        type = IPC_MSG_REMOVE_VIRTUAL_OUTPUT;
+    } else {
+        for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); ++i) {
+            if (strcmp(argv[optind], queries[i].name) == 0) {
+                type = queries[i].type;
+            }
+        }
+        if (!type) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long\n");
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Unable to connect to %s: %s\n", socket_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    /* Its reply comes first and isn't printed */
+    struct ipc_set_format format = {
+        .format = IPC_FORMAT_JSON,
+    };
+    struct ipc_msg_header header;
+    char reply[64];
+    if (!ipc_send(fd, IPC_MSG_SET_FORMAT, &format, sizeof(format)) ||
+            !read_full(fd, &header, sizeof(header)) || header.length > sizeof(reply) ||
+            !read_full(fd, reply, header.length)) {
+        fprintf(stderr, "Unable to set the JSON format\n");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    bool sent;
+    if (type == IPC_MSG_SUBSCRIBE) {
+        struct ipc_subscribe subscribe = {
+            .events = events,
+        };
+        sent = ipc_send(fd, type, &subscribe, sizeof(subscribe));
+    } else if (type == IPC_MSG_ADD_VIRTUAL_OUTPUT) {
+        sent = ipc_send(fd, type, &add, sizeof(add));
+    } else if (type == IPC_MSG_REMOVE_VIRTUAL_OUTPUT) {
+        sent = ipc_send(fd, type, &remove_output, sizeof(remove_output));
+    } else {
+        sent = ipc_send(fd, type, NULL, 0);
+    }
+
+    if (!sent) {
+        fprintf(stderr, "Unable to send the request\n");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    int ret = EXIT_FAILURE;
+    if (type == IPC_MSG_SUBSCRIBE) {
+        /* Until the compositor goes away */
+        while (ipc_print(fd)) {}
+        ret = EXIT_SUCCESS;
+    } else if (ipc_print(fd) == type) {
+        ret = EXIT_SUCCESS;
+    }
+
+    close(fd);
+    return ret;
+}
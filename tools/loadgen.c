@@ -0,0 +1,1067 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "wlr-layer-shell-unstable-v1-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+#ifdef LOADGEN_HAS_GBM
+#include <fcntl.h>
+#include <gbm.h>
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+#endif
+
+/* sycamore-loadgen: a synthetic Wayland client which creates many
+ * toplevels, popups and layer surfaces and commits them at a fixed rate,
+ * measuring round-trip and frame-callback latencies of the compositor. */
+
+#define LOADGEN_RENDER_NODE "/dev/dri/renderD128"
+
+enum loadgen_buffer_type {
+    LOADGEN_BUFFER_SHM,
+    LOADGEN_BUFFER_DMABUF,
+};
+
+enum loadgen_role {
+    LOADGEN_ROLE_TOPLEVEL,
+    LOADGEN_ROLE_POPUP,
+    LOADGEN_ROLE_LAYER,
+};
+
+enum loadgen_action {
+    LOADGEN_ACTION_MAXIMIZE,
+    LOADGEN_ACTION_UNMAXIMIZE,
+    LOADGEN_ACTION_FULLSCREEN,
+    LOADGEN_ACTION_UNFULLSCREEN,
+    LOADGEN_ACTION_MOVE,
+    LOADGEN_ACTION_RESIZE,
+    LOADGEN_ACTIONS_ALL,
+};
+
+struct loadgen_options {
+    int toplevels;
+    int popups;     // per toplevel
+    int layers;
+    int width, height;
+    double commit_rate;
+    int duration;
+    int action_interval;
+    bool vary_size;
+    bool ignore_frame_callbacks;
+    enum loadgen_buffer_type buffer_type;
+};
+
+struct latency_samples {
+    double *values;    // milliseconds
+    size_t len, cap;
+};
+
+struct loadgen_buffer {
+    struct wl_buffer *wl_buffer;
+    void *data;
+    size_t size;
+    int width, height, stride;
+    bool busy;
+#ifdef LOADGEN_HAS_GBM
+    struct gbm_bo *bo;
+#endif
+};
+
+struct loadgen_surface {
+    struct wl_list link;    //loadgen::surfaces
+    enum loadgen_role role;
+
+    struct wl_surface *wl_surface;
+    struct xdg_surface *xdg_surface;
+    struct xdg_toplevel *xdg_toplevel;
+    struct xdg_popup *xdg_popup;
+    struct zwlr_layer_surface_v1 *layer_surface;
+
+    bool configured;
+    bool closed;
+    bool popups_spawned;
+    int width, height;  // 0 means "choose yourself"
+
+    struct loadgen_buffer buffers[2];
+    struct wl_callback *frame_callback;
+    struct timespec frame_requested;
+
+    uint32_t commits;
+    enum loadgen_action next_action;
+
+    struct loadgen_surface *parent;
+    struct loadgen *loadgen;
+};
+
+struct loadgen {
+    struct loadgen_options options;
+
+    struct wl_display *display;
+    struct wl_registry *registry;
+    struct wl_compositor *compositor;
+    struct wl_shm *shm;
+    struct wl_seat *seat;
+    struct xdg_wm_base *wm_base;
+    struct zwlr_layer_shell_v1 *layer_shell;
+#ifdef LOADGEN_HAS_GBM
+    struct zwp_linux_dmabuf_v1 *linux_dmabuf;
+    struct gbm_device *gbm;
+    int drm_fd;
+#endif
+
+    struct wl_list surfaces;
+
+    struct wl_callback *sync_callback;
+    struct timespec sync_sent;
+
+    struct latency_samples roundtrip;
+    struct latency_samples frame;
+
+    uint64_t commits;
+    uint64_t skipped_frame_pending;
+    uint64_t skipped_buffer_busy;
+    uint64_t actions;
+
+    bool running;
+};
+
+static double timespec_diff_msec(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 +
+           (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void latency_samples_add(struct latency_samples *samples, double value) {
+    if (samples->len == samples->cap) {
+        size_t cap = samples->cap ? samples->cap * 2 : 1024;
+        double *values = realloc(samples->values, cap * sizeof(double));
+        if (!values) {
+            return;
+        }
+        samples->values = values;
+        samples->cap = cap;
+    }
+
+    samples->values[samples->len++] = value;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void latency_samples_report(struct latency_samples *samples, const char *name) {
+    if (samples->len == 0) {
+        printf("%-16s n=0\n", name);
+        return;
+    }
+
+    qsort(samples->values, samples->len, sizeof(double), compare_double);
+
+    double sum = 0;
+    for (size_t i = 0; i < samples->len; ++i) {
+        sum += samples->values[i];
+    }
+
+    printf("%-16s n=%zu min=%.3f avg=%.3f p50=%.3f p99=%.3f max=%.3f (ms)\n",
+           name, samples->len, samples->values[0], sum / samples->len,
+           samples->values[samples->len / 2],
+           samples->values[(size_t)(samples->len * 0.99)],
+           samples->values[samples->len - 1]);
+}
+
+/* buffers */
+static void handle_buffer_release(void *data, struct wl_buffer *wl_buffer) {
+    struct loadgen_buffer *buffer = data;
+    buffer->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+    .release = handle_buffer_release,
+};
+
+static void buffer_finish(struct loadgen_buffer *buffer) {
+    if (buffer->wl_buffer) {
+        wl_buffer_destroy(buffer->wl_buffer);
+    }
+
+#ifdef LOADGEN_HAS_GBM
+    if (buffer->bo) {
+        gbm_bo_destroy(buffer->bo);
+    } else
+#endif
+    if (buffer->data) {
+        munmap(buffer->data, buffer->size);
+    }
+
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+static bool buffer_init_shm(struct loadgen *loadgen, struct loadgen_buffer *buffer,
+        int width, int height) {
+    int stride = width * 4;
+    size_t size = (size_t)stride * height;
+
+    int fd = memfd_create("sycamore-loadgen", MFD_CLOEXEC);
+    if (fd < 0) {
+        perror("memfd_create");
+        return false;
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return false;
+    }
+
+    struct wl_shm_pool *pool = wl_shm_create_pool(loadgen->shm, fd, size);
+    buffer->wl_buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+                                                  stride, WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+
+    buffer->data = data;
+    buffer->size = size;
+    buffer->stride = stride;
+    return true;
+}
+
+#ifdef LOADGEN_HAS_GBM
+static bool buffer_init_dmabuf(struct loadgen *loadgen, struct loadgen_buffer *buffer,
+        int width, int height) {
+    buffer->bo = gbm_bo_create(loadgen->gbm, width, height, GBM_FORMAT_XRGB8888,
+                               GBM_BO_USE_RENDERING | GBM_BO_USE_LINEAR);
+    if (!buffer->bo) {
+        fprintf(stderr, "Unable to create gbm_bo %dx%d\n", width, height);
+        return false;
+    }
+
+    int fd = gbm_bo_get_fd(buffer->bo);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to export gbm_bo\n");
+        gbm_bo_destroy(buffer->bo);
+        buffer->bo = NULL;
+        return false;
+    }
+
+    uint64_t modifier = gbm_bo_get_modifier(buffer->bo);
+    buffer->stride = gbm_bo_get_stride(buffer->bo);
+
+    struct zwp_linux_buffer_params_v1 *params =
+            zwp_linux_dmabuf_v1_create_params(loadgen->linux_dmabuf);
+    zwp_linux_buffer_params_v1_add(params, fd, 0, 0, buffer->stride,
+                                   modifier >> 32, modifier & 0xffffffff);
+    buffer->wl_buffer = zwp_linux_buffer_params_v1_create_immed(params,
+            width, height, GBM_FORMAT_XRGB8888, 0);
+    zwp_linux_buffer_params_v1_destroy(params);
+    close(fd);
+
+    return true;
+}
+#endif
+
+static bool buffer_init(struct loadgen *loadgen, struct loadgen_buffer *buffer,
+        int width, int height) {
+    bool success = false;
+    switch (loadgen->options.buffer_type) {
+        case LOADGEN_BUFFER_SHM:
+            success = buffer_init_shm(loadgen, buffer, width, height);
+            break;
+        case LOADGEN_BUFFER_DMABUF:
+#ifdef LOADGEN_HAS_GBM
+            success = buffer_init_dmabuf(loadgen, buffer, width, height);
+#endif
+            break;
+    }
+
+    if (!success) {
+        return false;
+    }
+
+    buffer->width = width;
+    buffer->height = height;
+    buffer->busy = false;
+    wl_buffer_add_listener(buffer->wl_buffer, &buffer_listener, buffer);
+    return true;
+}
+
+static void buffer_paint(struct loadgen_buffer *buffer, uint32_t seed) {
+    uint32_t color = 0xff000000 | ((seed * 2654435761u) & 0x00ffffff);
+    uint8_t *data = buffer->data;
+    int stride = buffer->stride;
+
+#ifdef LOADGEN_HAS_GBM
+    void *map_data = NULL;
+    if (buffer->bo) {
+        uint32_t map_stride;
+        data = gbm_bo_map(buffer->bo, 0, 0, buffer->width, buffer->height,
+                          GBM_BO_TRANSFER_WRITE, &map_stride, &map_data);
+        if (!data) {
+            return;
+        }
+        stride = map_stride;
+    }
+#endif
+
+    for (int y = 0; y < buffer->height; ++y) {
+        uint32_t *row = (uint32_t *)(data + (size_t)y * stride);
+        for (int x = 0; x < buffer->width; ++x) {
+            row[x] = color;
+        }
+    }
+
+#ifdef LOADGEN_HAS_GBM
+    if (buffer->bo) {
+        gbm_bo_unmap(buffer->bo, map_data);
+    }
+#endif
+}
+
+/* Return a free buffer of the given size, or NULL if both are busy. */
+static struct loadgen_buffer *surface_next_buffer(struct loadgen_surface *surface,
+        int width, int height) {
+    for (int i = 0; i < 2; ++i) {
+        struct loadgen_buffer *buffer = &surface->buffers[i];
+        if (buffer->busy) {
+            continue;
+        }
+
+        if (buffer->wl_buffer &&
+            (buffer->width != width || buffer->height != height)) {
+            buffer_finish(buffer);
+        }
+
+        if (!buffer->wl_buffer &&
+            !buffer_init(surface->loadgen, buffer, width, height)) {
+            return NULL;
+        }
+
+        return buffer;
+    }
+
+    return NULL;
+}
+
+/* surfaces */
+static void surface_spawn_popups(struct loadgen_surface *parent);
+
+static void handle_frame_done(void *data, struct wl_callback *callback, uint32_t time) {
+    struct loadgen_surface *surface = data;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    latency_samples_add(&surface->loadgen->frame,
+                        timespec_diff_msec(&surface->frame_requested, &now));
+
+    wl_callback_destroy(callback);
+    surface->frame_callback = NULL;
+}
+
+static const struct wl_callback_listener frame_listener = {
+    .done = handle_frame_done,
+};
+
+static void toplevel_request_action(struct loadgen_surface *surface) {
+    struct loadgen *loadgen = surface->loadgen;
+    struct xdg_toplevel *toplevel = surface->xdg_toplevel;
+
+    switch (surface->next_action) {
+        case LOADGEN_ACTION_MAXIMIZE:
+            xdg_toplevel_set_maximized(toplevel);
+            break;
+        case LOADGEN_ACTION_UNMAXIMIZE:
+            xdg_toplevel_unset_maximized(toplevel);
+            break;
+        case LOADGEN_ACTION_FULLSCREEN:
+            xdg_toplevel_set_fullscreen(toplevel, NULL);
+            break;
+        case LOADGEN_ACTION_UNFULLSCREEN:
+            xdg_toplevel_unset_fullscreen(toplevel);
+            break;
+        case LOADGEN_ACTION_MOVE:
+            /* Grabs started without a serial end on the next button release. */
+            if (loadgen->seat) {
+                xdg_toplevel_move(toplevel, loadgen->seat, 0);
+            }
+            break;
+        case LOADGEN_ACTION_RESIZE:
+            if (loadgen->seat) {
+                xdg_toplevel_resize(toplevel, loadgen->seat, 0,
+                                    XDG_TOPLEVEL_RESIZE_EDGE_BOTTOM_RIGHT);
+            }
+            break;
+        default:
+            break;
+    }
+
+    surface->next_action = (surface->next_action + 1) % LOADGEN_ACTIONS_ALL;
+    loadgen->actions++;
+}
+
+static void surface_get_size(struct loadgen_surface *surface, int *width, int *height) {
+    struct loadgen_options *options = &surface->loadgen->options;
+
+    int w = surface->width, h = surface->height;
+    if (w <= 0 || h <= 0) {
+        switch (surface->role) {
+            case LOADGEN_ROLE_TOPLEVEL:
+                w = options->width;
+                h = options->height;
+                break;
+            case LOADGEN_ROLE_POPUP:
+            case LOADGEN_ROLE_LAYER:
+                w = options->width / 4;
+                h = options->height / 4;
+                break;
+        }
+    }
+
+    /* Cycle through 8 sizes to exercise buffer reallocation and resizing. */
+    if (options->vary_size && surface->role == LOADGEN_ROLE_TOPLEVEL) {
+        int step = surface->commits % 8;
+        w -= step * w / 16;
+        h -= step * h / 16;
+    }
+
+    *width = w > 0 ? w : 1;
+    *height = h > 0 ? h : 1;
+}
+
+static void surface_commit(struct loadgen_surface *surface) {
+    struct loadgen *loadgen = surface->loadgen;
+    if (!surface->configured || surface->closed) {
+        return;
+    }
+
+    if (surface->frame_callback && !loadgen->options.ignore_frame_callbacks) {
+        loadgen->skipped_frame_pending++;
+        return;
+    }
+
+    int width, height;
+    surface_get_size(surface, &width, &height);
+
+    struct loadgen_buffer *buffer = surface_next_buffer(surface, width, height);
+    if (!buffer) {
+        loadgen->skipped_buffer_busy++;
+        return;
+    }
+
+    buffer_paint(buffer, surface->commits);
+    wl_surface_attach(surface->wl_surface, buffer->wl_buffer, 0, 0);
+    /* damage_buffer is new in v4. Buffers are at scale 1 and untransformed,
+     * so surface damage covers the same area. */
+    if (wl_surface_get_version(surface->wl_surface) >= WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION) {
+        wl_surface_damage_buffer(surface->wl_surface, 0, 0, width, height);
+    } else {
+        wl_surface_damage(surface->wl_surface, 0, 0, width, height);
+    }
+    buffer->busy = true;
+
+    if (!surface->frame_callback) {
+        surface->frame_callback = wl_surface_frame(surface->wl_surface);
+        wl_callback_add_listener(surface->frame_callback, &frame_listener, surface);
+        clock_gettime(CLOCK_MONOTONIC, &surface->frame_requested);
+    }
+
+    wl_surface_commit(surface->wl_surface);
+    surface->commits++;
+    loadgen->commits++;
+
+    if (surface->role != LOADGEN_ROLE_TOPLEVEL) {
+        return;
+    }
+
+    /* Popups need a mapped parent. */
+    if (!surface->popups_spawned) {
+        surface->popups_spawned = true;
+        surface_spawn_popups(surface);
+    }
+
+    int interval = loadgen->options.action_interval;
+    if (interval > 0 && surface->commits % interval == 0) {
+        toplevel_request_action(surface);
+    }
+}
+
+static void handle_xdg_surface_configure(void *data,
+        struct xdg_surface *xdg_surface, uint32_t serial) {
+    struct loadgen_surface *surface = data;
+
+    xdg_surface_ack_configure(xdg_surface, serial);
+
+    bool first = !surface->configured;
+    surface->configured = true;
+    if (first) {
+        surface_commit(surface);
+    }
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+    .configure = handle_xdg_surface_configure,
+};
+
+static void handle_xdg_toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+        int32_t width, int32_t height, struct wl_array *states) {
+    struct loadgen_surface *surface = data;
+    surface->width = width;
+    surface->height = height;
+}
+
+static void handle_xdg_toplevel_close(void *data, struct xdg_toplevel *toplevel) {
+    struct loadgen_surface *surface = data;
+    surface->closed = true;
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+    .configure = handle_xdg_toplevel_configure,
+    .close = handle_xdg_toplevel_close,
+};
+
+static void handle_xdg_popup_configure(void *data, struct xdg_popup *popup,
+        int32_t x, int32_t y, int32_t width, int32_t height) {
+    struct loadgen_surface *surface = data;
+    surface->width = width;
+    surface->height = height;
+}
+
+static void handle_xdg_popup_done(void *data, struct xdg_popup *popup) {
+    struct loadgen_surface *surface = data;
+    surface->closed = true;
+}
+
+static void handle_xdg_popup_repositioned(void *data, struct xdg_popup *popup,
+        uint32_t token) {
+    /* No-op */
+}
+
+static const struct xdg_popup_listener xdg_popup_listener = {
+    .configure = handle_xdg_popup_configure,
+    .popup_done = handle_xdg_popup_done,
+    .repositioned = handle_xdg_popup_repositioned,
+};
+
+static void handle_layer_surface_configure(void *data,
+        struct zwlr_layer_surface_v1 *layer_surface,
+        uint32_t serial, uint32_t width, uint32_t height) {
+    struct loadgen_surface *surface = data;
+
+    zwlr_layer_surface_v1_ack_configure(layer_surface, serial);
+    surface->width = width;
+    surface->height = height;
+
+    bool first = !surface->configured;
+    surface->configured = true;
+    if (first) {
+        surface_commit(surface);
+    }
+}
+
+static void handle_layer_surface_closed(void *data,
+        struct zwlr_layer_surface_v1 *layer_surface) {
+    struct loadgen_surface *surface = data;
+    surface->closed = true;
+}
+
+static const struct zwlr_layer_surface_v1_listener layer_surface_listener = {
+    .configure = handle_layer_surface_configure,
+    .closed = handle_layer_surface_closed,
+};
+
+static struct loadgen_surface *surface_create(struct loadgen *loadgen,
+        enum loadgen_role role, struct loadgen_surface *parent) {
+    struct loadgen_surface *surface = calloc(1, sizeof(struct loadgen_surface));
+    if (!surface) {
+        return NULL;
+    }
+
+    surface->loadgen = loadgen;
+    surface->role = role;
+    surface->parent = parent;
+    surface->wl_surface = wl_compositor_create_surface(loadgen->compositor);
+    wl_list_insert(loadgen->surfaces.prev, &surface->link);
+
+    return surface;
+}
+
+static void surface_destroy(struct loadgen_surface *surface) {
+    if (surface->frame_callback) {
+        wl_callback_destroy(surface->frame_callback);
+    }
+
+    if (surface->xdg_toplevel) {
+        xdg_toplevel_destroy(surface->xdg_toplevel);
+    }
+
+    if (surface->xdg_popup) {
+        xdg_popup_destroy(surface->xdg_popup);
+    }
+
+    if (surface->xdg_surface) {
+        xdg_surface_destroy(surface->xdg_surface);
+    }
+
+    if (surface->layer_surface) {
+        zwlr_layer_surface_v1_destroy(surface->layer_surface);
+    }
+
+    wl_surface_destroy(surface->wl_surface);
+
+    for (int i = 0; i < 2; ++i) {
+        buffer_finish(&surface->buffers[i]);
+    }
+
+    wl_list_remove(&surface->link);
+    free(surface);
+}
+
+static void toplevel_create(struct loadgen *loadgen, int index) {
+    struct loadgen_surface *surface =
+            surface_create(loadgen, LOADGEN_ROLE_TOPLEVEL, NULL);
+    if (!surface) {
+        return;
+    }
+
+    surface->xdg_surface = xdg_wm_base_get_xdg_surface(loadgen->wm_base,
+                                                       surface->wl_surface);
+    xdg_surface_add_listener(surface->xdg_surface, &xdg_surface_listener, surface);
+    surface->xdg_toplevel = xdg_surface_get_toplevel(surface->xdg_surface);
+    xdg_toplevel_add_listener(surface->xdg_toplevel, &xdg_toplevel_listener, surface);
+
+    char title[32];
+    snprintf(title, sizeof(title), "loadgen-%d", index);
+    xdg_toplevel_set_title(surface->xdg_toplevel, title);
+    xdg_toplevel_set_app_id(surface->xdg_toplevel, "sycamore-loadgen");
+
+    wl_surface_commit(surface->wl_surface);
+}
+
+static void surface_spawn_popups(struct loadgen_surface *parent) {
+    struct loadgen *loadgen = parent->loadgen;
+    struct loadgen_options *options = &loadgen->options;
+
+    for (int i = 0; i < options->popups; ++i) {
+        struct loadgen_surface *surface =
+                surface_create(loadgen, LOADGEN_ROLE_POPUP, parent);
+        if (!surface) {
+            return;
+        }
+
+        struct xdg_positioner *positioner = xdg_wm_base_create_positioner(loadgen->wm_base);
+        xdg_positioner_set_size(positioner, options->width / 4, options->height / 4);
+        xdg_positioner_set_anchor_rect(positioner, 0, 0, options->width, options->height);
+        xdg_positioner_set_anchor(positioner, XDG_POSITIONER_ANCHOR_TOP_LEFT);
+        xdg_positioner_set_gravity(positioner, XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT);
+        xdg_positioner_set_offset(positioner, 16 * i, 16 * i);
+
+        surface->xdg_surface = xdg_wm_base_get_xdg_surface(loadgen->wm_base,
+                                                           surface->wl_surface);
+        xdg_surface_add_listener(surface->xdg_surface, &xdg_surface_listener, surface);
+        surface->xdg_popup = xdg_surface_get_popup(surface->xdg_surface,
+                                                   parent->xdg_surface, positioner);
+        xdg_popup_add_listener(surface->xdg_popup, &xdg_popup_listener, surface);
+        xdg_positioner_destroy(positioner);
+
+        wl_surface_commit(surface->wl_surface);
+    }
+}
+
+static void layer_create(struct loadgen *loadgen, int index) {
+    static const uint32_t anchors[] = {
+        ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP | ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT,
+        ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP | ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT,
+        ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM | ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT,
+        ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM | ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT,
+    };
+
+    struct loadgen_surface *surface =
+            surface_create(loadgen, LOADGEN_ROLE_LAYER, NULL);
+    if (!surface) {
+        return;
+    }
+
+    surface->layer_surface = zwlr_layer_shell_v1_get_layer_surface(
+            loadgen->layer_shell, surface->wl_surface, NULL,
+            ZWLR_LAYER_SHELL_V1_LAYER_TOP, "sycamore-loadgen");
+    zwlr_layer_surface_v1_add_listener(surface->layer_surface,
+                                       &layer_surface_listener, surface);
+    zwlr_layer_surface_v1_set_size(surface->layer_surface,
+                                   loadgen->options.width / 4, loadgen->options.height / 4);
+    zwlr_layer_surface_v1_set_anchor(surface->layer_surface, anchors[index % 4]);
+
+    wl_surface_commit(surface->wl_surface);
+}
+
+/* globals */
+static void handle_wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial) {
+    xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+    .ping = handle_wm_base_ping,
+};
+
+static void handle_registry_global(void *data, struct wl_registry *registry,
+        uint32_t name, const char *interface, uint32_t version) {
+    struct loadgen *loadgen = data;
+
+    if (strcmp(interface, wl_compositor_interface.name) == 0) {
+        loadgen->compositor = wl_registry_bind(registry, name, &wl_compositor_interface,
+                                               version < 4 ? version : 4);
+    } else if (strcmp(interface, wl_shm_interface.name) == 0) {
+        loadgen->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+    } else if (strcmp(interface, wl_seat_interface.name) == 0 && !loadgen->seat) {
+        loadgen->seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+    } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+        loadgen->wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface,
+                                            version < 3 ? version : 3);
+        xdg_wm_base_add_listener(loadgen->wm_base, &wm_base_listener, loadgen);
+    } else if (strcmp(interface, zwlr_layer_shell_v1_interface.name) == 0) {
+        loadgen->layer_shell = wl_registry_bind(registry, name,
+                                                &zwlr_layer_shell_v1_interface, 1);
+    }
+#ifdef LOADGEN_HAS_GBM
+    else if (strcmp(interface, zwp_linux_dmabuf_v1_interface.name) == 0 && version >= 2) {
+        loadgen->linux_dmabuf = wl_registry_bind(registry, name,
+                                                 &zwp_linux_dmabuf_v1_interface, 2);
+    }
+#endif
+}
+
+static void handle_registry_global_remove(void *data, struct wl_registry *registry,
+        uint32_t name) {
+    /* No-op */
+}
+
+static const struct wl_registry_listener registry_listener = {
+    .global = handle_registry_global,
+    .global_remove = handle_registry_global_remove,
+};
+
+static void handle_sync_done(void *data, struct wl_callback *callback, uint32_t serial) {
+    struct loadgen *loadgen = data;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    latency_samples_add(&loadgen->roundtrip,
+                        timespec_diff_msec(&loadgen->sync_sent, &now));
+
+    wl_callback_destroy(callback);
+    loadgen->sync_callback = NULL;
+}
+
+static const struct wl_callback_listener sync_listener = {
+    .done = handle_sync_done,
+};
+
+static void loadgen_send_sync(struct loadgen *loadgen) {
+    if (loadgen->sync_callback) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &loadgen->sync_sent);
+    loadgen->sync_callback = wl_display_sync(loadgen->display);
+    wl_callback_add_listener(loadgen->sync_callback, &sync_listener, loadgen);
+}
+
+static bool loadgen_check_globals(struct loadgen *loadgen) {
+    if (!loadgen->compositor || !loadgen->shm || !loadgen->wm_base) {
+        fprintf(stderr, "Compositor lacks wl_compositor, wl_shm or xdg_wm_base\n");
+        return false;
+    }
+
+    if (loadgen->options.layers > 0 && !loadgen->layer_shell) {
+        fprintf(stderr, "Compositor lacks zwlr_layer_shell_v1\n");
+        return false;
+    }
+
+    if (loadgen->options.buffer_type == LOADGEN_BUFFER_DMABUF) {
+#ifdef LOADGEN_HAS_GBM
+        if (!loadgen->linux_dmabuf) {
+            fprintf(stderr, "Compositor lacks zwp_linux_dmabuf_v1\n");
+            return false;
+        }
+
+        loadgen->drm_fd = open(LOADGEN_RENDER_NODE, O_RDWR | O_CLOEXEC);
+        if (loadgen->drm_fd < 0) {
+            perror("open " LOADGEN_RENDER_NODE);
+            return false;
+        }
+
+        loadgen->gbm = gbm_create_device(loadgen->drm_fd);
+        if (!loadgen->gbm) {
+            fprintf(stderr, "Unable to create gbm_device\n");
+            return false;
+        }
+#else
+        fprintf(stderr, "sycamore-loadgen was built without dmabuf support\n");
+        return false;
+#endif
+    }
+
+    return true;
+}
+
+static void loadgen_report(struct loadgen *loadgen, double elapsed_sec) {
+    struct loadgen_options *options = &loadgen->options;
+
+    printf("sycamore-loadgen: %d toplevels, %d popups each, %d layers, %s %dx%d "
+           "@ %.1f Hz for %.1f s\n",
+           options->toplevels, options->popups, options->layers,
+           options->buffer_type == LOADGEN_BUFFER_SHM ? "shm" : "dmabuf",
+           options->width, options->height, options->commit_rate, elapsed_sec);
+    printf("commits: %" PRIu64 " (%.1f/s), skipped waiting for frame: %" PRIu64
+           ", skipped no free buffer: %" PRIu64 ", actions: %" PRIu64 "\n",
+           loadgen->commits, loadgen->commits / elapsed_sec,
+           loadgen->skipped_frame_pending, loadgen->skipped_buffer_busy,
+           loadgen->actions);
+
+    latency_samples_report(&loadgen->roundtrip, "round-trip");
+    latency_samples_report(&loadgen->frame, "frame-callback");
+}
+
+static void loadgen_tick(struct loadgen *loadgen) {
+    struct loadgen_surface *surface;
+    wl_list_for_each(surface, &loadgen->surfaces, link) {
+        surface_commit(surface);
+    }
+
+    loadgen_send_sync(loadgen);
+}
+
+static int loadgen_run(struct loadgen *loadgen) {
+    struct loadgen_options *options = &loadgen->options;
+
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer_fd < 0) {
+        perror("timerfd_create");
+        return EXIT_FAILURE;
+    }
+
+    long interval_nsec = (long)(1000000000.0 / options->commit_rate);
+    struct itimerspec spec = {
+        .it_interval = { interval_nsec / 1000000000, interval_nsec % 1000000000 },
+        .it_value = { interval_nsec / 1000000000, interval_nsec % 1000000000 },
+    };
+    timerfd_settime(timer_fd, 0, &spec, NULL);
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct pollfd fds[] = {
+        { .fd = wl_display_get_fd(loadgen->display), .events = POLLIN },
+        { .fd = timer_fd, .events = POLLIN },
+    };
+
+    loadgen->running = true;
+    while (loadgen->running) {
+        while (wl_display_prepare_read(loadgen->display) != 0) {
+            wl_display_dispatch_pending(loadgen->display);
+        }
+
+        if (wl_display_flush(loadgen->display) < 0 && errno != EAGAIN) {
+            wl_display_cancel_read(loadgen->display);
+            break;
+        }
+
+        if (poll(fds, 2, -1) < 0) {
+            wl_display_cancel_read(loadgen->display);
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            if (wl_display_read_events(loadgen->display) < 0) {
+                break;
+            }
+        } else {
+            wl_display_cancel_read(loadgen->display);
+        }
+
+        if (wl_display_dispatch_pending(loadgen->display) < 0) {
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+                loadgen_tick(loadgen);
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (timespec_diff_msec(&start, &now) >= options->duration * 1000.0) {
+            loadgen->running = false;
+        }
+    }
+
+    close(timer_fd);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    loadgen_report(loadgen, timespec_diff_msec(&start, &now) / 1000.0);
+
+    int error = wl_display_get_error(loadgen->display);
+    if (error) {
+        fprintf(stderr, "Wayland connection error: %s\n", strerror(error));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s [options]\n"
+           "  -t N        number of xdg toplevels (default 4)\n"
+           "  -p N        popups per toplevel (default 0)\n"
+           "  -l N        number of layer surfaces (default 0)\n"
+           "  -s WxH      toplevel buffer size (default 640x480)\n"
+           "  -r HZ       commit rate per surface (default 60)\n"
+           "  -d SECONDS  duration (default 10)\n"
+           "  -b TYPE     buffer type: shm or dmabuf (default shm)\n"
+           "  -a N        request move/resize/maximize/fullscreen every N commits\n"
+           "  -v          vary buffer sizes between commits\n"
+           "  -f          don't wait for frame callbacks before committing\n",
+           name);
+}
+
+int main(int argc, char **argv) {
+    struct loadgen loadgen = {
+        .options = {
+            .toplevels = 4,
+            .popups = 0,
+            .layers = 0,
+            .width = 640,
+            .height = 480,
+            .commit_rate = 60.0,
+            .duration = 10,
+            .action_interval = 0,
+            .vary_size = false,
+            .ignore_frame_callbacks = false,
+            .buffer_type = LOADGEN_BUFFER_SHM,
+        },
+    };
+    struct loadgen_options *options = &loadgen.options;
+
+    int c;
+    while ((c = getopt(argc, argv, "t:p:l:s:r:d:b:a:vfh")) != -1) {
+        switch (c) {
+            case 't':
+                options->toplevels = atoi(optarg);
+                break;
+            case 'p':
+                options->popups = atoi(optarg);
+                break;
+            case 'l':
+                options->layers = atoi(optarg);
+                break;
+            case 's':
+                if (sscanf(optarg, "%dx%d", &options->width, &options->height) != 2) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                options->commit_rate = atof(optarg);
+                break;
+            case 'd':
+                options->duration = atoi(optarg);
+                break;
+            case 'b':
+                if (strcmp(optarg, "shm") == 0) {
+                    options->buffer_type = LOADGEN_BUFFER_SHM;
+                } else if (strcmp(optarg, "dmabuf") == 0) {
+                    options->buffer_type = LOADGEN_BUFFER_DMABUF;
+                } else {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'a':
+                options->action_interval = atoi(optarg);
+                break;
+            case 'v':
+                options->vary_size = true;
+                break;
+            case 'f':
+                options->ignore_frame_callbacks = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+        }
+    }
+
+    if (options->commit_rate <= 0 || options->width <= 0 || options->height <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    wl_list_init(&loadgen.surfaces);
+
+    loadgen.display = wl_display_connect(NULL);
+    if (!loadgen.display) {
+        fprintf(stderr, "Unable to connect to the compositor\n");
+        return EXIT_FAILURE;
+    }
+
+    loadgen.registry = wl_display_get_registry(loadgen.display);
+    wl_registry_add_listener(loadgen.registry, &registry_listener, &loadgen);
+    wl_display_roundtrip(loadgen.display);
+
+    if (!loadgen_check_globals(&loadgen)) {
+        wl_display_disconnect(loadgen.display);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < options->toplevels; ++i) {
+        toplevel_create(&loadgen, i);
+    }
+
+    for (int i = 0; i < options->layers; ++i) {
+        layer_create(&loadgen, i);
+    }
+
+    int ret = loadgen_run(&loadgen);
+
+    /* Popups were created after their parents, destroy them first. */
+    struct loadgen_surface *surface, *prev;
+    wl_list_for_each_reverse_safe(surface, prev, &loadgen.surfaces, link) {
+        surface_destroy(surface);
+    }
+
+    if (loadgen.sync_callback) {
+        wl_callback_destroy(loadgen.sync_callback);
+    }
+
+#ifdef LOADGEN_HAS_GBM
+    if (loadgen.gbm) {
+        gbm_device_destroy(loadgen.gbm);
+        close(loadgen.drm_fd);
+    }
+#endif
+
+    wl_display_disconnect(loadgen.display);
+
+    free(loadgen.roundtrip.values);
+    free(loadgen.frame.values);
+
+    return ret;
+}
@@ -0,0 +1,350 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/backend/headless.h>
+#include <wlr/types/wlr_input_device.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_presentation_time.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+#include "sycamore/desktop/view.h"
+#include "sycamore/input/keybinding.h"
+#include "sycamore/input/seat.h"
+#include "sycamore/output/scene.h"
+#include "sycamore/server.h"
+
+/* sycamore-microbench: measures isolated hot functions of libsycamore.
+ *
+ * Allocations are counted by wrapping malloc/calloc/realloc at link time,
+ * so only allocations made by libsycamore and this file are seen, not
+ * those made inside wlroots or libwayland. */
+
+#define BENCH_MIN_NSEC 200000000L
+#define BENCH_BATCH 256
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static uint64_t allocations = 0;
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    allocations++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+typedef void (*bench_op)(void *data, uint64_t i);
+
+struct bench {
+    struct wl_display *display;
+    struct wlr_backend *backend;
+    struct sycamore_server *server;
+
+    struct sycamore_view **views;
+    size_t views_len;
+};
+
+static uint64_t now_nsec() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void bench_run(const char *name, size_t n, bench_op op, void *data) {
+    /* Warm up */
+    for (uint64_t i = 0; i < BENCH_BATCH; ++i) {
+        op(data, i);
+    }
+
+    uint64_t iterations = 0;
+    uint64_t allocations_start = allocations;
+    uint64_t start = now_nsec(), elapsed;
+    do {
+        for (int i = 0; i < BENCH_BATCH; ++i) {
+            op(data, iterations++);
+        }
+        elapsed = now_nsec() - start;
+    } while (elapsed < BENCH_MIN_NSEC);
+
+    printf("%-28s %8zu %12.1f %12.3f\n", name, n,
+           (double)elapsed / iterations,
+           (double)(allocations - allocations_start) / iterations);
+}
+
+/* handle_keybinding */
+struct keybinding_bench {
+    struct sycamore_keybinding_manager *manager;
+    uint32_t modifiers;
+    xkb_keysym_t hit, miss;
+};
+
+static void noop_action(struct sycamore_server *server,
+        struct sycamore_keybinding *keybinding) {}
+
+static void keybinding_hit_op(void *data, uint64_t i) {
+    struct keybinding_bench *bench = data;
+    handle_keybinding(bench->manager, bench->modifiers, bench->hit);
+}
+
+static void keybinding_miss_op(void *data, uint64_t i) {
+    struct keybinding_bench *bench = data;
+    handle_keybinding(bench->manager, bench->modifiers, bench->miss);
+}
+
+static void bench_keybinding(struct bench *bench, size_t n) {
+    static const uint32_t modifiers[] = {
+        WLR_MODIFIER_LOGO,
+        WLR_MODIFIER_LOGO | WLR_MODIFIER_SHIFT,
+        WLR_MODIFIER_CTRL | WLR_MODIFIER_ALT,
+        WLR_MODIFIER_ALT,
+    };
+
+    struct keybinding_bench data = {
+        .manager = sycamore_keybinding_manager_create(bench->server),
+        .modifiers = modifiers[0],
+    };
+    if (!data.manager) {
+        return;
+    }
+
+    /* Bindings are prepended, so the first one added is the slowest to find. */
+    for (size_t i = 0; i < n; ++i) {
+        sycamore_keybinding_manager_add(data.manager, modifiers[i % 4],
+                                        XKB_KEY_F1 + i / 4, noop_action);
+    }
+    data.hit = XKB_KEY_F1;
+    data.miss = XKB_KEY_F1 + n;
+
+    bench_run("handle_keybinding/hit", n, keybinding_hit_op, &data);
+    bench_run("handle_keybinding/miss", n, keybinding_miss_op, &data);
+
+    sycamore_keybinding_manager_destroy(data.manager);
+}
+
+/* surface_under, view_under and view_set_focus */
+static void bench_view_set_activated(struct sycamore_view *view, bool activated) {}
+
+static const struct view_interface bench_view_interface = {
+    .set_activated = bench_view_set_activated,
+};
+
+static void bench_views_create(struct bench *bench, size_t n) {
+    struct sycamore_server *server = bench->server;
+
+    bench->views = calloc(n, sizeof(struct sycamore_view *));
+    bench->views_len = n;
+
+    /* Stack views diagonally so that (0, 0) only hits the bottom-most one. */
+    for (size_t i = 0; i < n; ++i) {
+        struct sycamore_view *view = calloc(1, sizeof(struct sycamore_view));
+        view_init(view, NULL, &bench_view_interface, server);
+
+        view->scene_tree = wlr_scene_tree_create(server->scene->trees.shell_view);
+        view->scene_tree->node.data = view;
+        struct wlr_scene_buffer *buffer = wlr_scene_buffer_create(view->scene_tree, NULL);
+        wlr_scene_buffer_set_dest_size(buffer, 640, 480);
+
+        view_move_to(view, i, i);
+        view->mapped = true;
+        wl_list_insert(&server->mapped_views, &view->link);
+
+        bench->views[i] = view;
+    }
+}
+
+static void bench_views_destroy(struct bench *bench) {
+    struct sycamore_server *server = bench->server;
+    if (server->focused_view.view) {
+        view_ptr_disconnect(&server->focused_view);
+    }
+
+    for (size_t i = 0; i < bench->views_len; ++i) {
+        struct sycamore_view *view = bench->views[i];
+        wl_list_remove(&view->link);
+        wlr_scene_node_destroy(&view->scene_tree->node);
+        free(view);
+    }
+
+    free(bench->views);
+    bench->views = NULL;
+    bench->views_len = 0;
+}
+
+static void surface_under_op(void *data, uint64_t i) {
+    struct bench *bench = data;
+    double sx, sy;
+    surface_under(bench->server->scene, 0, 0, &sx, &sy);
+}
+
+static void view_under_op(void *data, uint64_t i) {
+    struct bench *bench = data;
+    view_under(bench->server->scene, 0, 0);
+}
+
+static void view_set_focus_op(void *data, uint64_t i) {
+    struct bench *bench = data;
+    view_set_focus(bench->views[i % bench->views_len]);
+}
+
+static void bench_views(struct bench *bench, size_t n) {
+    bench_views_create(bench, n);
+
+    bench_run("surface_under", n, surface_under_op, bench);
+    bench_run("view_under", n, view_under_op, bench);
+    if (n > 1) {
+        bench_run("view_set_focus", n, view_set_focus_op, bench);
+    }
+
+    bench_views_destroy(bench);
+}
+
+/* seat_update_capabilities */
+static void seat_update_capabilities_op(void *data, uint64_t i) {
+    struct bench *bench = data;
+    seat_update_capabilities(bench->server->seat);
+}
+
+static void bench_seat_devices(struct bench *bench, size_t n) {
+    static const enum wlr_input_device_type types[] = {
+        WLR_INPUT_DEVICE_KEYBOARD,
+        WLR_INPUT_DEVICE_POINTER,
+        WLR_INPUT_DEVICE_TOUCH,
+        WLR_INPUT_DEVICE_SWITCH,
+    };
+
+    struct sycamore_seat *seat = bench->server->seat;
+    struct wlr_input_device *wlr_devices = calloc(n, sizeof(struct wlr_input_device));
+    struct sycamore_seat_device *devices = calloc(n, sizeof(struct sycamore_seat_device));
+
+    for (size_t i = 0; i < n; ++i) {
+        wlr_devices[i].type = types[i % 4];
+        devices[i].wlr_device = &wlr_devices[i];
+        devices[i].seat = seat;
+        wl_list_insert(&seat->devices, &devices[i].link);
+    }
+
+    bench_run("seat_update_capabilities", n, seat_update_capabilities_op, bench);
+
+    for (size_t i = 0; i < n; ++i) {
+        wl_list_remove(&devices[i].link);
+    }
+
+    free(devices);
+    free(wlr_devices);
+}
+
+static bool bench_init(struct bench *bench) {
+    bench->display = wl_display_create();
+    if (!bench->display) {
+        return false;
+    }
+
+    bench->backend = wlr_headless_backend_create(bench->display);
+    if (!bench->backend) {
+        return false;
+    }
+
+    struct sycamore_server *server = calloc(1, sizeof(struct sycamore_server));
+    if (!server) {
+        return false;
+    }
+    bench->server = server;
+
+    /* The defaults, as with no config file. The seat and keybindings read it. */
+    server->config = sycamore_config_load(NULL);
+    if (!server->config) {
+        return false;
+    }
+
+    wl_list_init(&server->all_outputs);
+    wl_list_init(&server->mapped_views);
+    server->wl_display = bench->display;
+    server->backend = bench->backend;
+    server->output_layout = wlr_output_layout_create();
+    server->presentation = wlr_presentation_create(bench->display, bench->backend);
+    server->seat = sycamore_seat_create(server, bench->display, server->output_layout);
+    server->scene = sycamore_scene_create(server, server->output_layout,
+                                          server->presentation);
+
+    return server->output_layout && server->presentation &&
+           server->seat && server->scene;
+}
+
+static void bench_finish(struct bench *bench) {
+    struct sycamore_server *server = bench->server;
+    if (server) {
+        if (server->scene) {
+            wlr_scene_node_destroy(&server->scene->wlr_scene->tree.node);
+            sycamore_scene_destroy(server->scene);
+        }
+
+        sycamore_seat_destroy(server->seat);
+
+        if (server->output_layout) {
+            wlr_output_layout_destroy(server->output_layout);
+        }
+
+        if (server->config) {
+            sycamore_config_destroy(server->config);
+        }
+
+        free(server);
+    }
+
+    if (bench->backend) {
+        wlr_backend_destroy(bench->backend);
+    }
+
+    if (bench->display) {
+        wl_display_destroy(bench->display);
+    }
+}
+
+int main(int argc, char **argv) {
+    wlr_log_init(WLR_ERROR, NULL);
+
+    size_t default_sizes[] = {1, 16, 256, 4096};
+    size_t sizes_len = argc > 1 ? (size_t)argc - 1 : 4;
+    size_t *sizes = default_sizes;
+    if (argc > 1) {
+        sizes = calloc(sizes_len, sizeof(size_t));
+        for (size_t i = 0; i < sizes_len; ++i) {
+            sizes[i] = strtoul(argv[i + 1], NULL, 10);
+        }
+    }
+
+    struct bench bench = {0};
+    if (!bench_init(&bench)) {
+        fprintf(stderr, "Unable to initialize benchmark environment\n");
+        bench_finish(&bench);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-28s %8s %12s %12s\n", "benchmark", "n", "ns/op", "allocs/op");
+    for (size_t i = 0; i < sizes_len; ++i) {
+        bench_keybinding(&bench, sizes[i]);
+        bench_views(&bench, sizes[i]);
+        bench_seat_devices(&bench, sizes[i]);
+    }
+
+    bench_finish(&bench);
+
+    if (sizes != default_sizes) {
+        free(sizes);
+    }
+
+    return EXIT_SUCCESS;
+}
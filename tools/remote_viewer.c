@@ -0,0 +1,374 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "sycamore/output/remote_protocol.h"
+
+/* sycamore-remote-viewer: a stand-in for the VDI viewer. It connects to the
+ * socket of a remote output, decodes the tiles it streams into a local
+ * framebuffer, acks frames and can inject input, reporting what it got.
+ * The framebuffer can be saved as a PPM to check it against the session. */
+
+#define BTN_LEFT 0x110
+
+struct viewer_options {
+    const char *socket_path;
+    const char *output_path;
+    int frames;
+    int ack_delay_msec;
+    int click_x, click_y;
+    int keycode;
+    bool verbose;
+};
+
+struct viewer {
+    struct viewer_options options;
+    int fd;
+
+    uint32_t *fb;
+    uint32_t width, height;
+
+    uint64_t frames, tiles, raw_tiles, bytes;
+    uint64_t frame_tiles, frame_bytes;
+    bool input_sent;
+};
+
+static uint64_t now_msec() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static bool read_full(int fd, void *data, size_t len) {
+    char *dst = data;
+    while (len > 0) {
+        ssize_t n = read(fd, dst, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        dst += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+static bool viewer_send(struct viewer *viewer, uint32_t type, const void *body, size_t len) {
+    char msg[sizeof(struct remote_msg_header) + 16];
+    struct remote_msg_header header = {
+        .type = type,
+        .length = len,
+    };
+    memcpy(msg, &header, sizeof(header));
+    memcpy(msg + sizeof(header), body, len);
+
+    return send(viewer->fd, msg, sizeof(header) + len, MSG_NOSIGNAL) ==
+           (ssize_t)(sizeof(header) + len);
+}
+
+static void viewer_send_input(struct viewer *viewer) {
+    struct viewer_options *options = &viewer->options;
+
+    if (options->click_x >= 0) {
+        struct remote_pointer_motion motion = {
+            .x = options->click_x,
+            .y = options->click_y,
+        };
+        viewer_send(viewer, REMOTE_MSG_POINTER_MOTION, &motion, sizeof(motion));
+
+        struct remote_pointer_button button = {
+            .button = BTN_LEFT,
+            .pressed = 1,
+        };
+        viewer_send(viewer, REMOTE_MSG_POINTER_BUTTON, &button, sizeof(button));
+        button.pressed = 0;
+        viewer_send(viewer, REMOTE_MSG_POINTER_BUTTON, &button, sizeof(button));
+    }
+
+    if (options->keycode >= 0) {
+        struct remote_key key = {
+            .keycode = options->keycode,
+            .pressed = 1,
+        };
+        viewer_send(viewer, REMOTE_MSG_KEY, &key, sizeof(key));
+        key.pressed = 0;
+        viewer_send(viewer, REMOTE_MSG_KEY, &key, sizeof(key));
+    }
+}
+
+static bool viewer_hello(struct viewer *viewer, const struct remote_hello *hello) {
+    if (hello->version != REMOTE_PROTOCOL_VERSION) {
+        fprintf(stderr, "Unsupported protocol version %u\n", hello->version);
+        return false;
+    }
+
+    free(viewer->fb);
+    viewer->fb = calloc((size_t)hello->width * hello->height, sizeof(uint32_t));
+    if (!viewer->fb) {
+        fprintf(stderr, "Unable to allocate %ux%u framebuffer\n", hello->width, hello->height);
+        return false;
+    }
+
+    viewer->width = hello->width;
+    viewer->height = hello->height;
+    printf("output %ux%u, %u pixel tiles\n", hello->width, hello->height, hello->tile_size);
+    return true;
+}
+
+static bool viewer_tile(struct viewer *viewer, const struct remote_tile *tile,
+        const uint32_t *payload, size_t payload_len) {
+    if (!viewer->fb || tile->x + tile->width > viewer->width ||
+            tile->y + tile->height > viewer->height) {
+        fprintf(stderr, "Tile out of bounds\n");
+        return false;
+    }
+
+    size_t len = (size_t)tile->width * tile->height, i = 0, p = 0;
+    if (tile->encoding == REMOTE_TILE_RAW) {
+        if (payload_len < len) {
+            return false;
+        }
+        for (i = 0; i < len; ++i) {
+            viewer->fb[(tile->y + i / tile->width) * viewer->width +
+                       tile->x + i % tile->width] = payload[i];
+        }
+        viewer->raw_tiles++;
+        return true;
+    }
+
+    while (i < len && p < payload_len) {
+        uint32_t header = payload[p++];
+        uint32_t count = header & ~REMOTE_RLE_RUN;
+        bool run = header & REMOTE_RLE_RUN;
+        if (count > len - i || p + (run ? 1 : count) > payload_len) {
+            break;
+        }
+
+        for (uint32_t j = 0; j < count; ++j, ++i) {
+            uint32_t delta = run ? payload[p] : payload[p + j];
+            viewer->fb[(tile->y + i / tile->width) * viewer->width +
+                       tile->x + i % tile->width] ^= delta;
+        }
+        p += run ? 1 : count;
+    }
+
+    if (i != len) {
+        fprintf(stderr, "Corrupt RLE tile at %u,%u\n", tile->x, tile->y);
+        return false;
+    }
+
+    return true;
+}
+
+/* FNV-1a over the framebuffer, to compare runs */
+static uint64_t viewer_checksum(struct viewer *viewer) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < (size_t)viewer->width * viewer->height; ++i) {
+        hash = (hash ^ viewer->fb[i]) * 0x100000001b3;
+    }
+
+    return hash;
+}
+
+static bool viewer_frame_end(struct viewer *viewer, const struct remote_frame_end *end) {
+    viewer->frames++;
+    if (viewer->options.verbose) {
+        printf("frame %u: %" PRIu64 " tiles, %" PRIu64 " bytes, checksum %016" PRIx64 "\n",
+               end->seq, viewer->frame_tiles, viewer->frame_bytes, viewer_checksum(viewer));
+    }
+    viewer->frame_tiles = 0;
+    viewer->frame_bytes = 0;
+
+    if (viewer->options.ack_delay_msec > 0) {
+        usleep(viewer->options.ack_delay_msec * 1000);
+    }
+
+    struct remote_frame_ack ack = {
+        .seq = end->seq,
+    };
+    if (!viewer_send(viewer, REMOTE_MSG_FRAME_ACK, &ack, sizeof(ack))) {
+        return false;
+    }
+
+    if (!viewer->input_sent) {
+        viewer->input_sent = true;
+        viewer_send_input(viewer);
+    }
+
+    return true;
+}
+
+static bool viewer_save(struct viewer *viewer, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(f, "P6\n%u %u\n255\n", viewer->width, viewer->height);
+    for (size_t i = 0; i < (size_t)viewer->width * viewer->height; ++i) {
+        uint32_t pixel = viewer->fb[i];
+        uint8_t rgb[3] = {pixel >> 16, pixel >> 8, pixel};
+        fwrite(rgb, 1, sizeof(rgb), f);
+    }
+
+    fclose(f);
+    return true;
+}
+
+static int viewer_run(struct viewer *viewer) {
+    static uint32_t body[REMOTE_MSG_MAX_LENGTH / 4 + 1];
+
+    uint64_t start = now_msec();
+    while (viewer->options.frames == 0 || viewer->frames < (uint64_t)viewer->options.frames) {
+        struct remote_msg_header header;
+        if (!read_full(viewer->fd, &header, sizeof(header))) {
+            break;
+        }
+
+        if (header.length > REMOTE_MSG_MAX_LENGTH ||
+                !read_full(viewer->fd, body, header.length)) {
+            fprintf(stderr, "Bad message of %u bytes\n", header.length);
+            return EXIT_FAILURE;
+        }
+        viewer->bytes += sizeof(header) + header.length;
+        viewer->frame_bytes += sizeof(header) + header.length;
+
+        bool ok = true;
+        switch (header.type) {
+            case REMOTE_MSG_HELLO:
+                ok = header.length >= sizeof(struct remote_hello) &&
+                     viewer_hello(viewer, (struct remote_hello *)body);
+                break;
+            case REMOTE_MSG_TILE:
+                viewer->tiles++;
+                viewer->frame_tiles++;
+                ok = header.length >= sizeof(struct remote_tile) &&
+                     viewer_tile(viewer, (struct remote_tile *)body,
+                                 body + sizeof(struct remote_tile) / 4,
+                                 (header.length - sizeof(struct remote_tile)) / 4);
+                break;
+            case REMOTE_MSG_FRAME_END:
+                ok = header.length >= sizeof(struct remote_frame_end) &&
+                     viewer_frame_end(viewer, (struct remote_frame_end *)body);
+                break;
+            default:
+                break;
+        }
+
+        if (!ok) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint64_t elapsed = now_msec() - start;
+    printf("%" PRIu64 " frames, %" PRIu64 " tiles (%" PRIu64 " raw), %" PRIu64
+           " bytes in %" PRIu64 " ms", viewer->frames, viewer->tiles, viewer->raw_tiles,
+           viewer->bytes, elapsed);
+    if (viewer->frames > 0) {
+        printf(", %" PRIu64 " bytes/frame", viewer->bytes / viewer->frames);
+    }
+    printf("\n");
+
+    if (viewer->fb) {
+        printf("checksum %016" PRIx64 "\n", viewer_checksum(viewer));
+        if (viewer->options.output_path && !viewer_save(viewer, viewer->options.output_path)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s [options] SOCKET\n"
+           "  -n N        exit after N frames (default: until disconnected)\n"
+           "  -o FILE     save the final framebuffer as a PPM image\n"
+           "  -a MSEC     delay every frame ack, like a slow viewer\n"
+           "  -c X,Y      click at X,Y after the first frame\n"
+           "  -k KEYCODE  press and release an evdev key after the first frame\n"
+           "  -v          print every frame\n",
+           name);
+}
+
+int main(int argc, char **argv) {
+    struct viewer viewer = {
+        .options = {
+            .frames = 0,
+            .ack_delay_msec = 0,
+            .click_x = -1,
+            .click_y = -1,
+            .keycode = -1,
+        },
+        .fd = -1,
+    };
+    struct viewer_options *options = &viewer.options;
+
+    int c;
+    while ((c = getopt(argc, argv, "n:o:a:c:k:vh")) != -1) {
+        switch (c) {
+            case 'n':
+                options->frames = atoi(optarg);
+                break;
+            case 'o':
+                options->output_path = optarg;
+                break;
+            case 'a':
+                options->ack_delay_msec = atoi(optarg);
+                break;
+            case 'c':
+                if (sscanf(optarg, "%d,%d", &options->click_x, &options->click_y) != 2) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'k':
+                options->keycode = atoi(optarg);
+                break;
+            case 'v':
+                options->verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    options->socket_path = argv[optind];
+
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+    if (strlen(options->socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long\n");
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, options->socket_path);
+
+    viewer.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (viewer.fd < 0 || connect(viewer.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Unable to connect to %s: %s\n", options->socket_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    int ret = viewer_run(&viewer);
+
+    close(viewer.fd);
+    free(viewer.fb);
+    return ret;
+}